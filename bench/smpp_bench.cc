@@ -0,0 +1,349 @@
+//
+// Copyright (C) 2014 OnlineCity
+// Licensed under the MIT license, which can be read at: http://www.opensource.org/licenses/mit-license.php
+//
+// Micro-benchmarks for the encoding and decoding paths of the library.
+// Besides the time per operation, every benchmark reports the octets it processed per second and
+// the heap allocations it made per operation.
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "smpp/commands.h"
+#include "smpp/deliver_sm_view.h"
+#include "smpp/gsmencoding.h"
+#include "smpp/hexdump.h"
+#include "smpp/pdu.h"
+#include "smpp/segmentation.h"
+#include "smpp/smpp.h"
+#include "smpp/smpp_params.h"
+#include "smpp/smppclient.h"
+#include "smpp/sms.h"
+#include "smpp/timeformat.h"
+#include "smpp/tlv.h"
+
+using smpp::encoding::GsmEncoder;
+using smpp::CommandId;
+using smpp::ESME;
+using smpp::PDU;
+using smpp::SmppAddress;
+using smpp::SmppParams;
+using smpp::TLV;
+using std::string;
+
+#ifdef _MSC_VER
+#include <malloc.h>
+#endif
+
+namespace {
+std::atomic<size_t> allocations(0);
+
+// MSVC has no std::aligned_alloc, and memory from _aligned_malloc must be freed with _aligned_free.
+void *AlignedAlloc(size_t size, size_t alignment) {
+#ifdef _MSC_VER
+  return _aligned_malloc(size > 0 ? size : 1, alignment);
+#else
+  return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+#endif
+}
+
+void AlignedFree(void *p) {
+#ifdef _MSC_VER
+  _aligned_free(p);
+#else
+  std::free(p);
+#endif
+}
+}  // namespace
+
+// Count every heap allocation made by the process.
+void *operator new(size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void *p = std::malloc(size > 0 ? size : 1)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+// std::pmr::new_delete_resource allocates through the aligned forms.
+void *operator new(size_t size, std::align_val_t align) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void *p = AlignedAlloc(size, static_cast<size_t>(align))) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+  std::free(p);
+}
+
+void operator delete(void *p, std::align_val_t) noexcept {
+  AlignedFree(p);
+}
+
+void operator delete(void *p, size_t, std::align_val_t) noexcept {
+  AlignedFree(p);
+}
+
+namespace {
+// Reports the allocations made per iteration since construction, and the octets processed per second.
+class Report {
+ public:
+  explicit Report(benchmark::State *state) :
+    state_(state),
+    start_(allocations.load(std::memory_order_relaxed)) {
+  }
+
+  ~Report() {
+    size_t made = allocations.load(std::memory_order_relaxed) - start_;
+    state_->counters["allocs/op"] = benchmark::Counter(made, benchmark::Counter::kAvgIterations);
+  }
+
+  void Bytes(const size_t bytes_per_op) {
+    state_->SetBytesProcessed(state_->iterations() * bytes_per_op);
+  }
+
+ private:
+  benchmark::State *state_;
+  size_t start_;
+};
+
+const char kMessage[] = "Lorem ipsum dolor sit amet, consectetur adipiscing elit. Maecenas sollicitudin, "
+                        "nibh sed {ornare} [tincidunt], ex \"mauris\" eleifend est; euro sign: \xE2\x82\xAC.";
+
+const char kReceipt[] = "id:dc0dc8ec67e16082483f9e8cd1b135dd sub:001 dlvrd:001 submit date:1110261646 "
+                        "done date:1110261647 stat:DELIVRD err:000 text:Hello World";
+
+// Encodes a submit_sm the way SmppClient does, with tags given by the caller.
+PDU MakeSubmitSm(const string &short_message, const smpp::TlvList &tlvs) {
+  SmppAddress sender("CPPSMPP", smpp::TON::ALPHANUMERIC, smpp::NPI::UNKNOWN);
+  SmppAddress receiver("4513371337", smpp::TON::INTERNATIONAL, smpp::NPI::E164);
+  SmppParams params;
+  smpp::SubmitSmBody body;
+  body.service_type = params.service_type;
+  body.source_addr_ton = sender.ton;
+  body.source_addr_npi = sender.npi;
+  body.source_addr = sender.value;
+  body.dest_addr_ton = receiver.ton;
+  body.dest_addr_npi = receiver.npi;
+  body.destination_addr = receiver.value;
+  body.esm_class = params.esm_class;
+  body.protocol_id = params.protocol_id;
+  body.priority_flag = params.priority_flag;
+  body.schedule_delivery_time = params.schedule_delivery_time;
+  body.validity_period = params.validity_period;
+  body.registered_delivery = params.registered_delivery;
+  body.replace_if_present_flag = params.replace_if_present_flag;
+  body.data_coding = params.data_coding;
+  body.sm_default_msg_id = params.sm_default_msg_id;
+  body.short_message = smpp::schema::OctetParts(short_message, std::string_view("", 1));
+  body.tlvs = &tlvs;
+  return smpp::SubmitSmSchema::Encode(CommandId::SUBMIT_SM, 1, body);
+}
+
+// Encodes a deliver_sm carrying a delivery receipt, as received from an SMSC.
+string MakeDeliverSm() {
+  PDU pdu(CommandId::DELIVER_SM, ESME::ROK, 1);
+  pdu << string("");
+  pdu << SmppAddress("4526159917", smpp::TON::INTERNATIONAL, smpp::NPI::E164);
+  pdu << SmppAddress("default", smpp::TON::ALPHANUMERIC, smpp::NPI::UNKNOWN);
+  pdu << smpp::ESM::DELIVER_SMSC_RECEIPT;
+  pdu << 0 << 0;
+  pdu << string("") << string("");
+  pdu << 0 << 0 << smpp::DataCoding::DEFAULT << 0;
+  pdu << static_cast<uint8_t>(sizeof(kReceipt));
+  pdu << string(kReceipt);
+  pdu << TLV(smpp::Tag::RECEIPTED_MESSAGE_ID, string("dc0dc8ec67e16082483f9e8cd1b135dd"));
+  pdu << TLV(smpp::Tag::MESSAGE_STATE, static_cast<uint8_t>(2));
+  return string(pdu.Octets());
+}
+
+void BM_EncodeSubmitSm(benchmark::State &state) {  // NOLINT(runtime/references)
+  string message = GsmEncoder::EncodeGsm0338(kMessage);
+  smpp::TlvList tlvs = { TLV(smpp::Tag::USER_MESSAGE_REFERENCE, static_cast<uint16_t>(0x1337)) };
+  size_t size = 0;
+  Report report(&state);
+  for (auto _ : state) {
+    PDU pdu = MakeSubmitSm(message, tlvs);
+    benchmark::DoNotOptimize(pdu.Octets().data());
+    size = pdu.Size();
+  }
+  report.Bytes(size);
+}
+BENCHMARK(BM_EncodeSubmitSm);
+
+void BM_DecodePdu(benchmark::State &state) {  // NOLINT(runtime/references)
+  string octets = MakeDeliverSm();
+  smpp::PduLengthHeader header;
+  std::copy(octets.begin(), octets.begin() + smpp::HEADERFIELD_SIZE, header.begin());
+  smpp::PduData body(octets.begin() + smpp::HEADERFIELD_SIZE, octets.end());
+  Report report(&state);
+  for (auto _ : state) {
+    PDU pdu(header, body);
+    benchmark::DoNotOptimize(pdu.sequence_no());
+  }
+  report.Bytes(octets.size());
+}
+BENCHMARK(BM_DecodePdu);
+
+void BM_ParseSms(benchmark::State &state) {  // NOLINT(runtime/references)
+  string octets = MakeDeliverSm();
+  PDU pdu(octets.data(), octets.size());
+  Report report(&state);
+  for (auto _ : state) {
+    pdu.ResetMarker();
+    smpp::SMS sms(&pdu);
+    benchmark::DoNotOptimize(sms.short_message.data());
+  }
+  report.Bytes(octets.size());
+}
+BENCHMARK(BM_ParseSms);
+
+void BM_ViewDeliverSm(benchmark::State &state) {  // NOLINT(runtime/references)
+  string octets = MakeDeliverSm();
+  Report report(&state);
+  for (auto _ : state) {
+    smpp::DeliverSmView view(octets);
+    std::string_view message_id;
+    view.FindTlv(smpp::Tag::RECEIPTED_MESSAGE_ID, &message_id);
+    benchmark::DoNotOptimize(view.dest_addr().data());
+    benchmark::DoNotOptimize(message_id.data());
+  }
+  report.Bytes(octets.size());
+}
+BENCHMARK(BM_ViewDeliverSm);
+
+void BM_ParseDeliveryReport(benchmark::State &state) {  // NOLINT(runtime/references)
+  string octets = MakeDeliverSm();
+  PDU pdu(octets.data(), octets.size());
+  smpp::SMS sms(&pdu);
+  Report report(&state);
+  for (auto _ : state) {
+    smpp::DeliveryReport dlr(sms);
+    benchmark::DoNotOptimize(dlr.id.data());
+  }
+  report.Bytes(sms.short_message.size());
+}
+BENCHMARK(BM_ParseDeliveryReport);
+
+void BM_EncodeGsm0338(benchmark::State &state) {  // NOLINT(runtime/references)
+  string message(kMessage);
+  Report report(&state);
+  for (auto _ : state) {
+    string encoded = GsmEncoder::EncodeGsm0338(message);
+    benchmark::DoNotOptimize(encoded.data());
+  }
+  report.Bytes(message.size());
+}
+BENCHMARK(BM_EncodeGsm0338);
+
+void BM_EncodeUtf8(benchmark::State &state) {  // NOLINT(runtime/references)
+  string message = GsmEncoder::EncodeGsm0338(kMessage);
+  Report report(&state);
+  for (auto _ : state) {
+    string decoded = GsmEncoder::EncodeUtf8(message);
+    benchmark::DoNotOptimize(decoded.data());
+  }
+  report.Bytes(message.size());
+}
+BENCHMARK(BM_EncodeUtf8);
+
+void BM_EncodeSms(benchmark::State &state) {  // NOLINT(runtime/references)
+  string message = string(kMessage) + " \xD0\x9F\xD1\x80\xD0\xB8\xD0\xB2\xD0\xB5\xD1\x82";  // Cyrillic calls for UCS-2
+  smpp::SmppParams params;
+  Report report(&state);
+  for (auto _ : state) {
+    string encoded = GsmEncoder::EncodeSms(message, &params);
+    benchmark::DoNotOptimize(encoded.data());
+  }
+  report.Bytes(message.size());
+}
+BENCHMARK(BM_EncodeSms);
+
+void BM_ParseSmppTimestamp(benchmark::State &state) {  // NOLINT(runtime/references)
+  string absolute("111019103011100+");
+  string relative("000002000000000R");
+  Report report(&state);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(smpp::timeformat::ParseSmppTimestamp(absolute));
+    benchmark::DoNotOptimize(smpp::timeformat::ParseSmppTimestamp(relative));
+  }
+  report.Bytes(absolute.size() + relative.size());
+}
+BENCHMARK(BM_ParseSmppTimestamp);
+
+void BM_ParseDlrTimestamp(benchmark::State &state) {  // NOLINT(runtime/references)
+  string timestamp("1402031337");
+  Report report(&state);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(smpp::timeformat::ParseDlrTimestamp(timestamp));
+  }
+  report.Bytes(timestamp.size());
+}
+BENCHMARK(BM_ParseDlrTimestamp);
+
+void BM_FormatSmppTimestamp(benchmark::State &state) {  // NOLINT(runtime/references)
+  auto tp = std::chrono::system_clock::now();
+  char buffer[smpp::timeformat::SMPP_TIMESTAMP_LENGTH + 1];
+  Report report(&state);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(smpp::timeformat::ToSmppTimeString(tp, buffer));
+    benchmark::DoNotOptimize(smpp::timeformat::ToSmppTimeString(std::chrono::hours(1), buffer));
+    benchmark::ClobberMemory();
+  }
+  report.Bytes(2 * smpp::timeformat::SMPP_TIMESTAMP_LENGTH);
+}
+BENCHMARK(BM_FormatSmppTimestamp);
+
+void BM_Split(benchmark::State &state) {  // NOLINT(runtime/references)
+  string message;
+  while (message.size() < 1000) {
+    message += GsmEncoder::EncodeGsm0338(kMessage);
+  }
+  Report report(&state);
+  for (auto _ : state) {
+    std::vector<string> parts = smpp::SmppClient::Split(message, 153);
+    benchmark::DoNotOptimize(parts.data());
+  }
+  report.Bytes(message.size());
+}
+BENCHMARK(BM_Split);
+
+// The segments Split copies into strings, as views of the message.
+void BM_SplitSegments(benchmark::State &state) {  // NOLINT(runtime/references)
+  string message;
+  while (message.size() < 1000) {
+    message += GsmEncoder::EncodeGsm0338(kMessage);
+  }
+  Report report(&state);
+  for (auto _ : state) {
+    std::vector<smpp::Segment> segments = smpp::SplitSegments(message, smpp::DataCoding::DEFAULT, 153);
+    benchmark::DoNotOptimize(segments.data());
+  }
+  report.Bytes(message.size());
+}
+BENCHMARK(BM_SplitSegments);
+
+void BM_Hexdump(benchmark::State &state) {  // NOLINT(runtime/references)
+  string octets = MakeDeliverSm();
+  Report report(&state);
+  for (auto _ : state) {
+    string dump = oc::tools::hexdump(reinterpret_cast<const unsigned char *>(octets.data()), octets.size());
+    benchmark::DoNotOptimize(dump.data());
+  }
+  report.Bytes(octets.size());
+}
+BENCHMARK(BM_Hexdump);
+}  // namespace
+
+BENCHMARK_MAIN();
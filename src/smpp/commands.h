@@ -0,0 +1,253 @@
+// Copyright (C) 2011-2014 OnlineCity
+// Licensed under the MIT license, which can be read at: http://www.opensource.org/licenses/mit-license.php
+// @author hd@onlinecity.dk & td@onlinecity.dk
+
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "smpp/pdu_schema.h"
+#include "smpp/smpp.h"
+#include "smpp/sms.h"
+#include "smpp/tlv.h"
+
+// Bodies of the PDUs the client sends and reads, with their schemas.
+// Maximum lengths are those of SMPP 3.4 section 5.2, and include the null terminator of C-octet strings.
+namespace smpp {
+// BIND_TRANSMITTER, BIND_RECEIVER and BIND_TRANSCEIVER.
+// Credentials are left to the SMSC to judge, as some issue longer ones than SMPP 3.4 allows.
+struct BindBody {
+  std::string_view system_id;
+  std::string_view password;
+  std::string_view system_type;
+  InterfaceVersion interface_version{};
+  TON addr_ton{};
+  NPI addr_npi{};
+  std::string_view address_range;
+};
+
+typedef schema::Schema<
+  schema::Field<&BindBody::system_id, schema::CString<>>,
+  schema::Field<&BindBody::password, schema::CString<>>,
+  schema::Field<&BindBody::system_type, schema::CString<13>>,
+  schema::Field<&BindBody::interface_version, schema::Integer<uint8_t>>,
+  schema::Field<&BindBody::addr_ton, schema::Integer<uint8_t>>,
+  schema::Field<&BindBody::addr_npi, schema::Integer<uint8_t>>,
+  schema::Field<&BindBody::address_range, schema::CString<41>>> BindSchema;
+
+// SUBMIT_SM, and DELIVER_SM, which shares its layout.
+// The caller's optional parameters are followed by the SAR parameters, if set.
+struct SubmitSmBody {
+  std::string_view service_type;
+  TON source_addr_ton{};
+  NPI source_addr_npi{};
+  std::string_view source_addr;
+  TON dest_addr_ton{};
+  NPI dest_addr_npi{};
+  std::string_view destination_addr;
+  ESM esm_class{};
+  uint8_t protocol_id = 0;
+  Priority priority_flag{};
+  std::string_view schedule_delivery_time;
+  std::string_view validity_period;
+  RegisteredDelivery registered_delivery{};
+  ReplaceIfPresent replace_if_present_flag{};
+  DataCoding data_coding{};
+  uint8_t sm_default_msg_id = 0;
+  schema::OctetParts short_message;
+  std::optional<schema::OctetParts> message_payload;
+  const TlvList *tlvs = nullptr;
+  std::optional<uint16_t> sar_msg_ref_num;
+  std::optional<uint8_t> sar_total_segments;
+  std::optional<uint8_t> sar_segment_seqnum;
+};
+
+typedef schema::Schema<
+  schema::Field<&SubmitSmBody::service_type, schema::CString<6>>,
+  schema::Field<&SubmitSmBody::source_addr_ton, schema::Integer<uint8_t>>,
+  schema::Field<&SubmitSmBody::source_addr_npi, schema::Integer<uint8_t>>,
+  schema::Field<&SubmitSmBody::source_addr, schema::CString<21>>,
+  schema::Field<&SubmitSmBody::dest_addr_ton, schema::Integer<uint8_t>>,
+  schema::Field<&SubmitSmBody::dest_addr_npi, schema::Integer<uint8_t>>,
+  schema::Field<&SubmitSmBody::destination_addr, schema::CString<21>>,
+  schema::Field<&SubmitSmBody::esm_class, schema::Integer<uint8_t>>,
+  schema::Field<&SubmitSmBody::protocol_id, schema::Integer<uint8_t>>,
+  schema::Field<&SubmitSmBody::priority_flag, schema::Integer<uint8_t>>,
+  schema::Field<&SubmitSmBody::schedule_delivery_time, schema::CString<17>>,
+  schema::Field<&SubmitSmBody::validity_period, schema::CString<17>>,
+  schema::Field<&SubmitSmBody::registered_delivery, schema::Integer<uint8_t>>,
+  schema::Field<&SubmitSmBody::replace_if_present_flag, schema::Integer<uint8_t>>,
+  schema::Field<&SubmitSmBody::data_coding, schema::Integer<uint8_t>>,
+  schema::Field<&SubmitSmBody::sm_default_msg_id, schema::Integer<uint8_t>>,
+  schema::Field<&SubmitSmBody::short_message, schema::Octets<uint8_t, 254>>,
+  schema::Field<&SubmitSmBody::message_payload, schema::Tlv<Tag::MESSAGE_PAYLOAD>>,
+  schema::Field<&SubmitSmBody::tlvs, schema::Tlvs>,
+  schema::Field<&SubmitSmBody::sar_msg_ref_num, schema::Tlv<Tag::SAR_MSG_REF_NUM>>,
+  schema::Field<&SubmitSmBody::sar_total_segments, schema::Tlv<Tag::SAR_TOTAL_SEGMENTS>>,
+  schema::Field<&SubmitSmBody::sar_segment_seqnum, schema::Tlv<Tag::SAR_SEGMENT_SEQNUM>>> SubmitSmSchema;
+
+// SUBMIT_MULTI, a SUBMIT_SM to up to 255 destinations.
+struct SubmitMultiBody {
+  std::string_view service_type;
+  TON source_addr_ton{};
+  NPI source_addr_npi{};
+  std::string_view source_addr;
+  schema::ArrayView<DestAddress> dest_addresses;
+  ESM esm_class{};
+  uint8_t protocol_id = 0;
+  Priority priority_flag{};
+  std::string_view schedule_delivery_time;
+  std::string_view validity_period;
+  RegisteredDelivery registered_delivery{};
+  ReplaceIfPresent replace_if_present_flag{};
+  DataCoding data_coding{};
+  uint8_t sm_default_msg_id = 0;
+  schema::OctetParts short_message;
+  std::optional<schema::OctetParts> message_payload;
+  const TlvList *tlvs = nullptr;
+  std::optional<uint16_t> sar_msg_ref_num;
+  std::optional<uint8_t> sar_total_segments;
+  std::optional<uint8_t> sar_segment_seqnum;
+};
+
+typedef schema::Schema<
+  schema::Field<&SubmitMultiBody::service_type, schema::CString<6>>,
+  schema::Field<&SubmitMultiBody::source_addr_ton, schema::Integer<uint8_t>>,
+  schema::Field<&SubmitMultiBody::source_addr_npi, schema::Integer<uint8_t>>,
+  schema::Field<&SubmitMultiBody::source_addr, schema::CString<21>>,
+  schema::Field<&SubmitMultiBody::dest_addresses, schema::DestAddresses>,
+  schema::Field<&SubmitMultiBody::esm_class, schema::Integer<uint8_t>>,
+  schema::Field<&SubmitMultiBody::protocol_id, schema::Integer<uint8_t>>,
+  schema::Field<&SubmitMultiBody::priority_flag, schema::Integer<uint8_t>>,
+  schema::Field<&SubmitMultiBody::schedule_delivery_time, schema::CString<17>>,
+  schema::Field<&SubmitMultiBody::validity_period, schema::CString<17>>,
+  schema::Field<&SubmitMultiBody::registered_delivery, schema::Integer<uint8_t>>,
+  schema::Field<&SubmitMultiBody::replace_if_present_flag, schema::Integer<uint8_t>>,
+  schema::Field<&SubmitMultiBody::data_coding, schema::Integer<uint8_t>>,
+  schema::Field<&SubmitMultiBody::sm_default_msg_id, schema::Integer<uint8_t>>,
+  schema::Field<&SubmitMultiBody::short_message, schema::Octets<uint8_t, 254>>,
+  schema::Field<&SubmitMultiBody::message_payload, schema::Tlv<Tag::MESSAGE_PAYLOAD>>,
+  schema::Field<&SubmitMultiBody::tlvs, schema::Tlvs>,
+  schema::Field<&SubmitMultiBody::sar_msg_ref_num, schema::Tlv<Tag::SAR_MSG_REF_NUM>>,
+  schema::Field<&SubmitMultiBody::sar_total_segments, schema::Tlv<Tag::SAR_TOTAL_SEGMENTS>>,
+  schema::Field<&SubmitMultiBody::sar_segment_seqnum, schema::Tlv<Tag::SAR_SEGMENT_SEQNUM>>> SubmitMultiSchema;
+
+// SUBMIT_MULTI_RESP.
+struct SubmitMultiRespBody {
+  std::string message_id;
+  std::vector<UnsuccessSme> unsuccess_smes;
+};
+
+typedef schema::Schema<
+  schema::Field<&SubmitMultiRespBody::message_id, schema::CString<65>>,
+  schema::Field<&SubmitMultiRespBody::unsuccess_smes, schema::UnsuccessSmes>> SubmitMultiRespSchema;
+
+// DATA_SM, which carries the message in MESSAGE_PAYLOAD rather than in a short message.
+struct DataSmBody {
+  std::string_view service_type;
+  TON source_addr_ton{};
+  NPI source_addr_npi{};
+  std::string_view source_addr;
+  TON dest_addr_ton{};
+  NPI dest_addr_npi{};
+  std::string_view destination_addr;
+  ESM esm_class{};
+  RegisteredDelivery registered_delivery{};
+  DataCoding data_coding{};
+  std::optional<schema::OctetParts> message_payload;
+  const TlvList *tlvs = nullptr;
+};
+
+typedef schema::Schema<
+  schema::Field<&DataSmBody::service_type, schema::CString<6>>,
+  schema::Field<&DataSmBody::source_addr_ton, schema::Integer<uint8_t>>,
+  schema::Field<&DataSmBody::source_addr_npi, schema::Integer<uint8_t>>,
+  schema::Field<&DataSmBody::source_addr, schema::CString<65>>,
+  schema::Field<&DataSmBody::dest_addr_ton, schema::Integer<uint8_t>>,
+  schema::Field<&DataSmBody::dest_addr_npi, schema::Integer<uint8_t>>,
+  schema::Field<&DataSmBody::destination_addr, schema::CString<65>>,
+  schema::Field<&DataSmBody::esm_class, schema::Integer<uint8_t>>,
+  schema::Field<&DataSmBody::registered_delivery, schema::Integer<uint8_t>>,
+  schema::Field<&DataSmBody::data_coding, schema::Integer<uint8_t>>,
+  schema::Field<&DataSmBody::message_payload, schema::Tlv<Tag::MESSAGE_PAYLOAD>>,
+  schema::Field<&DataSmBody::tlvs, schema::Tlvs>> DataSmSchema;
+
+// DATA_SM_RESP. The SMSC may explain a failure in optional parameters, eg. DELIVERY_FAILURE_REASON
+// and NETWORK_ERROR_CODE.
+struct DataSmRespBody {
+  std::string message_id;
+  TlvList tlvs;
+};
+
+typedef schema::Schema<
+  schema::Field<&DataSmRespBody::message_id, schema::CString<65>>,
+  schema::Field<&DataSmRespBody::tlvs, schema::Tlvs>> DataSmRespSchema;
+
+// DELIVER_SM decoded into an SMS. The SMSC may send longer strings than the specification allows,
+// so the limits are not checked when decoding.
+typedef schema::Schema<
+  schema::Field<&SMS::service_type, schema::CString<6>>,
+  schema::Field<&SMS::source_addr_ton, schema::Integer<uint8_t>>,
+  schema::Field<&SMS::source_addr_npi, schema::Integer<uint8_t>>,
+  schema::Field<&SMS::source_addr, schema::CString<21>>,
+  schema::Field<&SMS::dest_addr_ton, schema::Integer<uint8_t>>,
+  schema::Field<&SMS::dest_addr_npi, schema::Integer<uint8_t>>,
+  schema::Field<&SMS::dest_addr, schema::CString<21>>,
+  schema::Field<&SMS::esm_class, schema::Integer<uint8_t>>,
+  schema::Field<&SMS::protocol_id, schema::Integer<uint8_t>>,
+  schema::Field<&SMS::priority_flag, schema::Integer<uint8_t>>,
+  schema::Field<&SMS::schedule_delivery_time, schema::CString<17>>,
+  schema::Field<&SMS::validity_period, schema::CString<17>>,
+  schema::Field<&SMS::registered_delivery, schema::Integer<uint8_t>>,
+  schema::Field<&SMS::replace_if_present_flag, schema::Integer<uint8_t>>,
+  schema::Field<&SMS::data_coding, schema::Integer<uint8_t>>,
+  schema::Field<&SMS::sm_default_msg_id, schema::Integer<uint8_t>>,
+  schema::Field<&SMS::short_message, schema::Octets<uint8_t, 254>>,
+  schema::Field<&SMS::tlvs, schema::Tlvs>> DeliverSmSchema;
+
+// DATA_SM decoded into an SMS. The message stays in MESSAGE_PAYLOAD, among the optional parameters.
+typedef schema::Schema<
+  schema::Field<&SMS::service_type, schema::CString<6>>,
+  schema::Field<&SMS::source_addr_ton, schema::Integer<uint8_t>>,
+  schema::Field<&SMS::source_addr_npi, schema::Integer<uint8_t>>,
+  schema::Field<&SMS::source_addr, schema::CString<65>>,
+  schema::Field<&SMS::dest_addr_ton, schema::Integer<uint8_t>>,
+  schema::Field<&SMS::dest_addr_npi, schema::Integer<uint8_t>>,
+  schema::Field<&SMS::dest_addr, schema::CString<65>>,
+  schema::Field<&SMS::esm_class, schema::Integer<uint8_t>>,
+  schema::Field<&SMS::registered_delivery, schema::Integer<uint8_t>>,
+  schema::Field<&SMS::data_coding, schema::Integer<uint8_t>>,
+  schema::Field<&SMS::tlvs, schema::Tlvs>> DataSmSmsSchema;
+
+// QUERY_SM.
+struct QuerySmBody {
+  std::string_view message_id;
+  TON source_addr_ton{};
+  NPI source_addr_npi{};
+  std::string_view source_addr;
+};
+
+typedef schema::Schema<
+  schema::Field<&QuerySmBody::message_id, schema::CString<65>>,
+  schema::Field<&QuerySmBody::source_addr_ton, schema::Integer<uint8_t>>,
+  schema::Field<&QuerySmBody::source_addr_npi, schema::Integer<uint8_t>>,
+  schema::Field<&QuerySmBody::source_addr, schema::CString<21>>> QuerySmSchema;
+
+// QUERY_SM_RESP.
+struct QuerySmRespBody {
+  std::string message_id;
+  std::string final_date;
+  uint8_t message_state = 0;
+  uint8_t error_code = 0;
+};
+
+typedef schema::Schema<
+  schema::Field<&QuerySmRespBody::message_id, schema::CString<65>>,
+  schema::Field<&QuerySmRespBody::final_date, schema::CString<17>>,
+  schema::Field<&QuerySmRespBody::message_state, schema::Integer<uint8_t>>,
+  schema::Field<&QuerySmRespBody::error_code, schema::Integer<uint8_t>>> QuerySmRespSchema;
+}  // namespace smpp
@@ -0,0 +1,138 @@
+// Copyright (C) 2011-2014 OnlineCity
+// Licensed under the MIT license, which can be read at: http://www.opensource.org/licenses/mit-license.php
+// @author hd@onlinecity.dk & td@onlinecity.dk
+
+#include "smpp/deliver_sm_view.h"
+#include <algorithm>
+#include <cstring>
+
+#include "smpp/exceptions.h"
+#include "smpp/sms.h"
+
+namespace smpp {
+using std::string_view;
+
+void TlvIterator::Next() {
+  const size_t header = sizeof(uint16_t) * 2;
+  if (at_end_ || static_cast<size_t>(end_ - next_) < header) {
+    *this = TlvIterator();
+    return;
+  }
+
+  auto octets = reinterpret_cast<const uint8_t*>(next_);
+  Tag tag = static_cast<Tag>(octets[0] << 8 | octets[1]);
+  size_t len = octets[2] << 8 | octets[3];
+  if (tag == Tag::NA) {
+    *this = TlvIterator();
+    return;
+  }
+
+  len = std::min(len, static_cast<size_t>(end_ - next_) - header);
+  tlv_ = TlvView { tag, string_view(next_ + header, len) };
+  next_ += header + len;
+}
+
+DeliverSmView::DeliverSmView(string_view octets) :
+  octets_(octets),
+  service_type_(),
+  source_addr_(),
+  dest_addr_(),
+  schedule_delivery_time_(),
+  validity_period_(),
+  short_message_(),
+  tlvs_(),
+  source_fields_(0),
+  dest_fields_(0),
+  esm_fields_(0),
+  registered_fields_(0),
+  data_sm_(false) {
+  if (octets_.size() < HEADERFIELD_SIZE * 4) {
+    throw smpp::SmppException("PDU too short");
+  }
+  data_sm_ = command_id() == CommandId::DATA_SM;
+
+  size_t pos = HEADERFIELD_SIZE * 4;
+  service_type_ = CString(&pos);
+  source_fields_ = Fixed(&pos, 2);
+  source_addr_ = CString(&pos);
+  dest_fields_ = Fixed(&pos, 2);
+  dest_addr_ = CString(&pos);
+  if (data_sm_) {
+    esm_fields_ = Fixed(&pos, 1);
+    registered_fields_ = Fixed(&pos, 2);
+    tlvs_ = octets_.substr(pos);
+    FindTlv(Tag::MESSAGE_PAYLOAD, &short_message_);
+    return;
+  }
+  esm_fields_ = Fixed(&pos, 3);
+  schedule_delivery_time_ = CString(&pos);
+  validity_period_ = CString(&pos);
+  registered_fields_ = Fixed(&pos, 5);
+  short_message_ = octets_.substr(pos, sm_length());
+  tlvs_ = octets_.substr(pos + short_message_.size());
+}
+
+DeliverSmView::DeliverSmView(PDU *pdu) :
+  DeliverSmView(pdu->Octets()) {
+}
+
+bool DeliverSmView::FindTlv(const Tag &tag, string_view *value) const {
+  for (const TlvView &tlv : tlvs()) {
+    if (tlv.tag == tag) {
+      *value = tlv.value;
+      return true;
+    }
+  }
+  return false;
+}
+
+SMS DeliverSmView::ToSms() const {
+  SMS sms;
+  sms.is_null = false;
+  sms.command_id = command_id();
+  sms.service_type.assign(service_type_.data(), service_type_.size());
+  sms.source_addr_ton = source_addr_ton();
+  sms.source_addr_npi = source_addr_npi();
+  sms.source_addr.assign(source_addr_.data(), source_addr_.size());
+  sms.dest_addr_ton = dest_addr_ton();
+  sms.dest_addr_npi = dest_addr_npi();
+  sms.dest_addr.assign(dest_addr_.data(), dest_addr_.size());
+  sms.esm_class = esm_class();
+  sms.protocol_id = protocol_id();
+  sms.priority_flag = priority_flag();
+  sms.schedule_delivery_time.assign(schedule_delivery_time_.data(), schedule_delivery_time_.size());
+  sms.validity_period.assign(validity_period_.data(), validity_period_.size());
+  sms.registered_delivery = registered_delivery();
+  sms.replace_if_present_flag = replace_if_present_flag();
+  sms.data_coding = data_coding();
+  sms.sm_default_msg_id = sm_default_msg_id();
+  sms.sm_length = sm_length();
+  // Like SMS(PDU*), a short message cut short by the end of the PDU is padded with zeros.
+  sms.short_message.assign(short_message_.data(), short_message_.size());
+  sms.short_message.resize(sms.sm_length);
+  for (const TlvView &tlv : tlvs()) {
+    sms.tlvs.emplace_back(tlv.tag, tlv.value.data(), tlv.value.size());
+  }
+  return sms;
+}
+
+string_view DeliverSmView::CString(size_t *pos) const {
+  const char *begin = octets_.data() + *pos;
+  auto end = static_cast<const char*>(std::memchr(begin, '\0', octets_.size() - *pos));
+  if (end == nullptr) {
+    *pos = octets_.size();
+    return string_view(begin, octets_.size() - (begin - octets_.data()));
+  }
+  *pos = end - octets_.data() + 1;
+  return string_view(begin, end - begin);
+}
+
+size_t DeliverSmView::Fixed(size_t *pos, const size_t n) const {
+  if (octets_.size() - *pos < n) {
+    throw smpp::SmppException("PDU reached EOF");
+  }
+  size_t fixed = *pos;
+  *pos += n;
+  return fixed;
+}
+}  // namespace smpp
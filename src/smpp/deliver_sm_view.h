@@ -0,0 +1,252 @@
+// Copyright (C) 2011-2014 OnlineCity
+// Licensed under the MIT license, which can be read at: http://www.opensource.org/licenses/mit-license.php
+// @author hd@onlinecity.dk & td@onlinecity.dk
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string_view>
+
+#include "smpp/pdu.h"
+#include "smpp/smpp.h"
+#include "smpp/tlv.h"
+
+namespace smpp {
+class SMS;
+
+// Optional parameter of a PDU, viewing its value in the PDU.
+struct TlvView {
+  Tag tag;
+  std::string_view value;
+};
+
+// Forward iterator over the optional parameters which end a PDU.
+// Like SMS, it stops at a null tag, and a value cut short by the end of the PDU is viewed as far as it goes.
+class TlvIterator {
+ public:
+  typedef std::forward_iterator_tag iterator_category;
+  typedef TlvView value_type;
+  typedef std::ptrdiff_t difference_type;
+  typedef const TlvView *pointer;
+  typedef const TlvView &reference;
+
+  // Constructs the end iterator.
+  TlvIterator() :
+    next_(nullptr),
+    end_(nullptr),
+    tlv_(),
+    at_end_(true) {
+  }
+
+  // @param octets The optional parameters of a PDU.
+  explicit TlvIterator(std::string_view octets) :
+    next_(octets.data()),
+    end_(octets.data() + octets.size()),
+    tlv_(),
+    at_end_(false) {
+    Next();
+  }
+
+  inline reference operator*() const {
+    return tlv_;
+  }
+
+  inline pointer operator->() const {
+    return &tlv_;
+  }
+
+  inline TlvIterator &operator++() {
+    Next();
+    return *this;
+  }
+
+  inline TlvIterator operator++(int) {
+    TlvIterator it(*this);
+    Next();
+    return it;
+  }
+
+  inline bool operator==(const TlvIterator &rhs) const {
+    return at_end_ == rhs.at_end_ && (at_end_ || next_ == rhs.next_);
+  }
+
+  inline bool operator!=(const TlvIterator &rhs) const {
+    return !(*this == rhs);
+  }
+
+ private:
+  // Reads the parameter at next_, or turns into the end iterator if there is none.
+  void Next();
+
+  const char *next_;  // First octet after tlv_.
+  const char *end_;
+  TlvView tlv_;
+  bool at_end_;
+};
+
+// The optional parameters of a PDU, for range based for loops.
+class TlvRange {
+ public:
+  explicit TlvRange(std::string_view octets) :
+    octets_(octets) {
+  }
+
+  inline TlvIterator begin() const {
+    return TlvIterator(octets_);
+  }
+
+  inline TlvIterator end() const {
+    return TlvIterator();
+  }
+
+  inline bool empty() const {
+    return begin() == end();
+  }
+
+ private:
+  std::string_view octets_;
+};
+
+// Non-owning view of a DELIVER_SM, or SUBMIT_SM, which shares its layout, or of a DATA_SM.
+// The fields a DATA_SM lacks read as zero or empty, and its short message is the MESSAGE_PAYLOAD parameter.
+// Constructing a view finds the ends of the five C-octet strings with memchr and copies nothing.
+// The fields are decoded when they are read, strings as views of the PDU. The view is valid
+// as long as the octets it was constructed from are, use ToSms() to keep an SMS beyond that.
+class DeliverSmView {
+ public:
+  // @param octets Wire octets of one PDU, ie. starting with its command length.
+  // @throw SmppException if the PDU is too short to hold its mandatory fields.
+  explicit DeliverSmView(std::string_view octets);
+
+  // Views the octets of a PDU, which must not be modified while the view is in use.
+  // @throw SmppException if the PDU is too short to hold its mandatory fields.
+  explicit DeliverSmView(PDU *pdu);
+
+  inline CommandId command_id() const {
+    return static_cast<CommandId>(Uint32(HEADERFIELD_SIZE));
+  }
+
+  inline uint32_t sequence_no() const {
+    return Uint32(HEADERFIELD_SIZE * 3);
+  }
+
+  inline std::string_view service_type() const {
+    return service_type_;
+  }
+
+  inline TON source_addr_ton() const {
+    return static_cast<TON>(Octet(source_fields_));
+  }
+
+  inline NPI source_addr_npi() const {
+    return static_cast<NPI>(Octet(source_fields_ + 1));
+  }
+
+  inline std::string_view source_addr() const {
+    return source_addr_;
+  }
+
+  inline TON dest_addr_ton() const {
+    return static_cast<TON>(Octet(dest_fields_));
+  }
+
+  inline NPI dest_addr_npi() const {
+    return static_cast<NPI>(Octet(dest_fields_ + 1));
+  }
+
+  inline std::string_view dest_addr() const {
+    return dest_addr_;
+  }
+
+  inline ESM esm_class() const {
+    return static_cast<ESM>(Octet(esm_fields_));
+  }
+
+  inline int protocol_id() const {
+    return data_sm_ ? 0 : Octet(esm_fields_ + 1);
+  }
+
+  inline int priority_flag() const {
+    return data_sm_ ? 0 : Octet(esm_fields_ + 2);
+  }
+
+  inline std::string_view schedule_delivery_time() const {
+    return schedule_delivery_time_;
+  }
+
+  inline std::string_view validity_period() const {
+    return validity_period_;
+  }
+
+  inline int registered_delivery() const {
+    return Octet(registered_fields_);
+  }
+
+  inline int replace_if_present_flag() const {
+    return data_sm_ ? 0 : Octet(registered_fields_ + 1);
+  }
+
+  inline DataCoding data_coding() const {
+    return static_cast<DataCoding>(Octet(registered_fields_ + (data_sm_ ? 1 : 2)));
+  }
+
+  inline int sm_default_msg_id() const {
+    return data_sm_ ? 0 : Octet(registered_fields_ + 3);
+  }
+
+  inline int sm_length() const {
+    return data_sm_ ? static_cast<int>(short_message_.size()) : Octet(registered_fields_ + 4);
+  }
+
+  // Returns the short message, which is shorter than sm_length if the PDU ends before it does.
+  inline std::string_view short_message() const {
+    return short_message_;
+  }
+
+  inline TlvRange tlvs() const {
+    return TlvRange(tlvs_);
+  }
+
+  // Finds the first optional parameter with a tag.
+  // @param value Set to the value of the parameter, if there is one.
+  // @return True if there was a parameter with the tag.
+  bool FindTlv(const Tag &tag, std::string_view *value) const;
+
+  // Copies the fields into an SMS, as SMS(PDU*) would have decoded them.
+  SMS ToSms() const;
+
+ private:
+  inline uint8_t Octet(const size_t pos) const {
+    return static_cast<uint8_t>(octets_[pos]);
+  }
+
+  inline uint32_t Uint32(const size_t pos) const {
+    return static_cast<uint32_t>(Octet(pos)) << 24 | static_cast<uint32_t>(Octet(pos + 1)) << 16
+        | static_cast<uint32_t>(Octet(pos + 2)) << 8 | Octet(pos + 3);
+  }
+
+  // Returns the C-octet string at pos, without its null terminator, and moves pos past it.
+  // A string which isn't terminated runs to the end of the PDU.
+  std::string_view CString(size_t *pos) const;
+
+  // Returns pos and moves it past n octets.
+  // @throw SmppException if there are less than n octets left.
+  size_t Fixed(size_t *pos, const size_t n) const;
+
+  std::string_view octets_;
+  std::string_view service_type_;
+  std::string_view source_addr_;
+  std::string_view dest_addr_;
+  std::string_view schedule_delivery_time_;
+  std::string_view validity_period_;
+  std::string_view short_message_;
+  std::string_view tlvs_;
+  size_t source_fields_;  // Offset of source_addr_ton and source_addr_npi.
+  size_t dest_fields_;  // Offset of dest_addr_ton and dest_addr_npi.
+  size_t esm_fields_;  // Offset of esm_class, protocol_id and priority_flag.
+  size_t registered_fields_;  // Offset of registered_delivery up to sm_length, or data_coding in a DATA_SM.
+  bool data_sm_;
+};
+}  // namespace smpp
@@ -62,6 +62,17 @@ class InvalidDestinationAddressException: public SmppException {
 };
 
 // Exception thrown when there is transport/connection related issues.
+// A field is longer than the SMPP specification allows, so the PDU can't be encoded.
+class FieldLengthException: public SmppException {
+ public:
+  FieldLengthException() :
+    SmppException() {
+  }
+  explicit FieldLengthException(const std::string &message) :
+    SmppException(message) {
+  }
+};
+
 class TransportException: public std::runtime_error {
  public:
   TransportException() :
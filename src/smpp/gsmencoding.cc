@@ -3,173 +3,452 @@
 // @author hd@onlinecity.dk & td@onlinecity.dk
 
 #include "smpp/gsmencoding.h"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
 #include <string>
-#include <unordered_map>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SMPP_GSM_SSE2
+#include <emmintrin.h>
+#endif
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
 
 namespace smpp {
 namespace encoding {
 using std::string;
-const std::unordered_map<std::string, std::string> GsmEncoder::gsm0338_map_ = {
-  {"@", "\x00"},
-  {"£", "\x01"},
-  {"$", "\x02"},
-  {"¥", "\x03"},
-  {"è", "\x04"},
-  {"é", "\x05"},
-  {"ù", "\x06"},
-  {"ì", "\x07"},
-  {"ò", "\x08"},
-  {"Ç", "\x09"},
-  {"Ø", "\x0B"},
-  {"ø", "\x0C"},
-  {"Å", "\x0E"},
-  {"å", "\x0F"},
-  {"Δ", "\x10"},
-  {"_", "\x11"},
-  {"Φ", "\x12"},
-  {"Γ", "\x13"},
-  {"Λ", "\x14"},
-  {"Ω", "\x15"},
-  {"Π", "\x16"},
-  {"Ψ", "\x17"},
-  {"Σ", "\x18"},
-  {"Θ", "\x19"},
-  {"Ξ", "\x1A"},
-  {"Æ", "\x1C"},
-  {"æ", "\x1D"},
-  {"ß", "\x1E"},
-  {"É", "\x1F"},
-  {"¤", "\x24"},
-  {"Ä", "\x5B"},
-  {"Ö", "\x5C"},
-  {"Ñ", "\x5D"},
-  {"Ü", "\x5E"},
-  {"§", "\x5F"},
-  {"¿", "\x60"},
-  {"ä", "\x7B"},
-  {"ö", "\x7C"},
-  {"ñ", "\x7D"},
-  {"ü", "\x7E"},
-  {"à", "\x7F"},
-  {"^", "\x1B\x14"},
-  {"{", "\x1B\x28"},
-  {"}", "\x1B\x29"},
-  {"\\", "\x1B\x2F"},
-  {"[", "\x1B\x3C"},
-  {"~", "\x1B\x3D"},
-  {"]", "\x1B\x3E"},
-  {"|", "\x1B\x40"},
-  {"€", "\x1B\x65"}
+
+namespace {
+// A GSM 03.38 code, with the escape in the high byte for the extension table.
+const uint16_t kEscape = 0x1B00;
+const uint16_t kNone = 0xFFFF;
+const char32_t kInvalid = 0xFFFFFFFF;
+
+struct Mapping {
+  char32_t code_point;
+  uint16_t gsm;
 };
 
-const std::unordered_map<std::string, std::string> GsmEncoder::utf8_map_ = {
-  {"\x00", "@"},
-  {"\x01", "£"},
-  {"\x02", "$"},
-  {"\x03", "¥"},
-  {"\x04", "è"},
-  {"\x05", "é"},
-  {"\x06", "ù"},
-  {"\x07", "ì"},
-  {"\x08", "ò"},
-  {"\x09", "Ç"},
-  {"\x0B", "Ø"},
-  {"\x0C", "ø"},
-  {"\x0E", "Å"},
-  {"\x0F", "å"},
-  {"\x10", "Δ"},
-  {"\x11", "_"},
-  {"\x12", "Φ"},
-  {"\x13", "Γ"},
-  {"\x14", "Λ"},
-  {"\x15", "Ω"},
-  {"\x16", "Π"},
-  {"\x17", "Ψ"},
-  {"\x18", "Σ"},
-  {"\x19", "Θ"},
-  {"\x1A", "Ξ"},
-  {"\x1C", "Æ"},
-  {"\x1D", "æ"},
-  {"\x1E", "ß"},
-  {"\x1F", "É"},
-  {"\x24", "¤"},
-  {"\x5B", "Ä"},
-  {"\x5C", "Ö"},
-  {"\x5D", "Ñ"},
-  {"\x5E", "Ü"},
-  {"\x5F", "§"},
-  {"\x60", "¿"},
-  {"\x7B", "ä"},
-  {"\x7C", "ö"},
-  {"\x7D", "ñ"},
-  {"\x7E", "ü"},
-  {"\x7F", "à"},
-  {"\x1B\x14", "^"},
-  {"\x1B\x28", "{"},
-  {"\x1B\x29", "}"},
-  {"\x1B\x2F", "\\"},
-  {"\x1B\x3C", "["},
-  {"\x1B\x3D", "~"},
-  {"\x1B\x3E", "]"},
-  {"\x1B\x40", "|"},
-  {"\x1B\x65", "€"},
+// Characters of GSM 03.38 whose code differs from their code point.
+// The rest of the basic table, LF, CR and most of printable ASCII, is the same as in ASCII.
+constexpr Mapping kGsm0338[] = {
+  {U'@', 0x00},
+  {U'£', 0x01},
+  {U'$', 0x02},
+  {U'¥', 0x03},
+  {U'è', 0x04},
+  {U'é', 0x05},
+  {U'ù', 0x06},
+  {U'ì', 0x07},
+  {U'ò', 0x08},
+  {U'Ç', 0x09},
+  {U'Ø', 0x0B},
+  {U'ø', 0x0C},
+  {U'Å', 0x0E},
+  {U'å', 0x0F},
+  {U'Δ', 0x10},
+  {U'_', 0x11},
+  {U'Φ', 0x12},
+  {U'Γ', 0x13},
+  {U'Λ', 0x14},
+  {U'Ω', 0x15},
+  {U'Π', 0x16},
+  {U'Ψ', 0x17},
+  {U'Σ', 0x18},
+  {U'Θ', 0x19},
+  {U'Ξ', 0x1A},
+  {U'Æ', 0x1C},
+  {U'æ', 0x1D},
+  {U'ß', 0x1E},
+  {U'É', 0x1F},
+  {U'¤', 0x24},
+  {U'¡', 0x40},
+  {U'Ä', 0x5B},
+  {U'Ö', 0x5C},
+  {U'Ñ', 0x5D},
+  {U'Ü', 0x5E},
+  {U'§', 0x5F},
+  {U'¿', 0x60},
+  {U'ä', 0x7B},
+  {U'ö', 0x7C},
+  {U'ñ', 0x7D},
+  {U'ü', 0x7E},
+  {U'à', 0x7F},
+  {U'\f', kEscape | 0x0A},
+  {U'^', kEscape | 0x14},
+  {U'{', kEscape | 0x28},
+  {U'}', kEscape | 0x29},
+  {U'\\', kEscape | 0x2F},
+  {U'[', kEscape | 0x3C},
+  {U'~', kEscape | 0x3D},
+  {U']', kEscape | 0x3E},
+  {U'|', kEscape | 0x40},
+  {U'€', kEscape | 0x65}
 };
 
-string GsmEncoder::EncodeGsm0338(const string &input) {
-  string out;
-  // GSM 03.38 encoding will always result in equal or less chars, so resize to input length
-  out.reserve(input.length());
-
-  for (unsigned int i = 0; i < input.length(); i++) {
-    uint8_t code = static_cast<uint8_t>(input[i]);
-    if (code == 0x40) {  // @
-      out += '\0';
-    } else if (code == 0x60) {  // `
-      out += '?';
-    } else if (code == 0x24) {  // $
-      out += "\x02";
-    } else if (code >= 0x5B && code <= 0x5F) {  // 0x5B-05F
-      char c[] = { input[i], '\0' };
-      auto it = gsm0338_map_.find(c);
-
-      if (it == gsm0338_map_.end()) {  // just in case
-        out += input[i];
-      } else {
-        out += it->second;
-      }
-    } else if (code >= 0x20 && code <= 0x7A) {  // 0x20 - 0x7A (except 0x40, 0x24, 0x5B-0x5F and 0x60)
-      out += input[i];
-    } else if (code >= 0x7B && code <= 0x7E) {  // 0x7B - 0x7E
-      char c[] = { input[i], '\0' };
-      auto it = gsm0338_map_.find(c);
-
-      if (it == gsm0338_map_.end()) {  // just in case
-        out += input[i];
-      } else {
-        out += it->second;
+// Returns true for the octets which are the same in ASCII and GSM 03.38, and copied as they are.
+constexpr bool IsPlain(const char32_t c) {
+  return c >= 0x20 && c <= 0x7A && c != 0x24 && c != 0x40 && (c < 0x5B || c > 0x60);
+}
+
+constexpr bool IsSameAsAscii(const char32_t c) {
+  return IsPlain(c) || c == '\n' || c == '\r';
+}
+
+// GSM 03.38 codes of the code points below 0x100.
+constexpr std::array<uint16_t, 256> MakeLatin1Table() {
+  std::array<uint16_t, 256> table {};
+  for (char32_t c = 0; c < table.size(); ++c) {
+    table[c] = IsSameAsAscii(c) ? static_cast<uint16_t>(c) : kNone;
+  }
+  for (const Mapping &mapping : kGsm0338) {
+    if (mapping.code_point < table.size()) {
+      table[mapping.code_point] = mapping.gsm;
+    }
+  }
+  return table;
+}
+
+constexpr size_t CountWideMappings() {
+  size_t count = 0;
+  for (const Mapping &mapping : kGsm0338) {
+    count += mapping.code_point >= 0x100 ? 1 : 0;
+  }
+  return count;
+}
+
+// GSM 03.38 codes of the code points from 0x100, sorted by code point.
+constexpr std::array<Mapping, CountWideMappings()> MakeWideTable() {
+  std::array<Mapping, CountWideMappings()> table {};
+  size_t size = 0;
+  for (const Mapping &mapping : kGsm0338) {
+    if (mapping.code_point < 0x100) {
+      continue;
+    }
+    size_t i = size++;
+    for (; i > 0 && table[i - 1].code_point > mapping.code_point; --i) {
+      table[i] = table[i - 1];
+    }
+    table[i] = mapping;
+  }
+  return table;
+}
+
+// Code points of the basic table, or of the extension table if extension is set. 0 where there is none.
+constexpr std::array<char32_t, 128> MakeDecodeTable(const bool extension) {
+  std::array<char32_t, 128> table {};
+  for (char32_t c = 0; c < table.size() && !extension; ++c) {
+    table[c] = IsSameAsAscii(c) ? c : 0;
+  }
+  for (const Mapping &mapping : kGsm0338) {
+    if ((mapping.gsm >= kEscape) == extension) {
+      table[mapping.gsm & 0x7F] = mapping.code_point;
+    }
+  }
+  return table;
+}
+
+constexpr std::array<uint16_t, 256> kEncodeLatin1 = MakeLatin1Table();
+constexpr std::array<Mapping, CountWideMappings()> kEncodeWide = MakeWideTable();
+constexpr std::array<char32_t, 128> kDecodeBasic = MakeDecodeTable(false);
+constexpr std::array<char32_t, 128> kDecodeExtension = MakeDecodeTable(true);
+
+constexpr std::array<bool, 256> MakePlainTable() {
+  std::array<bool, 256> table {};
+  for (char32_t c = 0; c < table.size(); ++c) {
+    table[c] = IsPlain(c);
+  }
+  return table;
+}
+
+constexpr std::array<bool, 256> kPlain = MakePlainTable();
+
+inline unsigned int CountTrailingZeros(const uint32_t mask) {
+#if defined(_MSC_VER)
+  unsigned long index;  // NOLINT(runtime/int)
+  _BitScanForward(&index, mask);
+  return index;
+#else
+  return __builtin_ctz(mask);
+#endif
+}
+
+#if defined(__AVX2__)
+// Returns a bit for each of the 32 octets, set if the octet is plain.
+inline uint32_t PlainMask(const __m256i x) {
+  __m256i in_range = _mm256_and_si256(_mm256_cmpgt_epi8(x, _mm256_set1_epi8(0x1F)),
+                                      _mm256_cmpgt_epi8(_mm256_set1_epi8(0x7B), x));
+  __m256i special = _mm256_or_si256(
+      _mm256_or_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8(0x24)), _mm256_cmpeq_epi8(x, _mm256_set1_epi8(0x40))),
+      _mm256_and_si256(_mm256_cmpgt_epi8(x, _mm256_set1_epi8(0x5A)), _mm256_cmpgt_epi8(_mm256_set1_epi8(0x61), x)));
+  return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_andnot_si256(special, in_range)));
+}
+#endif
+
+#if defined(SMPP_GSM_SSE2)
+// Returns a bit for each of the 16 octets, set if the octet is plain.
+// Octets from 0x80 compare as negative, so they are out of range.
+inline uint32_t PlainMask(const __m128i x) {
+  __m128i in_range = _mm_and_si128(_mm_cmpgt_epi8(x, _mm_set1_epi8(0x1F)), _mm_cmplt_epi8(x, _mm_set1_epi8(0x7B)));
+  __m128i special = _mm_or_si128(
+      _mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8(0x24)), _mm_cmpeq_epi8(x, _mm_set1_epi8(0x40))),
+      _mm_and_si128(_mm_cmpgt_epi8(x, _mm_set1_epi8(0x5A)), _mm_cmplt_epi8(x, _mm_set1_epi8(0x61))));
+  return static_cast<uint32_t>(_mm_movemask_epi8(_mm_andnot_si128(special, in_range)));
+}
+#else
+// Returns true if all 8 octets are plain, testing them at once with the tricks of
+// https://graphics.stanford.edu/~seander/bithacks.html#HasLessInWord, which are exact below 0x80.
+inline bool IsPlainWord(const uint64_t x) {
+  const uint64_t ones = ~0ULL / 255;
+  const uint64_t high = ones * 0x80;
+  if (x & high) {
+    return false;
+  }
+  uint64_t low = x & (ones * 0x7F);
+  bool has_less = (x - ones * 0x20) & ~x & high;
+  bool has_more = ((x + ones * (0x7F - 0x7A)) | x) & high;
+  bool has_dollar = ((x ^ ones * 0x24) - ones) & ~(x ^ ones * 0x24) & high;
+  bool has_at = ((x ^ ones * 0x40) - ones) & ~(x ^ ones * 0x40) & high;
+  bool has_between = ((ones * (0x7F + 0x61) - low) & ~x & (low + ones * (0x7F - 0x5A))) & high;
+  return !(has_less || has_more || has_dollar || has_at || has_between);
+}
+#endif
+
+// Returns the number of plain octets at the start of data, which are copied as they are.
+inline size_t PlainPrefix(const char *data, const size_t size) {
+  size_t i = 0;
+#if defined(__AVX2__)
+  for (; i + 32 <= size; i += 32) {
+    uint32_t mask = ~PlainMask(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i)));
+    if (mask != 0) {
+      return i + CountTrailingZeros(mask);
+    }
+  }
+#endif
+#if defined(SMPP_GSM_SSE2)
+  for (; i + 16 <= size; i += 16) {
+    uint32_t mask = ~PlainMask(_mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i))) & 0xFFFF;
+    if (mask != 0) {
+      return i + CountTrailingZeros(mask);
+    }
+  }
+#else
+  for (; i + 8 <= size; i += 8) {
+    uint64_t word;
+    std::memcpy(&word, data + i, sizeof(word));
+    if (!IsPlainWord(word)) {
+      break;
+    }
+  }
+#endif
+  while (i < size && kPlain[static_cast<uint8_t>(data[i])]) {
+    ++i;
+  }
+  return i;
+}
+
+// Decodes the UTF-8 character at data[*i] and moves i past it.
+// @return The code point, or kInvalid for an invalid sequence, of which only the first octet is skipped.
+inline char32_t DecodeUtf8(const char *data, const size_t size, size_t *i) {
+  uint8_t lead = static_cast<uint8_t>(data[*i]);
+  size_t length;
+  char32_t code_point;
+  char32_t min;
+  if (lead < 0x80) {
+    ++*i;
+    return lead;
+  } else if (lead >= 0xC0 && lead <= 0xDF) {
+    length = 2;
+    code_point = lead & 0x1F;
+    min = 0x80;
+  } else if (lead >= 0xE0 && lead <= 0xEF) {
+    length = 3;
+    code_point = lead & 0x0F;
+    min = 0x800;
+  } else if (lead >= 0xF0 && lead <= 0xF4) {
+    length = 4;
+    code_point = lead & 0x07;
+    min = 0x10000;
+  } else {
+    ++*i;
+    return kInvalid;
+  }
+
+  if (size - *i < length) {
+    ++*i;
+    return kInvalid;
+  }
+  for (size_t j = 1; j < length; ++j) {
+    uint8_t octet = static_cast<uint8_t>(data[*i + j]);
+    if ((octet & 0xC0) != 0x80) {
+      ++*i;
+      return kInvalid;
+    }
+    code_point = (code_point << 6) | (octet & 0x3F);
+  }
+  if (code_point < min || code_point > 0x10FFFF || (code_point >= 0xD800 && code_point <= 0xDFFF)) {
+    ++*i;
+    return kInvalid;
+  }
+  *i += length;
+  return code_point;
+}
+
+inline void AppendUtf8(string *out, const char32_t code_point) {
+  if (code_point < 0x80) {
+    *out += static_cast<char>(code_point);
+  } else if (code_point < 0x800) {
+    *out += static_cast<char>(0xC0 | (code_point >> 6));
+    *out += static_cast<char>(0x80 | (code_point & 0x3F));
+  } else {
+    *out += static_cast<char>(0xE0 | (code_point >> 12));
+    *out += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+    *out += static_cast<char>(0x80 | (code_point & 0x3F));
+  }
+}
+
+inline uint16_t LookupGsm0338(const char32_t code_point) {
+  if (code_point < kEncodeLatin1.size()) {
+    return kEncodeLatin1[code_point];
+  }
+  auto it = std::lower_bound(kEncodeWide.begin(), kEncodeWide.end(), code_point,
+                             [](const Mapping &mapping, char32_t c) { return mapping.code_point < c; });
+  return it != kEncodeWide.end() && it->code_point == code_point ? it->gsm : kNone;
+}
+// Appends input encoded in GSM 0338 to out.
+// @param unmappable The offsets in input of the characters replaced with '?' are appended to it, unless it is null.
+// @param stop Stop at the first character without a GSM 0338 encoding, rather than replacing it. Invalid UTF-8 is
+//   still replaced.
+// @return false if stopped at a character without a GSM 0338 encoding.
+bool AppendGsm0338(const string &input, string *out, std::vector<size_t> *unmappable, const bool stop) {
+  const char *data = input.data();
+  size_t size = input.length();
+  for (size_t i = 0; i < size;) {
+    size_t plain = PlainPrefix(data + i, size - i);
+    out->append(data + i, plain);
+    i += plain;
+    if (i == size) {
+      break;
+    }
+
+    size_t offset = i;
+    char32_t code_point = DecodeUtf8(data, size, &i);
+    uint16_t gsm = code_point != kInvalid ? LookupGsm0338(code_point) : kNone;
+    if (gsm == kNone) {
+      if (stop && code_point != kInvalid) {
+        return false;
       }
-    } else if (code >= 0x7F) {  // UTF-8 escape sequence
-      std::string s;
-      if (code >= 0xC0 && code <= 0xDF) {  // Double byte UTF-8
-        char c[2] = { input[i], input[++i] };
-        s = std::string(c, 2);
-      } else if (code >= 0xE0 && code <= 0xF0) {  // Triple byte UTF-8
-        char c[3] = { input[i], input[++i], input[++i] };
-        s = std::string(c, 3);
-      } else {  // Quad byte UTF-8
-        char c[4] = { input[i], input[++i], input[++i], input[++i] };
-        s = std::string(c, 4);
+      *out += '?';
+      if (unmappable != nullptr) {
+        unmappable->push_back(offset);
       }
+    } else if (gsm >= kEscape) {
+      *out += '\x1B';
+      *out += static_cast<char>(gsm & 0xFF);
+    } else {
+      *out += static_cast<char>(gsm);
+    }
+  }
+  return true;
+}
 
-      auto it = gsm0338_map_.find(s);
-      if (it != gsm0338_map_.end()) {
-        out += it->second;
-      } else {
-        out += '?';
-      }
-      // Unprintable char: ignore
+// Returns the number of ASCII octets at the start of data, widening them into UCS-2 at out on the way.
+// @param out Room for twice the octets of data.
+inline size_t WidenAscii(const char *data, const size_t size, char *out) {
+  size_t i = 0;
+#if defined(SMPP_GSM_SSE2)
+  const __m128i zero = _mm_setzero_si128();
+  for (; i + 16 <= size; i += 16) {
+    __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+    if (_mm_movemask_epi8(x) != 0) {
+      break;
+    }
+    // A zero octet ahead of each character makes it big endian.
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 2 * i), _mm_unpacklo_epi8(zero, x));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 2 * i + 16), _mm_unpackhi_epi8(zero, x));
+  }
+#endif
+  for (; i < size && static_cast<uint8_t>(data[i]) < 0x80; ++i) {
+    out[2 * i] = 0;
+    out[2 * i + 1] = data[i];
+  }
+  return i;
+}
+
+// Appends input encoded in UCS-2, big endian, to out.
+void AppendUcs2(const string &input, string *out) {
+  // No character takes more octets in UCS-2 than in UTF-8, except ASCII, which takes two.
+  size_t start = out->size();
+  out->resize(start + input.length() * 2);
+  const char *data = input.data();
+  size_t size = input.length();
+  char *begin = &(*out)[0];
+  char *it = begin + start;
+  for (size_t i = 0; i < size;) {
+    size_t ascii = WidenAscii(data + i, size - i, it);
+    it += 2 * ascii;
+    i += ascii;
+    if (i == size) {
+      break;
+    }
+
+    char32_t code_point = DecodeUtf8(data, size, &i);
+    if (code_point == kInvalid) {
+      code_point = 0xFFFD;
+    }
+    if (code_point >= 0x10000) {
+      code_point -= 0x10000;
+      char32_t high = 0xD800 | (code_point >> 10);
+      char32_t low = 0xDC00 | (code_point & 0x3FF);
+      *it++ = static_cast<char>(high >> 8);
+      *it++ = static_cast<char>(high & 0xFF);
+      *it++ = static_cast<char>(low >> 8);
+      *it++ = static_cast<char>(low & 0xFF);
+    } else {
+      *it++ = static_cast<char>(code_point >> 8);
+      *it++ = static_cast<char>(code_point & 0xFF);
     }
   }
+  out->resize(it - begin);
+}
+}  // namespace
+
+string GsmEncoder::EncodeGsm0338(const string &input) {
+  return EncodeGsm0338(input, nullptr);
+}
+
+string GsmEncoder::EncodeGsm0338(const string &input, std::vector<size_t> *unmappable) {
+  string out;
+  // Only the extension table takes more octets than UTF-8, so leave room for an escape in eight chars.
+  out.reserve(input.length() + input.length() / 8);
+  AppendGsm0338(input, &out, unmappable, false);
+  return out;
+}
+
+string GsmEncoder::EncodeUcs2(const string &input) {
+  string out;
+  AppendUcs2(input, &out);
+  return out;
+}
+
+string GsmEncoder::EncodeSms(const string &input, SmppParams *params) {
+  string out;
+  // Room for either encoding, so switching to UCS-2 doesn't allocate again.
+  out.reserve(input.length() * 2);
+  if (AppendGsm0338(input, &out, nullptr, true)) {
+    params->data_coding = DataCoding::DEFAULT;
+    return out;
+  }
+  params->data_coding = DataCoding::UCS2;
+  out.clear();
+  AppendUcs2(input, &out);
   return out;
 }
 
@@ -177,26 +456,37 @@ string GsmEncoder::EncodeUtf8(const string &input) {
   string out;
   // Most UTF-8 sequences are two-byte, with ASCII chars still one-byte, so double size should suffice.
   out.reserve(input.length() * 2);
-  for (unsigned int i = 0; i < input.length(); i++) {
-    uint8_t code = static_cast<uint8_t>(input[i]);
 
-    if (code != 0x24 && code >= 0x20 && code <= 0x5A) {  // Shortcut (avoid dictionary)
-      out += input[i];
-    } else if (code >= 0x61 && code <= 0x7A) {  // Shortcut (avoid dictionary)
-      out += input[i];
-    } else {
-      char c[2] = { input[i], '\0' };
-      string s(c);
-      if (code == 0x1B) {  // GSM 03.38 escape sequence read next
-        c[1] = input[++i];
-        s = string(c, 2);
+  const char *data = input.data();
+  size_t size = input.length();
+  for (size_t i = 0; i < size;) {
+    size_t plain = PlainPrefix(data + i, size - i);
+    out.append(data + i, plain);
+    i += plain;
+    if (i == size) {
+      break;
+    }
+
+    uint8_t code = static_cast<uint8_t>(data[i++]);
+    if (code >= 0x80) {  // Not GSM 03.38, passed on as it is
+      out += static_cast<char>(code);
+      continue;
+    }
+    char32_t code_point = kDecodeBasic[code];
+    if (code == 0x1B) {  // GSM 03.38 escape sequence, read next
+      if (i == size) {
+        break;
       }
-      auto it = utf8_map_.find(s);
-      if (it != utf8_map_.end()) {
-        out += it->second;
-      } else {
-        out += input[i];
+      code = static_cast<uint8_t>(data[i++]);
+      if (code >= 0x80) {
+        out += static_cast<char>(code);
+        continue;
       }
+      // Codes missing from the extension table are shown as in the basic table.
+      code_point = kDecodeExtension[code] != 0 ? kDecodeExtension[code] : kDecodeBasic[code];
+    }
+    if (code_point != 0) {
+      AppendUtf8(&out, code_point);
     }
   }
   return out;
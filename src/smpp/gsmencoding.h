@@ -5,7 +5,9 @@
 #pragma once
 
 #include <string>
-#include <unordered_map>
+#include <vector>
+
+#include "smpp/smpp_params.h"
 
 namespace smpp {
 namespace encoding {
@@ -13,17 +15,35 @@ namespace encoding {
 class GsmEncoder {
  public:
   // Returns the input string encoded in GSM 0338.
-  // @param input String to be encoded.
+  // Characters without a GSM 0338 encoding, and invalid UTF-8, are replaced with '?'.
+  // @param input UTF-8 string to be encoded.
   // @return Encoded string.
   static std::string EncodeGsm0338(const std::string &input);
 
+  // Returns the input string encoded in GSM 0338, reporting the characters without a GSM 0338 encoding.
+  // @param input UTF-8 string to be encoded.
+  // @param unmappable The offsets in input of the characters replaced with '?' are appended to it.
+  // @return Encoded string.
+  static std::string EncodeGsm0338(const std::string &input, std::vector<size_t> *unmappable);
+
+  // Returns the input string encoded in UCS-2, big endian, as for DataCoding::UCS2.
+  // Characters beyond the Basic Multilingual Plane take a UTF-16 surrogate pair, invalid UTF-8 becomes U+FFFD.
+  // @param input UTF-8 string to be encoded.
+  // @return Encoded string.
+  static std::string EncodeUcs2(const std::string &input);
+
+  // Returns the input string encoded in GSM 0338 if every character has a GSM 0338 encoding, and in UCS-2 otherwise.
+  // Text which fits GSM 0338 is scanned once. Otherwise it is encoded again in UCS-2, so the text before
+  // the first character GSM 0338 lacks is scanned twice.
+  // @param input UTF-8 string to be encoded.
+  // @param params Its data_coding is set to DataCoding::DEFAULT or DataCoding::UCS2, to match.
+  // @return Encoded string.
+  static std::string EncodeSms(const std::string &input, SmppParams *params);
+
   // Converts an GSM 0338 encoded string into UTF8.
   // @param input String to be encoded.
   // @return UTF8-encoded string.
   static std::string EncodeUtf8(const std::string &input);
- private:
-  static const std::unordered_map<std::string, std::string> gsm0338_map_;
-  static const std::unordered_map<std::string, std::string> utf8_map_;
 };
 }  // namespace encoding
 }  // namespace smpp
@@ -0,0 +1,130 @@
+// Copyright (C) 2011-2014 OnlineCity
+// Licensed under the MIT license, which can be read at: http://www.opensource.org/licenses/mit-license.php
+// @author hd@onlinecity.dk & td@onlinecity.dk
+
+#include "smpp/metrics.h"
+#include <algorithm>
+#include <cmath>
+
+namespace smpp {
+namespace {
+inline uint64_t Load(const std::atomic<uint64_t> &counter) {
+  return counter.load(std::memory_order_relaxed);
+}
+}  // namespace
+
+MetricCommand GetMetricCommand(const CommandId &command_id) {
+  // Responses share the histogram of their request.
+  switch (static_cast<CommandId>(static_cast<uint32_t>(command_id) & ~static_cast<uint32_t>(CommandId::GENERIC_NACK))) {
+    case CommandId::BIND_RECEIVER:
+    case CommandId::BIND_TRANSMITTER:
+    case CommandId::BIND_TRANSCEIVER:
+      return MetricCommand::BIND;
+    case CommandId::SUBMIT_SM:
+      return MetricCommand::SUBMIT_SM;
+    case CommandId::SUBMIT_MULTI:
+      return MetricCommand::SUBMIT_MULTI;
+    case CommandId::DATA_SM:
+      return MetricCommand::DATA_SM;
+    case CommandId::QUERY_SM:
+      return MetricCommand::QUERY_SM;
+    case CommandId::ENQUIRE_LINK:
+      return MetricCommand::ENQUIRE_LINK;
+    case CommandId::UNBIND:
+      return MetricCommand::UNBIND;
+    default:
+      return MetricCommand::OTHER;
+  }
+}
+
+uint64_t HistogramSnapshot::BucketLimit(const size_t bucket) {
+  if (bucket < 32) {
+    return bucket;
+  }
+  if (bucket >= BUCKETS - 1) {
+    return UINT64_MAX;
+  }
+  size_t magnitude = (bucket - 32) / 16 + 5;
+  uint64_t sub = (bucket - 32) % 16;
+  return ((16 + sub + 1) << (magnitude - 4)) - 1;
+}
+
+uint64_t HistogramSnapshot::Percentile(const double fraction) const {
+  if (count == 0) {
+    return 0;
+  }
+  uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(fraction * count)));
+  uint64_t seen = 0;
+  for (size_t i = 0; i < BUCKETS; ++i) {
+    seen += buckets[i];
+    if (seen >= rank) {
+      return std::min(BucketLimit(i), max);
+    }
+  }
+  return max;
+}
+
+LatencyHistogram::LatencyHistogram() :
+  count_(0),
+  sum_(0),
+  max_(0),
+  buckets_() {
+  for (auto &bucket : buckets_) {
+    bucket.store(0, std::memory_order_relaxed);
+  }
+}
+
+HistogramSnapshot LatencyHistogram::Snapshot() const {
+  HistogramSnapshot snapshot;
+  snapshot.count = Load(count_);
+  snapshot.sum = Load(sum_);
+  snapshot.max = Load(max_);
+  for (size_t i = 0; i < buckets_.size(); ++i) {
+    snapshot.buckets[i] = Load(buckets_[i]);
+  }
+  return snapshot;
+}
+
+Metrics::Metrics() :
+  pdus_in(0),
+  pdus_out(0),
+  bytes_in(0),
+  bytes_out(0),
+  write_queue(0),
+  deliver_queue(0),
+  in_flight(0),
+  window_queue(0),
+  timeouts(0),
+  transport_errors(0),
+  binds(0),
+  reconnects(0),
+  statuses_(),
+  latency_() {
+  for (auto &status : statuses_) {
+    status.store(0, std::memory_order_relaxed);
+  }
+}
+
+MetricsSnapshot Metrics::Snapshot() const {
+  MetricsSnapshot snapshot;
+  snapshot.pdus_in = Load(pdus_in);
+  snapshot.pdus_out = Load(pdus_out);
+  snapshot.bytes_in = Load(bytes_in);
+  snapshot.bytes_out = Load(bytes_out);
+  snapshot.write_queue = Load(write_queue);
+  snapshot.deliver_queue = Load(deliver_queue);
+  snapshot.in_flight = Load(in_flight);
+  snapshot.window_queue = Load(window_queue);
+  snapshot.timeouts = Load(timeouts);
+  snapshot.transport_errors = Load(transport_errors);
+  snapshot.binds = Load(binds);
+  snapshot.reconnects = Load(reconnects);
+  for (size_t i = 0; i < statuses_.size(); ++i) {
+    snapshot.statuses[i] = Load(statuses_[i]);
+  }
+  for (size_t i = 0; i < latency_.size(); ++i) {
+    snapshot.latency[i] = latency_[i].Snapshot();
+  }
+  return snapshot;
+}
+}  // namespace smpp
@@ -0,0 +1,173 @@
+// Copyright (C) 2011-2014 OnlineCity
+// Licensed under the MIT license, which can be read at: http://www.opensource.org/licenses/mit-license.php
+// @author hd@onlinecity.dk & td@onlinecity.dk
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#include "smpp/smpp.h"
+
+namespace smpp {
+// Requests whose response time is kept in a histogram of its own.
+enum class MetricCommand : uint8_t {
+  BIND,
+  SUBMIT_SM,
+  SUBMIT_MULTI,
+  DATA_SM,
+  QUERY_SM,
+  ENQUIRE_LINK,
+  UNBIND,
+  OTHER,
+  COUNT
+};
+
+// Returns the histogram a request, or the response to it, is kept in.
+MetricCommand GetMetricCommand(const CommandId &command_id);
+
+// Copy of a latency histogram.
+struct HistogramSnapshot {
+  // Values below 32 us get a bucket each, above that every power of two is split into 16 buckets,
+  // so a bucket is at most 1/16 wider than the values in it. Values from 2^32 us, over an hour,
+  // are kept in a last bucket of their own.
+  static const size_t BUCKETS = 32 + 27 * 16 + 1;
+
+  uint64_t count;
+  uint64_t sum;  // Microseconds.
+  uint64_t max;  // Microseconds.
+  std::array<uint64_t, BUCKETS> buckets;
+
+  // Returns the bucket a value in microseconds is counted in.
+  static inline size_t Bucket(const uint64_t us) {
+    if (us < 32) {
+      return us;
+    }
+#if defined(_MSC_VER)
+    unsigned long magnitude;  // NOLINT(runtime/int)
+    _BitScanReverse64(&magnitude, us);
+#else
+    int magnitude = 63 - __builtin_clzll(us);
+#endif
+    if (magnitude > 31) {
+      return BUCKETS - 1;
+    }
+    return 32 + (magnitude - 5) * 16 + ((us >> (magnitude - 4)) & 15);
+  }
+
+  // Returns the highest value counted in a bucket.
+  static uint64_t BucketLimit(const size_t bucket);
+
+  // Returns the value in microseconds which the given fraction of the values are at or below.
+  // The value is rounded up to the limit of its bucket, but never above max.
+  // @param fraction From 0 to 1, eg. 0.999 for the 99.9th percentile.
+  uint64_t Percentile(const double fraction) const;
+
+  // Returns the mean in microseconds.
+  inline double Mean() const {
+    return count > 0 ? static_cast<double>(sum) / count : 0;
+  }
+};
+
+// Histogram of latencies in microseconds, which may be recorded and copied concurrently.
+// Recording is a few relaxed atomic increments and never allocates.
+class LatencyHistogram {
+ public:
+  LatencyHistogram();
+
+  inline void Record(const std::chrono::microseconds &latency) {
+    uint64_t us = latency.count() > 0 ? latency.count() : 0;
+    buckets_[HistogramSnapshot::Bucket(us)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(us, std::memory_order_relaxed);
+    uint64_t max = max_.load(std::memory_order_relaxed);
+    while (us > max && !max_.compare_exchange_weak(max, us, std::memory_order_relaxed)) {
+    }
+  }
+
+  HistogramSnapshot Snapshot() const;
+
+ private:
+  std::atomic<uint64_t> count_;
+  std::atomic<uint64_t> sum_;
+  std::atomic<uint64_t> max_;
+  std::array<std::atomic<uint64_t>, HistogramSnapshot::BUCKETS> buckets_;
+};
+
+// Copy of the metrics of a client, taken with SmppClient::metrics().
+struct MetricsSnapshot {
+  // Command statuses from 0 to 0xff are counted each, higher ones in the last element.
+  static const size_t STATUSES = 0x101;
+
+  uint64_t pdus_in;
+  uint64_t pdus_out;
+  uint64_t bytes_in;
+  uint64_t bytes_out;
+  uint64_t write_queue;  // PDUs waiting to be written.
+  uint64_t deliver_queue;  // SMSes from the SMSC waiting to be read.
+  uint64_t in_flight;  // Requests awaiting a response.
+  uint64_t window_queue;  // Requests waiting for room in the window.
+  uint64_t timeouts;  // Requests which got no response in time.
+  uint64_t transport_errors;
+  uint64_t binds;
+  uint64_t reconnects;  // Binds of a client which was bound before.
+  std::array<uint64_t, STATUSES> statuses;  // Responses received, by command status.
+  std::array<HistogramSnapshot, static_cast<size_t>(MetricCommand::COUNT)> latency;  // Request to response.
+
+  // Returns the number of responses received with a status.
+  inline uint64_t status(const ESME &status) const {
+    return statuses[std::min<size_t>(static_cast<uint32_t>(status), STATUSES - 1)];
+  }
+
+  inline const HistogramSnapshot &latency_of(const MetricCommand &command) const {
+    return latency[static_cast<size_t>(command)];
+  }
+};
+
+// Live metrics of a client. The client updates them from the thread running its io_context,
+// Snapshot may be taken from any thread.
+class Metrics {
+ public:
+  Metrics();
+
+  inline void Add(std::atomic<uint64_t> *counter, const uint64_t n = 1) {
+    counter->fetch_add(n, std::memory_order_relaxed);
+  }
+
+  inline void Set(std::atomic<uint64_t> *gauge, const uint64_t value) {
+    gauge->store(value, std::memory_order_relaxed);
+  }
+
+  // Counts a response and its latency.
+  inline void RecordResponse(const CommandId &command_id, const ESME &status,
+                             const std::chrono::microseconds &latency) {
+    Add(&statuses_[std::min<size_t>(static_cast<uint32_t>(status), MetricsSnapshot::STATUSES - 1)]);
+    latency_[static_cast<size_t>(GetMetricCommand(command_id))].Record(latency);
+  }
+
+  MetricsSnapshot Snapshot() const;
+
+  std::atomic<uint64_t> pdus_in;
+  std::atomic<uint64_t> pdus_out;
+  std::atomic<uint64_t> bytes_in;
+  std::atomic<uint64_t> bytes_out;
+  std::atomic<uint64_t> write_queue;
+  std::atomic<uint64_t> deliver_queue;
+  std::atomic<uint64_t> in_flight;
+  std::atomic<uint64_t> window_queue;
+  std::atomic<uint64_t> timeouts;
+  std::atomic<uint64_t> transport_errors;
+  std::atomic<uint64_t> binds;
+  std::atomic<uint64_t> reconnects;
+
+ private:
+  std::array<std::atomic<uint64_t>, MetricsSnapshot::STATUSES> statuses_;
+  std::array<LatencyHistogram, static_cast<size_t>(MetricCommand::COUNT)> latency_;
+};
+}  // namespace smpp
@@ -3,27 +3,21 @@
 // @author hd@onlinecity.dk & td@onlinecity.dk
 
 #include "smpp/pdu.h"
-#ifdef WIN32
-#include <WinSock2.h>
-#else
-#include <netinet/in.h>
-#endif
+#include <algorithm>
 #include <iostream> //NOLINT
 #include <string>
+#include <utility>
 #include "smpp/hexdump.h"
 
 namespace smpp {
-using std::ios;
-using std::ios_base;
-using std::ends;
 using std::streamsize;
 using std::dec;
 using std::hex;
 using std::endl;
 
 PDU::PDU() :
-  sb_(""),
-  buf_(&sb_),
+  octets_(),
+  read_pos_(0),
   command_id_(CommandId::NOT_DEFINED),
   command_status_(ESME::ROK),
   seq_no_(0),
@@ -34,47 +28,71 @@ PDU::PDU() :
 PDU::PDU(
     const CommandId &command_id,
     const ESME &command_status,
-    const uint32_t &seq_no) :
-  sb_(""),
-  buf_(&sb_),
+    const uint32_t &seq_no,
+    std::pmr::memory_resource *memory_resource) :
+  octets_(memory_resource),
+  read_pos_(HEADERFIELD_SIZE * 4),
   command_id_(command_id),
   command_status_(command_status),
   seq_no_(seq_no),
   null_terminate_octet_strings_(true),
   null_(false) {
-  (*this) << uint32_t(0);
-  (*this) << command_id_;
-  (*this) << command_status_;
-  (*this) << seq_no_;
+  octets_.reserve(256);  // Fits most PDUs, including a submit_sm with a full short message.
+  WriteHeader(0);
+}
+
+PDU::PDU(
+    const CommandId &command_id,
+    const ESME &command_status,
+    const uint32_t &seq_no,
+    const size_t body_length,
+    std::pmr::memory_resource *memory_resource) :
+  octets_(memory_resource),
+  read_pos_(HEADERFIELD_SIZE * 4),
+  command_id_(command_id),
+  command_status_(command_status),
+  seq_no_(seq_no),
+  null_terminate_octet_strings_(true),
+  null_(false) {
+  octets_.reserve(HEADERFIELD_SIZE * 4 + body_length);
+  WriteHeader(HEADERFIELD_SIZE * 4 + body_length);
 }
 
 PDU::PDU(
     const PduLengthHeader &pduLength,
-    const PduData &pduBuffer) :
-  sb_(""),
-  buf_(&sb_),
+    const PduData &pduBuffer,
+    std::pmr::memory_resource *memory_resource) :
+  octets_(memory_resource),
+  read_pos_(HEADERFIELD_SIZE),
   command_id_(CommandId::NOT_DEFINED),
   command_status_(ESME::ROK),
   seq_no_(0),
   null_terminate_octet_strings_(true),
   null_(false) {
   uint32_t bufSize = PDU::GetPduLength(pduLength);
-  buf_.write(pduLength.data(), HEADERFIELD_SIZE);
-
-  if (buf_.fail()) {
-    throw smpp::SmppException("PDU failed to write length");
-  }
-
-  buf_.write(pduBuffer.c_str(), bufSize - HEADERFIELD_SIZE);
 
-  if (buf_.fail()) {
+  if (bufSize < HEADERFIELD_SIZE * 4 || pduBuffer.size() < bufSize - HEADERFIELD_SIZE) {
     throw smpp::SmppException("PDU failed to write octets");
   }
 
-  buf_.seekg(HEADERFIELD_SIZE, std::ios::cur);
+  octets_.reserve(bufSize);
+  octets_.append(pduLength.data(), HEADERFIELD_SIZE);
+  octets_.append(pduBuffer.data(), bufSize - HEADERFIELD_SIZE);
+  (*this) >> command_id_;
+  (*this) >> command_status_;
+  (*this) >> seq_no_;
+}
 
-  if (buf_.fail()) {
-    throw smpp::SmppException("PDU failed to skip size header");
+PDU::PDU(const char *octets, const size_t len, std::pmr::memory_resource *memory_resource) :
+  octets_(octets, len, memory_resource),
+  read_pos_(HEADERFIELD_SIZE),
+  command_id_(CommandId::NOT_DEFINED),
+  command_status_(ESME::ROK),
+  seq_no_(0),
+  null_terminate_octet_strings_(true),
+  null_(false) {
+  if (len < HEADERFIELD_SIZE * 4) {
+    throw smpp::SmppException("PDU too short");
   }
 
   (*this) >> command_id_;
@@ -83,216 +101,185 @@ PDU::PDU(
 }
 
 PDU::PDU(const PDU &rhs) :
-  sb_(rhs.sb_.str()),
-  buf_(&sb_),
+  octets_(rhs.octets_, rhs.octets_.get_allocator()),
+  read_pos_(0),
   command_id_(rhs.command_id_),
   command_status_(rhs.command_status_),
   seq_no_(rhs.seq_no_),
   null_terminate_octet_strings_(rhs.null_terminate_octet_strings_),
   null_(rhs.null_) {
-  ResetMarker();  // remember to reset the marker after copying.
-}
-
-const PduData PDU::GetOctets() {
-  uint32_t size = Size();
-  uint32_t beSize = htonl(size);
-  buf_.seekp(0, ios::beg);
-  buf_.write(reinterpret_cast<char*>(&beSize), sizeof(uint32_t));
-
-  if (buf_.fail()) {
-    throw smpp::SmppException("PDU failed to write length");
-  }
-
-  buf_.seekp(0, ios::end);
-  buf_.seekg(0, ios::beg);
-  PduData octets;
-  octets.resize(size);
-  buf_.read(&*octets.begin(), size);
-
-  if (buf_.fail()) {
-    throw smpp::SmppException("PDU failed to read octets");
+  if (!null_) {
+    ResetMarker();  // remember to reset the marker after copying.
   }
-
-  // Seek to start of PDU body
-  ResetMarker();
-  return octets;
 }
 
-int PDU::Size() {
-  buf_.seekp(0, ios_base::end);
-  int s = buf_.tellp();
-  return s;
+PDU::PDU(PDU &&rhs) noexcept :
+  octets_(std::move(rhs.octets_)),
+  read_pos_(rhs.read_pos_),
+  command_id_(rhs.command_id_),
+  command_status_(rhs.command_status_),
+  seq_no_(rhs.seq_no_),
+  null_terminate_octet_strings_(rhs.null_terminate_octet_strings_),
+  null_(rhs.null_) {
+  rhs.octets_.clear();
+  rhs.read_pos_ = 0;
 }
 
-PDU &PDU::operator<<(const int &i) {
-  uint8_t x(i);
-  buf_.write(reinterpret_cast<char*>(&x), sizeof(uint8_t));
-
-  if (buf_.fail()) {
-    throw smpp::SmppException("PDU failed to write int");
+PDU &PDU::operator=(const PDU &rhs) {
+  if (this != &rhs) {
+    octets_ = rhs.octets_;
+    command_id_ = rhs.command_id_;
+    command_status_ = rhs.command_status_;
+    seq_no_ = rhs.seq_no_;
+    null_terminate_octet_strings_ = rhs.null_terminate_octet_strings_;
+    null_ = rhs.null_;
+    read_pos_ = 0;
+    if (!null_) {
+      ResetMarker();
+    }
   }
-
   return *this;
 }
 
-PDU &PDU::operator<<(const uint8_t &i) {
-  uint8_t x(i);
-  buf_.write(reinterpret_cast<char*>(&x), sizeof(uint8_t));
-
-  if (buf_.fail()) {
-    throw smpp::SmppException("PDU failed to write uint8_t");
+PDU &PDU::operator=(PDU &&rhs) {
+  if (this != &rhs) {
+    octets_ = std::move(rhs.octets_);
+    read_pos_ = rhs.read_pos_;
+    command_id_ = rhs.command_id_;
+    command_status_ = rhs.command_status_;
+    seq_no_ = rhs.seq_no_;
+    null_terminate_octet_strings_ = rhs.null_terminate_octet_strings_;
+    null_ = rhs.null_;
+    rhs.octets_.clear();
+    rhs.read_pos_ = 0;
   }
-
   return *this;
 }
 
-PDU &PDU::operator<<(const uint16_t &i) {
-  uint16_t j = htons(i);
-  buf_.write(reinterpret_cast<char*>(&j), sizeof(uint16_t));
-
-  if (buf_.fail()) {
-    throw smpp::SmppException("PDU failed to write uint16_t");
-  }
-
-  return *this;
+const PduData PDU::GetOctets() {
+  return PduData(Octets());
 }
 
-PDU &PDU::operator<<(const uint32_t &i) {
-  uint32_t j = htonl(i);
-  buf_.write(reinterpret_cast<char*>(&j), sizeof(uint32_t));
-
-  if (buf_.fail()) {
-    throw smpp::SmppException("PDU failed to write uint32_t");
+std::string_view PDU::Octets() {
+  if (null_) {
+    return std::string_view();
   }
 
-  return *this;
+  // Patch the command length, as the PDU may have grown since the last call.
+  uint32_t size = octets_.size();
+  octets_[0] = static_cast<char>(size >> 24);
+  octets_[1] = static_cast<char>(size >> 16);
+  octets_[2] = static_cast<char>(size >> 8);
+  octets_[3] = static_cast<char>(size);
+  return std::string_view(octets_.data(), octets_.size());
 }
 
 PDU &PDU::operator<<(const std::basic_string<char> &s) {
-  buf_.write(s.c_str(), s.length());  // use buf.write to allow for UCS-2 chars which are 16-bit.
-
-  if (buf_.fail()) {
-    throw smpp::SmppException("PDU failed to write string");
-  }
+  octets_.append(s.data(), s.length());  // append all octets to allow for UCS-2 chars which are 16-bit.
 
   if (null_terminate_octet_strings_) {
-    buf_ << ends;
+    octets_.push_back('\0');
   }
 
   return *this;
 }
 
-PDU &PDU::operator <<(const smpp::SmppAddress s) {
+PDU &PDU::operator <<(const smpp::SmppAddress &s) {
   (*this) << s.ton;
   (*this) << s.npi;
   (*this) << s.value;
   return *this;
 }
 
-PDU &PDU::operator <<(smpp::TLV tlv) {
+PDU &PDU::operator <<(const smpp::TLV &tlv) {
   (*this) << tlv.tag();
   (*this) << tlv.len();
 
   if (tlv.len() != 0) {
-    (*this).AddOctets(tlv.octets(), (uint32_t) tlv.len());
+    octets_.append(tlv.octets().data(), tlv.len());
   }
 
   return *this;
 }
 
 PDU &PDU::AddOctets(const PduData &octets, const streamsize &len) {
-  buf_.write(octets.c_str(), len);
-
-  if (buf_.fail()) {
+  if (len < 0 || static_cast<size_t>(len) > octets.size()) {
     throw smpp::SmppException("PDU failed to write octets");
   }
 
+  octets_.append(octets.data(), len);
   return *this;
 }
 
 void PDU::Skip(int octets) {
-  buf_.seekg(octets, ios_base::cur);
-
-  if (buf_.fail()) {
-    throw smpp::SmppException(buf_.bad() ? "Last PDU IO operation failed" : "PDU seek to invalid pos");
+  bool invalid = octets < 0 ? static_cast<size_t>(-octets) > read_pos_
+                            : static_cast<size_t>(octets) > octets_.size() - read_pos_;
+  if (invalid) {
+    throw smpp::SmppException("PDU seek to invalid pos");
   }
+
+  read_pos_ += octets;
 }
 
 void PDU::ResetMarker() {
   // Seek to start of PDU body (after headers)
-  buf_.seekg(HEADERFIELD_SIZE * 4, ios::beg);
-
-  if (buf_.fail()) {
+  if (octets_.size() < HEADERFIELD_SIZE * 4) {
     throw smpp::SmppException("PDU failed to reset marker");
   }
+
+  read_pos_ = HEADERFIELD_SIZE * 4;
 }
 
 PDU &PDU::operator>>(int &i) {
   uint8_t j;
-  buf_.read(reinterpret_cast<char*>(&j), sizeof(uint8_t));
-
-  if (buf_.fail()) {
-    throw smpp::SmppException(buf_.eof() ? "PDU reached EOF" : "Last PDU IO operation failed");
-  }
-
+  (*this) >> j;
   i = j;
   return *this;
 }
 
-PDU &PDU::operator>>(uint8_t &i) {
-  buf_.read(reinterpret_cast<char*>(&i), sizeof(uint8_t));
-
-  if (buf_.fail()) {
-    throw smpp::SmppException(buf_.eof() ? "PDU reached EOF" : "Last PDU IO operation failed");
-  }
-
+PDU &PDU::operator>>(std::basic_string<char> &s) {
+  std::string_view octets = ReadCString();
+  s.assign(octets.data(), octets.size());
   return *this;
 }
 
-PDU &PDU::operator>>(uint16_t &i) {
-  buf_.read(reinterpret_cast<char*>(&i), sizeof(uint16_t));
-
-  if (buf_.fail()) {
-    throw smpp::SmppException(buf_.eof() ? "PDU reached EOF" : "Last PDU IO operation failed");
+std::string_view PDU::ReadCString() {
+  // Read up to and including the null terminator, or to the end of the PDU if there is none.
+  std::string_view octets;
+  size_t end = octets_.find('\0', read_pos_);
+  if (end == std::pmr::string::npos) {
+    octets = std::string_view(octets_.data() + read_pos_, octets_.size() - read_pos_);
+    read_pos_ = octets_.size();
+  } else {
+    octets = std::string_view(octets_.data() + read_pos_, end - read_pos_);
+    read_pos_ = end + 1;
   }
-
-  i = ntohs(i);
-  return *this;
+  return octets;
 }
 
-PDU &PDU::operator>>(uint32_t &i) {
-  buf_.read(reinterpret_cast<char*>(&i), sizeof(uint32_t));
-
-  if (buf_.fail()) {
-    throw smpp::SmppException(buf_.eof() ? "PDU reached EOF" : "Last PDU IO operation failed");
+void PDU::ReadOctets(PduData *octets, const streamsize &len) {
+  if (len < 0) {
+    throw smpp::SmppException("Last PDU IO operation failed");
   }
 
-  i = ntohl(i);
-  return *this;
-}
-
-PDU &PDU::operator>>(std::basic_string<char> &s) {
-  getline(buf_, s, '\0');
-  return *this;
-}
-
-void PDU::ReadOctets(PduData *octets, const streamsize &len) {
+  // Like istream::readsome, we copy what is there and leave the rest zero.
+  size_t n = std::min(static_cast<size_t>(len), octets_.size() - read_pos_);
+  octets->assign(octets_.data() + read_pos_, n);
   octets->resize(len);
-  buf_.readsome(&*octets->begin(), len);
-
-  if (buf_.fail()) {
-    throw smpp::SmppException(buf_.eof() ? "PDU reached EOF" : "Last PDU IO operation failed");
-  }
+  read_pos_ += n;
 }
 
-bool PDU::HasMoreData() {
-  buf_.peek();  // peek sets eof, it's not set until you try to read or peek at the data
-  return !buf_.eof();
+void PDU::WriteHeader(const uint32_t command_length) {
+  (*this) << command_length;
+  (*this) << command_id_;
+  (*this) << command_status_;
+  (*this) << seq_no_;
 }
 
 uint32_t PDU::GetPduLength(const PduLengthHeader &pduHeader) {
-  auto i = reinterpret_cast<const uint32_t*>(pduHeader.data());
-  return ntohl(*i);
+  auto i = reinterpret_cast<const uint8_t*>(pduHeader.data());
+  return static_cast<uint32_t>(i[0]) << 24 | static_cast<uint32_t>(i[1]) << 16
+      | static_cast<uint32_t>(i[2]) << 8 | i[3];
 }
 }  // namespace smpp
 
@@ -313,6 +300,6 @@ std::ostream &smpp::operator<<(std::ostream &out, smpp::PDU &pdu) {
     << " : " << smpp::GetEsmeStatus(pdu.command_status()) << endl;
 
   out << oc::tools::hexdump(reinterpret_cast<const unsigned char*>
-      (pdu.GetOctets().c_str()), static_cast<size_t>(size));
+      (pdu.Octets().data()), static_cast<size_t>(size));
   return out;
 }
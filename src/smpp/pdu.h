@@ -4,9 +4,13 @@
 
 #pragma once
 
+#include <algorithm>
 #include <array>
-#include <sstream>
+#include <cstdint>
+#include <ios>
+#include <memory_resource>
 #include <string>
+#include <string_view>
 
 #include "smpp/exceptions.h"
 #include "smpp/smpp.h"
@@ -20,24 +24,57 @@ typedef std::string PduData;
 typedef std::array<char, HEADERFIELD_SIZE> PduLengthHeader;
 
 // Class for representing a PDU.
+// The PDU is kept in one contiguous buffer of wire octets, with a read marker for decoding.
+// Integers are written and read in network byte order.
+// The buffer is allocated from the memory resource given at construction, the default resource if none is.
 class PDU {
  public:
   // Construct an empty PDU, ie. a null PDU
   PDU();
 
   // Construct a PDU from a command set, useful for sending PDUs
-  PDU(const CommandId  &cmd_id, const ESME &cmd_status, const uint32_t &seq_no);
+  PDU(const CommandId  &cmd_id, const ESME &cmd_status, const uint32_t &seq_no,
+      std::pmr::memory_resource *memory_resource = std::pmr::get_default_resource());
+
+  // Construct a PDU for sending a body of a known size, allocating room for exactly that once.
+  // @param body_length Octets which will follow the header.
+  PDU(const CommandId  &cmd_id, const ESME &cmd_status, const uint32_t &seq_no, const size_t body_length,
+      std::pmr::memory_resource *memory_resource = std::pmr::get_default_resource());
 
   // Construct a PDU from binary data, useful for receiving PDUs
-  PDU(const PduLengthHeader &pduLength, const PduData &pduBuffer);
+  PDU(const PduLengthHeader &pduLength, const PduData &pduBuffer,
+      std::pmr::memory_resource *memory_resource = std::pmr::get_default_resource());
+
+  // Construct a PDU from the octets of one complete PDU, as framed on the wire.
+  // @param octets First octet of the PDU, ie. its command length.
+  // @param len Octets in the PDU, which must match its command length.
+  PDU(const char *octets, const size_t len,
+      std::pmr::memory_resource *memory_resource = std::pmr::get_default_resource());
 
+  // Copies rhs, allocating from the memory resource of rhs.
   PDU(const PDU &rhs);
 
+  // Takes over the octets of rhs, keeping its read marker and memory resource.
+  PDU(PDU &&rhs) noexcept;
+
+  // Copies rhs into the memory resource of this PDU.
+  PDU &operator=(const PDU &rhs);
+
+  // Takes over the octets of rhs and its read marker. The octets are only copied if rhs
+  // allocates from another memory resource than this PDU.
+  PDU &operator=(PDU &&rhs);
+
   // Returns a copy of all data in this PDU as array of unsigned char array.
   const PduData GetOctets();
 
+  // Returns the wire octets of this PDU, without copying them.
+  // The view is valid until the PDU is modified or destroyed.
+  std::string_view Octets();
+
   // @return PDU size in octets.
-  int Size();
+  inline int Size() const {
+    return octets_.size();
+  }
 
   CommandId command_id() const {
     return command_id_;
@@ -64,10 +101,29 @@ class PDU {
   }
 
   // Adds an integer as an unsigned 8 bit.
-  PDU &operator<<(const int &);
-  PDU &operator<<(const uint8_t &i);
-  PDU &operator<<(const uint16_t &i);
-  PDU &operator<<(const uint32_t &i);
+  inline PDU &operator<<(const int &i) {
+    octets_.push_back(static_cast<char>(i));
+    return *this;
+  }
+
+  inline PDU &operator<<(const uint8_t &i) {
+    octets_.push_back(static_cast<char>(i));
+    return *this;
+  }
+
+  inline PDU &operator<<(const uint16_t &i) {
+    const char octets[] = { static_cast<char>(i >> 8), static_cast<char>(i) };
+    octets_.append(octets, sizeof(octets));
+    return *this;
+  }
+
+  inline PDU &operator<<(const uint32_t &i) {
+    const char octets[] = {
+      static_cast<char>(i >> 24), static_cast<char>(i >> 16), static_cast<char>(i >> 8), static_cast<char>(i) };
+    octets_.append(octets, sizeof(octets));
+    return *this;
+  }
+
   PDU &operator<<(const std::basic_string<char> &s);
 
   template <class Enum, class = typename std::enable_if<std::is_enum<Enum>::value >::type>
@@ -76,10 +132,16 @@ class PDU {
     return *this;
   }
 
-  PDU &operator<<(const smpp::SmppAddress);
-  PDU &operator<<(const smpp::TLV);
+  PDU &operator<<(const smpp::SmppAddress &);
+  PDU &operator<<(const smpp::TLV &);
   PDU &AddOctets(const PduData &octets, const std::streamsize &len);
 
+  // Adds octets as they are, without null termination.
+  inline PDU &AddOctets(std::string_view octets) {
+    octets_.append(octets.data(), octets.size());
+    return *this;
+  }
+
   // Skips n octets.
   void Skip(int n);
 
@@ -87,11 +149,34 @@ class PDU {
   void ResetMarker();
 
   PDU &operator>>(int &);
-  PDU &operator>>(uint8_t &i);
-  PDU &operator>>(uint16_t &i);
-  PDU &operator>>(uint32_t &i);
+
+  inline PDU &operator>>(uint8_t &i) {
+    CheckRead(sizeof(uint8_t));
+    i = Octet(read_pos_++);
+    return *this;
+  }
+
+  inline PDU &operator>>(uint16_t &i) {
+    CheckRead(sizeof(uint16_t));
+    i = static_cast<uint16_t>(Octet(read_pos_) << 8 | Octet(read_pos_ + 1));
+    read_pos_ += sizeof(uint16_t);
+    return *this;
+  }
+
+  inline PDU &operator>>(uint32_t &i) {
+    CheckRead(sizeof(uint32_t));
+    i = static_cast<uint32_t>(Octet(read_pos_)) << 24 | static_cast<uint32_t>(Octet(read_pos_ + 1)) << 16
+        | static_cast<uint32_t>(Octet(read_pos_ + 2)) << 8 | Octet(read_pos_ + 3);
+    read_pos_ += sizeof(uint32_t);
+    return *this;
+  }
+
   PDU &operator>>(std::basic_string<char> &s);
 
+  // Reads a C-octet string without copying it, like operator>>(std::string &).
+  // The view is valid until the PDU is modified or destroyed.
+  std::string_view ReadCString();
+
   template <class Enum, class = typename std::enable_if<std::is_enum<Enum>::value >::type>
   inline PDU &operator>>(Enum &e) {
     (*this) >> reinterpret_cast< typename std::underlying_type<Enum>::type &>(e);
@@ -103,17 +188,42 @@ class PDU {
   // @param n Octets to copy.
   void ReadOctets(PduData *octets, const std::streamsize &n);
 
-  bool HasMoreData();
+  // Reads up to n octets without copying them, fewer if the PDU ends first.
+  // The view is valid until the PDU is modified or destroyed.
+  inline std::string_view ReadView(const size_t n) {
+    std::string_view octets(octets_.data() + read_pos_, std::min(n, octets_.size() - read_pos_));
+    read_pos_ += octets.size();
+    return octets;
+  }
+
+  inline bool HasMoreData() const {
+    return read_pos_ < octets_.size();
+  }
 
   static uint32_t GetPduLength(const PduLengthHeader &pduHeader);
 
-  std::stringbuf sb_;
-  std::iostream buf_;
+  std::pmr::string octets_;
+  size_t read_pos_;  // Read marker
   CommandId command_id_;
   ESME command_status_;
   uint32_t seq_no_;
   bool null_terminate_octet_strings_;
   bool null_;
+
+ private:
+  // Writes the header, with command_length as given.
+  void WriteHeader(const uint32_t command_length);
+
+  inline uint8_t Octet(const size_t pos) const {
+    return static_cast<uint8_t>(octets_[pos]);
+  }
+
+  // @throw SmppException if there are less than n octets left to read.
+  inline void CheckRead(const size_t n) const {
+    if (octets_.size() - read_pos_ < n) {
+      throw smpp::SmppException("PDU reached EOF");
+    }
+  }
 };
 
 
@@ -0,0 +1,457 @@
+// Copyright (C) 2011-2014 OnlineCity
+// Licensed under the MIT license, which can be read at: http://www.opensource.org/licenses/mit-license.php
+// @author hd@onlinecity.dk & td@onlinecity.dk
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory_resource>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include "smpp/exceptions.h"
+#include "smpp/pdu.h"
+#include "smpp/smpp.h"
+#include "smpp/tlv.h"
+
+// Compile-time descriptions of PDU bodies.
+// A body is a plain struct, and its schema lists the members in wire order along with their format:
+//
+//   typedef Schema<
+//     Field<&QuerySmBody::message_id, CString<65>>,
+//     Field<&QuerySmBody::source_addr_ton, Integer<uint8_t>>,
+//     ...> QuerySmSchema;
+//
+// From that the schema sums the exact encoded size, validates the lengths against the limits of the
+// specification, and encodes into a PDU allocated once at that size, or decodes a PDU into the body.
+namespace smpp {
+namespace schema {
+// Octets written one part after the other, such as a UDH, a message and a null terminator.
+// It views the parts, which must outlive it.
+struct OctetParts {
+  std::string_view parts[3];
+
+  OctetParts(std::string_view a = std::string_view(), std::string_view b = std::string_view(),  // NOLINT
+             std::string_view c = std::string_view()) :
+    parts{ a, b, c } {
+  }
+
+  inline size_t size() const {
+    return parts[0].size() + parts[1].size() + parts[2].size();
+  }
+};
+
+inline size_t Size(std::string_view octets) {
+  return octets.size();
+}
+
+inline size_t Size(const OctetParts &octets) {
+  return octets.size();
+}
+
+inline void Put(std::string_view octets, PDU *pdu) {
+  pdu->AddOctets(octets);
+}
+
+inline void Put(const OctetParts &octets, PDU *pdu) {
+  for (std::string_view part : octets.parts) {
+    pdu->AddOctets(part);
+  }
+}
+
+inline void Assign(std::string_view octets, std::string *value) {
+  value->assign(octets.data(), octets.size());
+}
+
+inline void Assign(std::string_view octets, std::string_view *value) {
+  *value = octets;
+}
+
+// Integer of one, two or four octets, from a member of any integer or enum type.
+template <class Wire>
+struct Integer {
+  static_assert(std::is_unsigned<Wire>::value && sizeof(Wire) <= sizeof(uint32_t), "Wire must be uint8_t to uint32_t");
+
+  template <class T>
+  static constexpr size_t Size(const T &) {
+    return sizeof(Wire);
+  }
+
+  template <class T>
+  static constexpr bool Valid(const T &) {
+    return true;
+  }
+
+  template <class T>
+  static void Put(const T &value, PDU *pdu) {
+    *pdu << static_cast<Wire>(value);
+  }
+
+  template <class T>
+  static void Get(PDU *pdu, T *value) {
+    Wire wire;
+    *pdu >> wire;
+    *value = static_cast<T>(wire);
+  }
+};
+
+// C-octet string, written with its null terminator.
+// @tparam MAX Maximum size in octets, including the null terminator, unlimited if not given.
+template <size_t MAX = SIZE_MAX>
+struct CString {
+  template <class T>
+  static size_t Size(const T &value) {
+    return schema::Size(value) + 1;
+  }
+
+  template <class T>
+  static bool Valid(const T &value) {
+    return Size(value) <= MAX;
+  }
+
+  template <class T>
+  static void Put(const T &value, PDU *pdu) {
+    schema::Put(value, pdu);
+    *pdu << 0;
+  }
+
+  template <class T>
+  static void Get(PDU *pdu, T *value) {
+    Assign(pdu->ReadCString(), value);
+  }
+};
+
+// Octet string preceded by its length, as the sm_length and short_message fields.
+// A string cut short by the end of the PDU is padded with zeros when decoded into a std::string.
+// @tparam Length Integer type of the length.
+// @tparam MAX Maximum size in octets.
+template <class Length, size_t MAX>
+struct Octets {
+  template <class T>
+  static size_t Size(const T &value) {
+    return sizeof(Length) + schema::Size(value);
+  }
+
+  template <class T>
+  static bool Valid(const T &value) {
+    return schema::Size(value) <= MAX;
+  }
+
+  template <class T>
+  static void Put(const T &value, PDU *pdu) {
+    *pdu << static_cast<Length>(schema::Size(value));
+    schema::Put(value, pdu);
+  }
+
+  static void Get(PDU *pdu, std::string *value) {
+    Length len;
+    *pdu >> len;
+    Assign(pdu->ReadView(len), value);
+    value->resize(len);
+  }
+};
+
+// Optional parameter with a fixed tag, written only if the member holds a value.
+// The member is a std::optional of an unsigned integer or of octets. Optional parameters are decoded by Tlvs.
+template <Tag TAG>
+struct Tlv {
+  template <class T>
+  static size_t Size(const std::optional<T> &value) {
+    return value ? sizeof(uint16_t) * 2 + ValueSize(*value) : 0;
+  }
+
+  template <class T>
+  static bool Valid(const std::optional<T> &value) {
+    return !value || ValueSize(*value) <= UINT16_MAX;
+  }
+
+  template <class T>
+  static void Put(const std::optional<T> &value, PDU *pdu) {
+    if (!value) {
+      return;
+    }
+    *pdu << TAG;
+    *pdu << static_cast<uint16_t>(ValueSize(*value));
+    if constexpr (std::is_integral<T>::value) {
+      *pdu << *value;
+    } else {
+      schema::Put(*value, pdu);
+    }
+  }
+
+  template <class T>
+  static void Get(PDU *, T *) {
+  }
+
+ private:
+  template <class T>
+  static size_t ValueSize(const T &value) {
+    if constexpr (std::is_integral<T>::value) {
+      static_assert(std::is_unsigned<T>::value && sizeof(T) <= sizeof(uint32_t), "Use uint8_t to uint32_t");
+      return sizeof(T);
+    } else {
+      return schema::Size(value);
+    }
+  }
+};
+
+// The optional parameters which end a PDU.
+// Encodes a TlvList, or one pointed to, and decodes every parameter up to the end of the PDU or a null tag.
+struct Tlvs {
+  static size_t Size(const TlvList &tlvs) {
+    size_t size = 0;
+    for (const TLV &tlv : tlvs) {
+      size += sizeof(uint16_t) * 2 + tlv.len();
+    }
+    return size;
+  }
+
+  static size_t Size(const TlvList *tlvs) {
+    return tlvs == nullptr ? 0 : Size(*tlvs);
+  }
+
+  template <class T>
+  static constexpr bool Valid(const T &) {
+    return true;  // A TLV can't hold more than 65535 octets.
+  }
+
+  static void Put(const TlvList &tlvs, PDU *pdu) {
+    for (const TLV &tlv : tlvs) {
+      *pdu << tlv;
+    }
+  }
+
+  static void Put(const TlvList *tlvs, PDU *pdu) {
+    if (tlvs != nullptr) {
+      Put(*tlvs, pdu);
+    }
+  }
+
+  static void Get(PDU *pdu, TlvList *tlvs) {
+    Tag tag(Tag::NA);
+    uint16_t len = 0;
+    while (pdu->HasMoreData()) {
+      *pdu >> tag;
+      *pdu >> len;
+      if (tag == Tag::NA) {
+        break;
+      }
+      std::string_view octets = pdu->ReadView(len);
+      tlvs->emplace_back(tag, octets.data(), octets.size());
+    }
+  }
+};
+
+// Elements of an array field, viewed in the caller's storage.
+template <class T>
+struct ArrayView {
+  const T *data = nullptr;
+  size_t size = 0;
+
+  inline const T *begin() const {
+    return data;
+  }
+
+  inline const T *end() const {
+    return data + size;
+  }
+};
+
+// The dest_address list of a submit_multi, preceded by number_of_dests.
+// Encodes an ArrayView or std::vector of DestAddress, and decodes into a std::vector.
+struct DestAddresses {
+  static constexpr size_t MAX_DESTS = 255;
+  static constexpr size_t MAX_ADDRESS = 21;  // Both for SME addresses and distribution list names.
+
+  template <class T>
+  static size_t Size(const T &dests) {
+    size_t size = sizeof(uint8_t);
+    for (const DestAddress &dest : dests) {
+      size += sizeof(uint8_t) + (dest.dest_flag == DestFlag::DEST_FLAG_SME ? 2 : 0) + dest.address.value.size() + 1;
+    }
+    return size;
+  }
+
+  template <class T>
+  static bool Valid(const T &dests) {
+    size_t count = 0;
+    for (const DestAddress &dest : dests) {
+      if (dest.address.value.size() + 1 > MAX_ADDRESS) {
+        return false;
+      }
+      ++count;
+    }
+    return count > 0 && count <= MAX_DESTS;
+  }
+
+  template <class T>
+  static void Put(const T &dests, PDU *pdu) {
+    *pdu << static_cast<uint8_t>(Count(dests));
+    for (const DestAddress &dest : dests) {
+      *pdu << dest.dest_flag;
+      if (dest.dest_flag == DestFlag::DEST_FLAG_SME) {
+        *pdu << dest.address;
+      } else {
+        *pdu << dest.address.value;
+      }
+    }
+  }
+
+  // @throw SmppException if a destination has an unknown dest_flag.
+  static void Get(PDU *pdu, std::vector<DestAddress> *dests) {
+    uint8_t count;
+    *pdu >> count;
+    for (uint8_t i = 0; i < count; ++i) {
+      DestFlag dest_flag;
+      *pdu >> dest_flag;
+      if (dest_flag == DestFlag::DEST_FLAG_SME) {
+        SmppAddress address("");
+        *pdu >> address.ton;
+        *pdu >> address.npi;
+        Assign(pdu->ReadCString(), &address.value);
+        dests->emplace_back(address);
+      } else if (dest_flag == DestFlag::DEST_FLAG_DISTLIST) {
+        dests->emplace_back(std::string(pdu->ReadCString()));
+      } else {
+        throw SmppException("Invalid dest_flag in submit_multi");
+      }
+    }
+  }
+
+ private:
+  template <class T>
+  static size_t Count(const T &dests) {
+    return std::distance(dests.begin(), dests.end());
+  }
+};
+
+// The unsuccess_sme list of a submit_multi_resp, preceded by no_unsuccess.
+struct UnsuccessSmes {
+  static constexpr size_t MAX_SMES = 255;
+  static constexpr size_t MAX_ADDRESS = 21;
+
+  static size_t Size(const std::vector<UnsuccessSme> &smes) {
+    size_t size = sizeof(uint8_t);
+    for (const UnsuccessSme &sme : smes) {
+      size += 2 + sme.address.value.size() + 1 + sizeof(uint32_t);
+    }
+    return size;
+  }
+
+  static bool Valid(const std::vector<UnsuccessSme> &smes) {
+    for (const UnsuccessSme &sme : smes) {
+      if (sme.address.value.size() + 1 > MAX_ADDRESS) {
+        return false;
+      }
+    }
+    return smes.size() <= MAX_SMES;
+  }
+
+  static void Put(const std::vector<UnsuccessSme> &smes, PDU *pdu) {
+    *pdu << static_cast<uint8_t>(smes.size());
+    for (const UnsuccessSme &sme : smes) {
+      *pdu << sme.address;
+      *pdu << sme.error_status_code;
+    }
+  }
+
+  static void Get(PDU *pdu, std::vector<UnsuccessSme> *smes) {
+    uint8_t count;
+    *pdu >> count;
+    smes->reserve(smes->size() + count);
+    for (uint8_t i = 0; i < count; ++i) {
+      UnsuccessSme sme { SmppAddress(""), ESME::ROK };
+      *pdu >> sme.address.ton;
+      *pdu >> sme.address.npi;
+      Assign(pdu->ReadCString(), &sme.address.value);
+      *pdu >> sme.error_status_code;
+      smes->push_back(std::move(sme));
+    }
+  }
+};
+
+template <class MemberPointer>
+struct MemberOf;
+
+template <class C, class M>
+struct MemberOf<M C::*> {
+  typedef C Class;
+  typedef M Type;
+};
+
+// One field of a body, a member and its format.
+template <auto MEMBER, class Format>
+struct Field {
+  typedef typename MemberOf<decltype(MEMBER)>::Class Body;
+
+  static size_t Size(const Body &body) {
+    return Format::Size(body.*MEMBER);
+  }
+
+  static bool Valid(const Body &body) {
+    return Format::Valid(body.*MEMBER);
+  }
+
+  static void Put(const Body &body, PDU *pdu) {
+    Format::Put(body.*MEMBER, pdu);
+  }
+
+  static void Get(PDU *pdu, Body *body) {
+    Format::Get(pdu, &(body->*MEMBER));
+  }
+};
+
+// The fields of a body in wire order.
+template <class... Fields>
+class Schema {
+ public:
+  typedef typename std::tuple_element<0, std::tuple<Fields...>>::type::Body Body;
+  static_assert((std::is_same<typename Fields::Body, Body>::value && ...), "Fields must be members of one body");
+
+  // @return Octets of the body, not counting the header.
+  static size_t EncodedSize(const Body &body) {
+    return (Fields::Size(body) + ...);
+  }
+
+  // @throw FieldLengthException if a field is longer than the specification allows.
+  static void Validate(const Body &body) {
+    size_t field = 0;
+    if (!((++field, Fields::Valid(body)) && ...)) {
+      throw FieldLengthException("Field " + std::to_string(field) + " of the PDU is longer than SMPP allows");
+    }
+  }
+
+  // Encodes a PDU, allocating its octets once.
+  // @throw FieldLengthException if a field is longer than the specification allows.
+  static PDU Encode(const CommandId &cmd_id, const uint32_t seq_no, const Body &body,
+                    std::pmr::memory_resource *memory_resource = std::pmr::get_default_resource()) {
+    return Encode(cmd_id, [seq_no] { return seq_no; }, body, memory_resource);
+  }
+
+  // Encodes a PDU, taking its sequence number from next_seq_no only once the body is valid,
+  // so a rejected body does not use up a sequence number.
+  // @throw FieldLengthException if a field is longer than the specification allows.
+  template <class NextSeqNo, typename = std::enable_if_t<std::is_invocable_r_v<uint32_t, NextSeqNo &>>>
+  static PDU Encode(const CommandId &cmd_id, NextSeqNo &&next_seq_no, const Body &body,
+                    std::pmr::memory_resource *memory_resource = std::pmr::get_default_resource()) {
+    Validate(body);
+    PDU pdu(cmd_id, ESME::ROK, next_seq_no(), EncodedSize(body), memory_resource);
+    (Fields::Put(body, &pdu), ...);
+    return pdu;
+  }
+
+  // Decodes the body from the read marker of a PDU.
+  // Views in the body are valid until the PDU is modified or destroyed.
+  // @throw SmppException if the PDU ends inside an integer.
+  static void Decode(PDU *pdu, Body *body) {
+    (Fields::Get(pdu, body), ...);
+  }
+};
+}  // namespace schema
+}  // namespace smpp
@@ -0,0 +1,80 @@
+// Copyright (C) 2011-2014 OnlineCity
+// Licensed under the MIT license, which can be read at: http://www.opensource.org/licenses/mit-license.php
+// @author hd@onlinecity.dk & td@onlinecity.dk
+
+#include "smpp/segmentation.h"
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "smpp/exceptions.h"
+
+namespace smpp {
+namespace {
+inline bool IsOctetCoding(const DataCoding &data_coding) {
+  return data_coding == DataCoding::UCS2 || data_coding == DataCoding::BINARY
+      || data_coding == DataCoding::BINARY_ALIAS;
+}
+
+// Returns the smallest segment which keeps every character of the encoding whole.
+inline size_t MinSegmentSize(const DataCoding &data_coding) {
+  if (data_coding == DataCoding::UCS2) {
+    return 4;  // A surrogate pair.
+  }
+  return IsOctetCoding(data_coding) ? 1 : 2;  // An escape sequence.
+}
+
+// Returns the length of a segment starting at offset, shortened so it doesn't end inside a character.
+size_t SegmentLength(std::string_view short_message, const DataCoding &data_coding, const size_t segment_size,
+                     const size_t offset) {
+  size_t length = std::min(segment_size, short_message.size() - offset);
+  if (offset + length == short_message.size()) {
+    return length;
+  }
+
+  if (data_coding == DataCoding::UCS2) {
+    length &= ~static_cast<size_t>(1);
+    if (length > 2) {
+      uint8_t high = static_cast<uint8_t>(short_message[offset + length - 2]);
+      if (high >= 0xD8 && high <= 0xDB) {  // Leading surrogate, keep it with its pair
+        length -= 2;
+      }
+    }
+  } else if (data_coding == DataCoding::DEFAULT) {
+    // An escape starts a sequence unless it follows one, so an odd run of them ends in a dangling one.
+    size_t escapes = 0;
+    while (escapes < length && short_message[offset + length - 1 - escapes] == 0x1B) {
+      ++escapes;
+    }
+    if (escapes % 2 == 1 && length > 1) {
+      --length;
+    }
+  }
+  return length;
+}
+}  // namespace
+
+size_t SegmentSize(const DataCoding &data_coding, const size_t udh_octets) {
+  if (IsOctetCoding(data_coding)) {
+    size_t size = 140 - udh_octets;
+    return data_coding == DataCoding::UCS2 ? size & ~static_cast<size_t>(1) : size;
+  }
+  // The UDH is padded to a whole number of septets.
+  return 160 - (udh_octets * 8 + 6) / 7;
+}
+
+std::vector<Segment> SplitSegments(std::string_view short_message, const DataCoding &data_coding,
+                                   const size_t segment_size) {
+  if (segment_size < MinSegmentSize(data_coding)) {
+    throw SmppException("Segment size " + std::to_string(segment_size) + " is too small for the data coding");
+  }
+  std::vector<Segment> segments;
+  segments.reserve((short_message.size() + segment_size - 1) / segment_size + 1);
+  for (size_t offset = 0; offset < short_message.size();) {
+    size_t length = SegmentLength(short_message, data_coding, segment_size, offset);
+    segments.push_back(Segment { offset, length });
+    offset += length;
+  }
+  return segments;
+}
+}  // namespace smpp
@@ -0,0 +1,44 @@
+// Copyright (C) 2011-2014 OnlineCity
+// Licensed under the MIT license, which can be read at: http://www.opensource.org/licenses/mit-license.php
+// @author hd@onlinecity.dk & td@onlinecity.dk
+
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+#include "smpp/smpp.h"
+
+namespace smpp {
+// Octets ahead of each segment of a concatenated SMS: a UDH with an 8 bit or a 16 bit concatenation reference.
+// The SMSC puts a 16 bit one ahead of the segments sent with SAR TLVs.
+const size_t UDH_8BIT_REF_OCTETS = 6;
+const size_t UDH_16BIT_REF_OCTETS = 7;
+
+// Part of an encoded short message, as an offset and a length into it.
+struct Segment {
+  size_t offset;
+  size_t length;
+
+  inline std::string_view of(std::string_view short_message) const {
+    return short_message.substr(offset, length);
+  }
+};
+
+// Returns the octets of an encoded short message an SMS can hold, besides a UDH of the given size.
+// GSM 03.38 messages hold 160 septets, and are sent one septet per octet, UCS-2 and binary ones hold 140 octets.
+// @param data_coding Encoding of the message.
+// @param udh_octets Size of the UDH, 0 for an SMS on its own.
+size_t SegmentSize(const DataCoding &data_coding, const size_t udh_octets);
+
+// Splits an encoded short message into segments of at most segment_size octets, without copying it.
+// GSM 03.38 escape sequences are kept whole, as are UCS-2 characters and surrogate pairs.
+// @param short_message Encoded message.
+// @param data_coding Encoding of the message.
+// @param segment_size Octets a segment may hold, see SegmentSize.
+// @return The segments, in order.
+// @throw SmppException if segment_size can't hold a whole character: 2 octets for GSM 03.38, 4 for UCS-2.
+std::vector<Segment> SplitSegments(std::string_view short_message, const DataCoding &data_coding,
+                                   const size_t segment_size);
+}  // namespace smpp
@@ -0,0 +1,244 @@
+// Copyright (C) 2011-2014 OnlineCity
+// Licensed under the MIT license, which can be read at: http://www.opensource.org/licenses/mit-license.php
+// @author hd@onlinecity.dk & td@onlinecity.dk
+
+#include "smpp/session_pool.h"
+#include <string>
+#include <utility>
+
+namespace smpp {
+using std::string;
+using std::pair;
+using boost::system::error_code;
+using asio::ip::tcp;
+
+SessionPool::SessionPool(asio::io_context &ctx, const tcp::endpoint &endpoint, const size_t size,
+                         std::pmr::memory_resource *memory_resource) :
+  ctx_(ctx),
+  endpoint_(endpoint),
+  memory_resource_(memory_resource),
+  session_setup_(),
+  sessions_(),
+  next_(0),
+  throttle_pause_(std::chrono::milliseconds(1000)) {
+  for (size_t i = 0; i < size; ++i) {
+    std::unique_ptr<Session> session(new Session());
+    NewClient(session.get());
+    sessions_.push_back(std::move(session));
+  }
+}
+
+SessionPool::~SessionPool() {
+  try {
+    Unbind();
+  } catch (std::exception &e) {
+  }
+}
+
+size_t SessionPool::Bind(const string &login, const string &password) {
+  bool done = false;
+  error_code error;
+  StartBind(login, password, [&done, &error](error_code ec) {
+    done = true;
+    error = ec;
+  });
+  RunUntil([&done] { return done; });
+
+  if (error) {
+    throw TransportException("No session could be bound: " + error.message());
+  }
+  return available();
+}
+
+void SessionPool::set_session_setup(SessionSetup setup) {
+  session_setup_ = std::move(setup);
+  if (session_setup_) {
+    for (auto &session : sessions_) {
+      session_setup_(*session->client);
+    }
+  }
+}
+
+void SessionPool::NewClient(Session *session) {
+  session->socket = std::make_shared<tcp::socket>(ctx_);
+  session->client.reset(new SmppClient(session->socket, ctx_, memory_resource_));
+  session->failed = false;
+  if (session_setup_) {
+    session_setup_(*session->client);
+  }
+}
+
+void SessionPool::StartBind(const string &login, const string &password, CompletionCallback callback) {
+  struct BindState {
+    size_t remaining;
+    size_t bound;
+    error_code error;
+  };
+  auto state = std::make_shared<BindState>();
+  state->remaining = 0;
+  state->bound = 0;
+
+  // Called once for every session, when it is bound or failed to bind.
+  auto done = [state, callback](const error_code &ec) {
+    if (ec) {
+      state->error = ec;
+    } else {
+      ++state->bound;
+    }
+    if (--state->remaining == 0) {
+      callback(state->bound > 0 ? error_code() : state->error);
+    }
+  };
+
+  std::vector<Session*> unbound;
+  for (auto &session : sessions_) {
+    if (session->failed || !session->client->IsBound()) {
+      unbound.push_back(session.get());
+    }
+  }
+
+  if (unbound.empty()) {
+    return callback(error_code());
+  }
+
+  state->remaining = unbound.size();
+  for (Session *session : unbound) {
+    if (session->failed || session->socket->is_open()) {
+      // Start over with a fresh connection.
+      error_code ignored;
+      session->client.reset();
+      session->socket->close(ignored);
+      NewClient(session);
+    }
+    session->resume = std::chrono::steady_clock::time_point();
+
+    session->socket->async_connect(endpoint_, [this, session, login, password, done](const error_code &ec) {
+      if (ec) {
+        session->failed = true;
+        return done(ec);
+      }
+      session->client->BindTransmitterAsync(login, password, [this, session, done](error_code ec) {
+        HandleResult(session, ec);
+        done(ec);
+      });
+    });
+  }
+}
+
+void SessionPool::Unbind() {
+  size_t remaining = 0;
+  for (auto &session : sessions_) {
+    if (session->failed || !session->client->IsBound()) {
+      continue;
+    }
+    ++remaining;
+    session->client->UnbindAsync([&remaining](error_code) {
+      --remaining;
+    });
+  }
+  RunUntil([&remaining] { return remaining == 0; });
+
+  for (auto &session : sessions_) {
+    error_code ignored;
+    session->socket->close(ignored);
+  }
+}
+
+pair<string, int> SessionPool::SendSms(
+    const SmppAddress &sender,
+    const SmppAddress &receiver,
+    const string &short_message,
+    const SmppParams &params,
+    const TlvList &tags) {
+  bool done = false;
+  error_code error;
+  pair<string, int> result;
+  StartSendSms(sender, receiver, short_message, params, tags,
+               [&done, &error, &result](error_code ec, pair<string, int> r) {
+    done = true;
+    error = ec;
+    result = r;
+  });
+  RunUntil([&done] { return done; });
+
+  if (error.category() == esme_category()) {
+    throw SmppException(GetEsmeStatus(static_cast<ESME>(error.value())));
+  } else if (error) {
+    throw TransportException(error.message());
+  }
+  return result;
+}
+
+void SessionPool::StartSendSms(
+    const SmppAddress &sender,
+    const SmppAddress &receiver,
+    const string &short_message,
+    const SmppParams &params,
+    TlvList tags,
+    SendSmsCallback callback) {
+  Session *session = LeastLoaded();
+  if (!session) {
+    return asio::post(ctx_, [callback] {
+      callback(asio::error::not_connected, pair<string, int>());
+    });
+  }
+
+  session->client->SendSmsAsync(sender, receiver, short_message, params, std::move(tags),
+                                [this, session, callback](error_code ec, pair<string, int> result) {
+    HandleResult(session, ec);
+    callback(ec, result);
+  });
+}
+
+size_t SessionPool::available() const {
+  auto now = std::chrono::steady_clock::now();
+  size_t n = 0;
+  for (auto &session : sessions_) {
+    if (InRotation(*session, now)) {
+      ++n;
+    }
+  }
+  return n;
+}
+
+bool SessionPool::InRotation(const Session &session, const std::chrono::steady_clock::time_point &now) const {
+  return !session.failed && session.client->CanTransmit() && session.resume <= now;
+}
+
+SessionPool::Session *SessionPool::LeastLoaded() {
+  auto now = std::chrono::steady_clock::now();
+  Session *least = nullptr;
+  size_t least_index = 0;
+
+  for (size_t n = 0; n < sessions_.size(); ++n) {
+    size_t i = (next_ + n) % sessions_.size();
+    Session *session = sessions_[i].get();
+    if (InRotation(*session, now) && (!least || session->client->pending() < least->client->pending())) {
+      least = session;
+      least_index = i;
+    }
+  }
+
+  if (least) {
+    next_ = least_index + 1;
+  }
+  return least;
+}
+
+void SessionPool::HandleResult(Session *session, const error_code &error) {
+  if (error == ESME::RTHROTTLED || error == ESME::RMSGQFUL) {
+    LOG(WARNING) << "Session throttled by SMSC, out of rotation for " << throttle_pause_.count() << " ms";
+    session->resume = std::chrono::steady_clock::now() + throttle_pause_;
+  } else if (error && error.category() != esme_category()) {
+    LOG(WARNING) << "Session failed, out of rotation: " << error.message();
+    session->failed = true;
+  }
+}
+
+void SessionPool::RunUntil(const std::function<bool()> &done) {
+  while (!done()) {
+    ctx_.run_one();
+    ctx_.restart();
+  }
+}
+}  // namespace smpp
@@ -0,0 +1,178 @@
+// Copyright (C) 2011-2014 OnlineCity
+// Licensed under the MIT license, which can be read at: http://www.opensource.org/licenses/mit-license.php
+// @author hd@onlinecity.dk & td@onlinecity.dk
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <memory_resource>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <boost/asio.hpp>
+namespace asio = boost::asio;
+
+#include "smpp/smpp_params.h"
+#include "smpp/smppclient.h"
+#include "smpp/tlv.h"
+
+namespace smpp {
+// Pool of transmitter sessions bound with the same credentials.
+// Sends are spread across the sessions in rotation, to the one with the fewest requests pending.
+// A session is taken out of rotation when its connection fails, and for a while after the SMSC
+// answers it with ESME_RTHROTTLED or ESME_RMSGQFUL.
+// All sessions run on the io_context of the pool, which must only be used from the thread running it.
+// A session is reconnected with a new SmppClient, so client settings belong in set_session_setup.
+class SessionPool {
+ public:
+  typedef std::function<void(boost::system::error_code)> CompletionCallback;
+  typedef std::function<void(boost::system::error_code, std::pair<std::string, int>)> SendSmsCallback;
+  typedef std::function<void(SmppClient &)> SessionSetup;
+
+  // @param ctx io_context for the connections.
+  // @param endpoint Address of the SMSC.
+  // @param size Number of sessions.
+  // @param memory_resource Resource for the clients of the sessions, see SmppClient. It must outlive the pool.
+  SessionPool(asio::io_context &ctx, const asio::ip::tcp::endpoint &endpoint, const size_t size,
+              std::pmr::memory_resource *memory_resource = std::pmr::get_default_resource());
+  ~SessionPool();
+
+  SessionPool(const SessionPool &) = delete;
+  SessionPool &operator=(const SessionPool &) = delete;
+
+  // Connects and binds every session not bound already, in parallel, and blocks until they are done.
+  // Sessions which failed earlier are reconnected with a new client, see session().
+  // @return Number of bound sessions.
+  // @throw TransportException if no session could be bound.
+  size_t Bind(const std::string &login, const std::string &password);
+
+  // Asynchronously connects and binds every session not bound already.
+  // Completion signature: void(boost::system::error_code), with an error if no session could be bound.
+  template <typename CompletionToken>
+  auto BindAsync(const std::string &login, const std::string &password, CompletionToken &&token) {
+    return asio::async_initiate<CompletionToken, void(boost::system::error_code)>(
+        [this](auto handler, const std::string &login, const std::string &password) {
+          StartBind(login, password, Wrap<boost::system::error_code>(std::move(handler)));
+        }, token, login, password);
+  }
+
+  // Unbinds every bound session and blocks until they are done.
+  void Unbind();
+
+  // Sends an SMS through the least loaded session in rotation and blocks until it is answered.
+  // @return smsc id and number of smses sent.
+  // @throw SmppException if the SMSC rejected the SMS, TransportException if no session could send it.
+  std::pair<std::string, int> SendSms(const SmppAddress &sender, const SmppAddress &receiver,
+                                      const std::string &short_message,
+                                      const SmppParams &params = SmppParams(),
+                                      const TlvList &tags = TlvList());
+
+  // Asynchronously sends an SMS through the least loaded session in rotation.
+  // Completion signature: void(boost::system::error_code, std::pair<std::string, int>), as for
+  // SmppClient::SendSmsAsync. The error is asio::error::not_connected if no session is in rotation.
+  template <typename CompletionToken>
+  auto SendSmsAsync(const SmppAddress &sender, const SmppAddress &receiver,
+                    const std::string &short_message,
+                    const SmppParams &params,
+                    TlvList tags,
+                    CompletionToken &&token) {
+    return asio::async_initiate<CompletionToken, void(boost::system::error_code, std::pair<std::string, int>)>(
+        [this](auto handler, const SmppAddress &sender, const SmppAddress &receiver,
+               const std::string &short_message, const SmppParams &params, TlvList tags) {
+          StartSendSms(sender, receiver, short_message, params, std::move(tags),
+                       Wrap<boost::system::error_code, std::pair<std::string, int>>(std::move(handler)));
+        }, token, sender, receiver, short_message, params, std::move(tags));
+  }
+
+  // Asynchronously sends an SMS with default parameters and no optional tags.
+  template <typename CompletionToken>
+  auto SendSmsAsync(const SmppAddress &sender, const SmppAddress &receiver,
+                    const std::string &short_message,
+                    CompletionToken &&token) {
+    return SendSmsAsync(sender, receiver, short_message, SmppParams(), TlvList(),
+                        std::forward<CompletionToken>(token));
+  }
+
+  // Returns the number of sessions.
+  inline size_t size() const {
+    return sessions_.size();
+  }
+
+  // Returns the number of sessions in rotation.
+  size_t available() const;
+
+  // Returns the client of session i.
+  // The reference is invalidated by Bind and BindAsync, which replace the client of a session they reconnect.
+  // Settings made through it are lost with it, unlike those made by the session setup.
+  inline SmppClient &session(const size_t i) {
+    return *sessions_[i]->client;
+  }
+
+  // Sets a function applied to the client of every session, now and whenever a session is reconnected,
+  // eg. to set its window size, throttle or CSMS method.
+  void set_session_setup(SessionSetup setup);
+
+  // Sets for how long a session is out of rotation after being throttled by the SMSC.
+  inline void set_throttle_pause(const std::chrono::milliseconds &throttle_pause) {
+    throttle_pause_ = throttle_pause;
+  }
+
+  inline std::chrono::milliseconds throttle_pause() const {
+    return throttle_pause_;
+  }
+
+ private:
+  struct Session {
+    std::shared_ptr<asio::ip::tcp::socket> socket;
+    std::unique_ptr<SmppClient> client;
+    bool failed;  // Connection failed, until bound again.
+    std::chrono::steady_clock::time_point resume;  // Out of rotation until then.
+  };
+
+  // Wraps an asio completion handler into a copyable callback, invoked through its associated executor.
+  template <typename... Args, typename Handler>
+  std::function<void(Args...)> Wrap(Handler &&handler) {
+    auto h = std::make_shared<typename std::decay<Handler>::type>(std::forward<Handler>(handler));
+    auto ex = asio::get_associated_executor(*h, ctx_.get_executor());
+    return [h, ex](Args... args) {
+      auto a = std::make_tuple(std::move(args)...);
+      asio::post(ex, [h, a]() mutable {
+        std::apply(std::move(*h), std::move(a));
+      });
+    };
+  }
+
+  // Gives the session a new socket and client, set up by the session setup.
+  void NewClient(Session *session);
+
+  void StartBind(const std::string &login, const std::string &password, CompletionCallback callback);
+  void StartSendSms(const SmppAddress &sender, const SmppAddress &receiver, const std::string &short_message,
+                    const SmppParams &params, TlvList tags, SendSmsCallback callback);
+
+  // Returns true if the session may be sent to.
+  bool InRotation(const Session &session, const std::chrono::steady_clock::time_point &now) const;
+
+  // Returns the session in rotation with the fewest pending requests, or null if there is none.
+  Session *LeastLoaded();
+
+  // Takes a session out of rotation if the error calls for it.
+  void HandleResult(Session *session, const boost::system::error_code &error);
+
+  // Runs the io_context until done returns true.
+  void RunUntil(const std::function<bool()> &done);
+
+  asio::io_context &ctx_;
+  asio::ip::tcp::endpoint endpoint_;
+  std::pmr::memory_resource *memory_resource_;
+  SessionSetup session_setup_;
+  std::vector<std::unique_ptr<Session>> sessions_;
+  size_t next_;  // Session to try first, so sends go round when sessions are equally loaded.
+  std::chrono::milliseconds throttle_pause_;
+};
+}  // namespace smpp
@@ -8,6 +8,25 @@
 
 namespace smpp {
 using std::string;
+
+namespace {
+class EsmeCategory : public boost::system::error_category {
+ public:
+  const char *name() const noexcept override {
+    return "smpp.esme";
+  }
+
+  string message(int ev) const override {
+    return GetEsmeStatus(static_cast<ESME>(ev));
+  }
+};
+}  // namespace
+
+const boost::system::error_category &esme_category() {
+  static const EsmeCategory category;
+  return category;
+}
+
 string GetEsmeStatus(const ESME &i) {
   switch (i) {
   case ESME::ROK:
@@ -6,6 +6,9 @@
 
 #include <cstdint>
 #include <string>
+#include <type_traits>
+
+#include <boost/system/error_code.hpp>
 
 namespace smpp {
 // SMPP Command ID values (table 5-1, 5.1.2.1)
@@ -231,6 +234,14 @@ enum class State : uint8_t {
 
 std::string GetEsmeStatus(const ESME &);
 
+// Error category for ESME command statuses.
+// Used when a status is reported as an error_code by the asynchronous SmppClient operations.
+const boost::system::error_category &esme_category();
+
+inline boost::system::error_code make_error_code(const ESME &e) {
+  return boost::system::error_code(static_cast<int>(e), esme_category());
+}
+
 template<class Enum, class = typename std::enable_if<std::is_enum<Enum>::value>::type>
 std::ostream &operator<<(std::ostream &out, Enum &e) {
   out << static_cast<typename std::underlying_type<Enum>::type >(e);
@@ -256,4 +267,35 @@ struct SmppAddress {
     npi(numbering_plan_indicator) {
   }
 };
+
+// Destination of a submit_multi, an SME address or the name of a distribution list defined on the SMSC.
+struct DestAddress {
+  DestFlag dest_flag;
+  SmppAddress address;  // Only the value is used for a distribution list.
+
+  explicit DestAddress(const SmppAddress &sme_address) :
+    dest_flag(DestFlag::DEST_FLAG_SME),
+    address(sme_address) {
+  }
+
+  // @param dl_name Name of the distribution list.
+  explicit DestAddress(const std::string &dl_name) :
+    dest_flag(DestFlag::DEST_FLAG_DISTLIST),
+    address(dl_name) {
+  }
+};
+
+// SME address a submit_multi could not be submitted to, as reported in its response.
+struct UnsuccessSme {
+  SmppAddress address;
+  ESME error_status_code;
+};
 }  // namespace smpp
+
+namespace boost {
+namespace system {
+template<>
+struct is_error_code_enum<smpp::ESME> : public std::true_type {
+};
+}  // namespace system
+}  // namespace boost
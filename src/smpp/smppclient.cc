@@ -4,9 +4,8 @@
 
 #include "smpp/smppclient.h"
 #include <algorithm>
-#include <cassert>
+#include <cmath>
 #include <functional>
-#include <list>
 #include <string>
 #include <utility>
 #include <vector>
@@ -23,7 +22,6 @@ DEFINE_int32(interface_version, 0x34, "SMPP protocol version.");
 namespace smpp {
 using std::string;
 using std::vector;
-using std::list;
 using std::pair;
 using std::placeholders::_1;
 using std::placeholders::_2;
@@ -34,15 +32,63 @@ using asio::ip::tcp;
 using asio::async_write;
 using asio::buffer;
 
-SmppClient::SmppClient(shared_ptr<tcp::socket> socket, asio::io_context& ctx) :
+namespace {
+// Size of the read buffer. It grows for a larger PDU while that is read.
+const uint32_t READ_BUFFER_SIZE = 64 * 1024;
+
+// Largest PDU accepted from the SMSC. SMPP sets no limit, but a PDU may carry a 64 KB MESSAGE_PAYLOAD
+// and other optional parameters, and anything much larger is taken for a corrupt command length.
+const uint32_t MAX_PDU_LENGTH = 1024 * 1024;
+
+// Returns the error to report for a response, ie. its command status.
+error_code ResponseError(PDU *pdu) {
+  if (pdu->command_status() == ESME::ROK) {
+    return error_code();
+  }
+  return make_error_code(pdu->command_status());
+}
+}  // namespace
+
+SmppClient::SmppClient(shared_ptr<tcp::socket> socket, asio::io_context& ctx,
+                       std::pmr::memory_resource *memory_resource) :
   csms_method_(SmppClient::CSMS_16BIT_TAGS),
   msg_ref_callback_(&SmppClient::DefaultMessageRef),
   state_(ClientState::OPEN),
   ctx_(ctx),
   socket_(socket),
-  timer_(ctx_),
+  memory_resource_(memory_resource),
+  write_timer_(ctx_),
+  response_timer_(ctx_),
+  throttle_timer_(ctx_),
   seq_no_(0),
-  pdu_queue_() {
+  deliver_queue_(memory_resource),
+  enquire_link_queue_(memory_resource),
+  window_size_(10),
+  in_flight_(memory_resource),
+  window_queue_(memory_resource),
+  throttle_tps_(0),
+  throttle_rate_(0),
+  throttle_burst_(1),
+  tokens_(1),
+  tokens_updated_(),
+  throttled_until_(),
+  backoff_started_(),
+  backoff_(0),
+  throttle_retries_(10),
+  sms_waiters_(memory_resource),
+  write_queue_(memory_resource),
+  write_buffers_(memory_resource),
+  writing_(false),
+  reading_(false),
+  response_timer_armed_(false),
+  throttle_timer_armed_(false),
+  cancelled_(false),
+  closing_(false),
+  transport_error_(),
+  read_buffer_(READ_BUFFER_SIZE, memory_resource),
+  read_begin_(0),
+  read_end_(0),
+  metrics_() {
   }
 
 SmppClient::~SmppClient() {
@@ -52,6 +98,36 @@ SmppClient::~SmppClient() {
     }
   } catch (std::exception &e) {
   }
+
+  // Our pending handlers refer to this client, so run them before we go away.
+  closing_ = true;
+  error_code ignored;
+  write_timer_.cancel(ignored);
+  response_timer_.cancel(ignored);
+  throttle_timer_.cancel(ignored);
+  if (reading_ || writing_) {
+    socket_->cancel(ignored);
+  }
+  ctx_.restart();
+  ctx_.poll(ignored);
+  ctx_.restart();
+
+  // Requests still awaiting a response, and reads awaiting an SMS, will never get one.
+  auto in_flight = std::move(in_flight_);
+  auto window_queue = std::move(window_queue_);
+  auto sms_waiters = std::move(sms_waiters_);
+  in_flight_.clear();
+  window_queue_.clear();
+  sms_waiters_.clear();
+  for (auto &request : in_flight) {
+    request.second.handler(asio::error::operation_aborted, nullptr);
+  }
+  for (auto &request : window_queue) {
+    request.handler(asio::error::operation_aborted, nullptr);
+  }
+  for (auto &callback : sms_waiters) {
+    callback(asio::error::operation_aborted, SMS());
+  }
 }
 
 void SmppClient::BindTransmitter(const string &login, const string &pass) {
@@ -62,35 +138,70 @@ void SmppClient::BindReceiver(const string &login, const string &pass) {
   Bind(CommandId::BIND_RECEIVER, login, pass);
 }
 
+void SmppClient::BindTransceiver(const string &login, const string &pass) {
+  Bind(CommandId::BIND_TRANSCEIVER, login, pass);
+}
+
 void SmppClient::Bind(const CommandId &cmd, const string &login, const string &password) {
   CheckConnection();
   CheckState(ClientState::OPEN);
+  transport_error_.clear();
 
   PDU pdu = MakeBindPdu(cmd, login, password);
   SendCommand(&pdu);
+  state_ = BoundState(cmd);
+}
+
+void SmppClient::StartBind(const CommandId &cmd, const string &login, const string &password,
+                           CompletionCallback callback) {
+  if (!socket_->is_open()) {
+    return callback(asio::error::not_connected);
+  }
+  if (state_ != ClientState::OPEN) {
+    return callback(make_error_code(ESME::RALYBND));
+  }
+  transport_error_.clear();
+
+  std::optional<PDU> pdu;  // Emplaced, so the PDU keeps our memory resource.
+  try {
+    pdu.emplace(MakeBindPdu(cmd, login, password));
+  } catch (const FieldLengthException &e) {
+    VLOG(1) << "Not binding: " << e.what();
+    return callback(make_error_code(ESME::RINVPARLEN));
+  }
+  SendRequest(&*pdu, [this, cmd, callback](const error_code &error, PDU *resp) {
+    error_code ec = error ? error : ResponseError(resp);
+    if (!ec) {
+      state_ = BoundState(cmd);
+    }
+    callback(ec);
+  });
+}
 
+SmppClient::ClientState SmppClient::BoundState(const CommandId &cmd) {
   if (cmd == CommandId::BIND_RECEIVER) {
-    state_ = ClientState::BOUND_RX;
+    return ClientState::BOUND_RX;
   } else if (cmd == CommandId::BIND_TRANSMITTER) {
-    state_ = ClientState::BOUND_TX;
+    return ClientState::BOUND_TX;
   }
+  return ClientState::BOUND_TRX;
 }
 
 PDU SmppClient::MakeBindPdu(const CommandId &cmd_id, const string &login, const string &password) {
-  PDU pdu(cmd_id, ESME::ROK, NextSequenceNumber());
-  pdu << login;
-  pdu << password;
-  pdu << FLAGS_system_type;
-  pdu << InterfaceVersion(FLAGS_interface_version);
-  pdu << TON(FLAGS_addr_ton);
-  pdu << NPI(FLAGS_addr_npi);
-  pdu << FLAGS_addr_range;
-  return pdu;
+  BindBody body;
+  body.system_id = login;
+  body.password = password;
+  body.system_type = FLAGS_system_type;
+  body.interface_version = InterfaceVersion(FLAGS_interface_version);
+  body.addr_ton = TON(FLAGS_addr_ton);
+  body.addr_npi = NPI(FLAGS_addr_npi);
+  body.address_range = FLAGS_addr_range;
+  return BindSchema::Encode(cmd_id, [this] { return NextSequenceNumber(); }, body, memory_resource_);
 }
 
 void SmppClient::Unbind() {
   CheckConnection();
-  PDU pdu(CommandId::UNBIND, ESME::ROK, NextSequenceNumber());
+  PDU pdu(CommandId::UNBIND, ESME::ROK, NextSequenceNumber(), memory_resource_);
   PDU resp = SendCommand(&pdu);
   auto pduStatus = resp.command_status();
 
@@ -100,12 +211,27 @@ void SmppClient::Unbind() {
   state_ = ClientState::OPEN;
 }
 
+void SmppClient::StartUnbind(CompletionCallback callback) {
+  if (!socket_->is_open()) {
+    return callback(asio::error::not_connected);
+  }
+
+  PDU pdu(CommandId::UNBIND, ESME::ROK, NextSequenceNumber(), memory_resource_);
+  SendRequest(&pdu, [this, callback](const error_code &error, PDU *resp) {
+    error_code ec = error ? error : ResponseError(resp);
+    if (!ec) {
+      state_ = ClientState::OPEN;
+    }
+    callback(ec);
+  });
+}
+
 pair<string, int> SmppClient::SendSms(
     const SmppAddress &sender,
     const SmppAddress &receiver,
     const string &short_message) {
   struct SmppParams params;
-  return SendSms(sender, receiver, short_message, params, list<TLV>());
+  return SendSms(sender, receiver, short_message, params, TlvList());
 }
 
 pair<string, int> SmppClient::SendSms(
@@ -113,7 +239,7 @@ pair<string, int> SmppClient::SendSms(
     const SmppAddress &receiver,
     const string &short_message,
     const struct SmppParams &params) {
-  return SendSms(sender, receiver, short_message, params, list<TLV>());
+  return SendSms(sender, receiver, short_message, params, TlvList());
 }
 
 pair<string, int> SmppClient::SendSms(
@@ -121,258 +247,621 @@ pair<string, int> SmppClient::SendSms(
     const SmppAddress &receiver,
     const string &short_message,
     const struct SmppParams &params,
-    list<TLV> tags) {
-  int message_len = short_message.length();
-  int single_sms_octet_limit = 254;  // Default SMPP standard
-  int csms_split = -1;  // where to split
+    const TlvList &tags) {
+  CheckTransmitter();
+  int num_messages = 0;
+  vector<PDU> pdus = MakeSubmitSmPdus(sender, receiver, short_message, params, tags, &num_messages);
+  string smsc_id;
+
+  for (auto &pdu : pdus) {
+    PDU resp = SendCommand(&pdu);
+    resp >> smsc_id;
+  }
+  return std::make_pair(smsc_id, num_messages);
+}
 
-  switch (params.data_coding) {
-    case DataCoding::UCS2:
-      single_sms_octet_limit = 140;
-      csms_split = 132;
-      break;
-    case DataCoding::DEFAULT:
-      single_sms_octet_limit = 160;
-      csms_split = 152;
-      break;
-    default:
-      single_sms_octet_limit = 160;
-      csms_split = 152;
+void SmppClient::StartSendSms(
+    const SmppAddress &sender,
+    const SmppAddress &receiver,
+    const string &short_message,
+    const struct SmppParams &params,
+    const TlvList &tags,
+    SendSmsCallback callback) {
+  if (!CanTransmit()) {
+    return callback(make_error_code(ESME::RINVBNDSTS), pair<string, int>());
+  }
+  if (!socket_->is_open()) {
+    return callback(asio::error::not_connected, pair<string, int>());
+  }
+
+  struct SendSmsState {
+    size_t remaining;
+    error_code error;
+    string smsc_id;
+  };
+  int num_messages = 0;
+  vector<PDU> pdus;
+  try {
+    pdus = MakeSubmitSmPdus(sender, receiver, short_message, params, tags, &num_messages);
+  } catch (const FieldLengthException &e) {
+    VLOG(1) << "Not sending SMS: " << e.what();
+    return callback(make_error_code(ESME::RINVPARLEN), pair<string, int>());
+  }
+  auto state = std::make_shared<SendSmsState>();
+  state->remaining = pdus.size();
+
+  for (size_t i = 0; i < pdus.size(); ++i) {
+    bool last = i + 1 == pdus.size();
+    SendRequest(&pdus[i], [state, callback, num_messages, last](const error_code &error, PDU *resp) {
+      error_code ec = error ? error : ResponseError(resp);
+      if (ec && !state->error) {
+        state->error = ec;
+      } else if (!ec && last) {
+        *resp >> state->smsc_id;
+      }
+
+      if (--state->remaining == 0) {
+        callback(state->error, std::make_pair(state->smsc_id, num_messages));
+      }
+    });
+  }
+}
+
+int SmppClient::SendSmsWindowed(
+    const SmppAddress &sender,
+    const SmppAddress &receiver,
+    const string &short_message,
+    const struct SmppParams &params,
+    const TlvList &tags,
+    SubmitSmCallback callback) {
+  if (!callback) {
+    throw SmppException("Windowed submit requires a callback");
+  }
+  CheckTransmitter();
+  int num_messages = 0;
+  vector<PDU> pdus = MakeSubmitSmPdus(sender, receiver, short_message, params, tags, &num_messages);
+
+  for (auto &pdu : pdus) {
+    uint32_t sequence_no = pdu.sequence_no();
+    SendRequest(&pdu, [sequence_no, callback](const error_code &error, PDU *resp) {
+      SubmitSmResult result = { sequence_no, ESME::ROK, string(), error };
+      if (resp) {
+        result.command_status = resp->command_status();
+        if (result.command_status == ESME::ROK && resp->command_id() == CommandId::SUBMIT_SM_RESP) {
+          *resp >> result.message_id;
+        }
+      }
+      callback(result);
+    });
+  }
+
+  // Block while the window is full.
+  if (!RunUntil([this] { return window_queue_.empty(); },
+                std::chrono::milliseconds(FLAGS_socket_read_timeout))) {
+    throw TransportException("Timed out waiting for room in the submit window");
+  }
+  return pdus.size();
+}
+
+void SmppClient::FlushWindow() {
+  RunUntil([this] { return in_flight_.empty() && window_queue_.empty(); });
+}
+
+SubmitMultiResult SmppClient::SubmitMulti(
+    const SmppAddress &sender,
+    const vector<DestAddress> &destinations,
+    const string &short_message,
+    const struct SmppParams &params,
+    const TlvList &tags) {
+  CheckTransmitter();
+  if (destinations.empty()) {
+    throw SmppException("submit_multi requires at least one destination");
+  }
+
+  SubmitMultiBody body;
+  SetSubmitFields(sender, params, tags, &body);
+  SubmitMultiResult result = { string(), 0, vector<UnsuccessSme>() };
+
+  for (size_t first = 0; first < destinations.size(); first += schema::DestAddresses::MAX_DESTS) {
+    body.dest_addresses.data = destinations.data() + first;
+    body.dest_addresses.size = std::min(destinations.size() - first, schema::DestAddresses::MAX_DESTS);
+    vector<PDU> pdus;
+    MakeSubmitPdus<SubmitMultiSchema>(CommandId::SUBMIT_MULTI, &body, short_message, &pdus, &result.num_messages);
+
+    // Every part goes to the same destinations, so a destination refused for several parts is only reported once.
+    size_t group = result.unsuccess_smes.size();
+    for (auto &pdu : pdus) {
+      PDU resp = SendCommand(&pdu);
+      SubmitMultiRespBody resp_body;
+      SubmitMultiRespSchema::Decode(&resp, &resp_body);
+      result.message_id = resp_body.message_id;
+      for (UnsuccessSme &sme : resp_body.unsuccess_smes) {
+        auto same = [&sme](const UnsuccessSme &other) {
+          return other.address.value == sme.address.value && other.address.ton == sme.address.ton
+              && other.address.npi == sme.address.npi;
+        };
+        if (std::none_of(result.unsuccess_smes.begin() + group, result.unsuccess_smes.end(), same)) {
+          result.unsuccess_smes.push_back(std::move(sme));
+        }
+      }
+    }
+  }
+  return result;
+}
+
+DataSmResult SmppClient::SendDataSm(
+    const SmppAddress &sender,
+    const SmppAddress &receiver,
+    const string &payload,
+    const struct SmppParams &params,
+    const TlvList &tags) {
+  CheckTransmitter();
+  struct Response {
+    bool done;
+    error_code error;
+    DataSmResult result;
+  };
+  // Shared with the callback, which outlives this call if we throw.
+  auto response = std::make_shared<Response>();
+  response->done = false;
+  StartSendDataSm(sender, receiver, payload, params, tags,
+                  [response](const error_code &error, const DataSmResult &result) {
+    response->done = true;
+    response->error = error;
+    response->result = result;
+  });
+
+  if (!RunUntil([&response] { return response->done; })) {
+    throw TransportException("Cancelled waiting for reply to data_sm");
+  }
+  if (response->error == asio::error::timed_out) {
+    throw TransportException("Timed out waiting for reply to command");
+  } else if (response->error && response->error.category() != esme_category()) {
+    throw TransportException(system_error(response->error).what());
+  }
+  return response->result;
+}
+
+void SmppClient::StartSendDataSm(
+    const SmppAddress &sender,
+    const SmppAddress &receiver,
+    const string &payload,
+    const struct SmppParams &params,
+    const TlvList &tags,
+    DataSmCallback callback) {
+  if (!CanTransmit()) {
+    return callback(make_error_code(ESME::RINVBNDSTS), DataSmResult { ESME::RINVBNDSTS, string(), TlvList() });
+  }
+  if (!socket_->is_open()) {
+    return callback(asio::error::not_connected, DataSmResult { ESME::ROK, string(), TlvList() });
+  }
+
+  std::optional<PDU> pdu;
+  try {
+    pdu.emplace(MakeDataSmPdu(sender, receiver, payload, params, tags));
+  } catch (const FieldLengthException &e) {
+    VLOG(1) << "Not sending data_sm: " << e.what();
+    return callback(make_error_code(ESME::RINVPARLEN), DataSmResult { ESME::RINVPARLEN, string(), TlvList() });
+  }
+  SendRequest(&*pdu, [callback](const error_code &error, PDU *resp) {
+    DataSmResult result = { ESME::ROK, string(), TlvList() };
+    error_code ec = error;
+    if (resp) {
+      result.command_status = resp->command_status();
+      ec = ResponseError(resp);
+      if (resp->command_id() == CommandId::DATA_SM_RESP) {
+        // The optional parameters explaining a failure are read as well.
+        DataSmRespBody body;
+        try {
+          DataSmRespSchema::Decode(resp, &body);
+          result.tlvs = std::move(body.tlvs);
+          if (!ec) {
+            result.message_id = std::move(body.message_id);
+          }
+        } catch (SmppException &e) {
+          ec = ec ? ec : make_error_code(ESME::RUNKNOWNERR);
+        }
+      }
+    }
+    callback(ec, result);
+  });
+}
+
+PDU SmppClient::MakeDataSmPdu(
+    const SmppAddress &sender,
+    const SmppAddress &receiver,
+    const string &payload,
+    const struct SmppParams &params,
+    const TlvList &tags) {
+  DataSmBody body;
+  body.service_type = params.service_type;
+  body.source_addr_ton = sender.ton;
+  body.source_addr_npi = sender.npi;
+  body.source_addr = sender.value;
+  body.dest_addr_ton = receiver.ton;
+  body.dest_addr_npi = receiver.npi;
+  body.destination_addr = receiver.value;
+  body.esm_class = params.esm_class;
+  body.registered_delivery = params.registered_delivery;
+  body.data_coding = params.data_coding;
+  if (!payload.empty()) {
+    body.message_payload = std::string_view(payload);
+  }
+  body.tlvs = &tags;
+  return DataSmSchema::Encode(CommandId::DATA_SM, [this] { return NextSequenceNumber(); }, body, memory_resource_);
+}
+
+shared_ptr<SmppClient::Batch> SmppClient::StartBatch(BatchSmsCallback callback) {
+  if (!callback) {
+    throw SmppException("Batch submit requires a callback");
+  }
+  CheckTransmitter();
+  return std::make_shared<Batch>(Batch { std::move(callback),
+                                         std::pmr::map<uint32_t, shared_ptr<BatchSmsState>>(memory_resource_),
+                                         0, false });
+}
+
+void SmppClient::SubmitBatchSms(
+    const SmppAddress &sender,
+    const BatchSms &sms,
+    const size_t index,
+    const shared_ptr<Batch> &batch) {
+  // Unlike SendSmsWindowed, only run the io_context when we must wait, so submits queue up between writes.
+  if (!window_queue_.empty() && !RunUntil([this] { return window_queue_.empty(); },
+                                          std::chrono::milliseconds(FLAGS_socket_read_timeout))) {
+    throw TransportException("Timed out waiting for room in the submit window");
+  }
+  CheckConnection();
+
+  auto state = std::make_shared<BatchSmsState>();
+  state->result.index = index;
+  state->result.num_messages = 0;
+  vector<PDU> pdus;
+  try {
+    pdus = MakeSubmitSmPdus(sender, sms.receiver, sms.short_message, sms.params, sms.tags,
+                            &state->result.num_messages);
+  } catch (const FieldLengthException &e) {
+    VLOG(1) << "Not sending SMS " << index << " of batch: " << e.what();
+    state->result.error = make_error_code(ESME::RINVPARLEN);
+    state->result.num_messages = 0;
+    ++batch->submitted;
+    batch->callback(state->result);
+    return;
+  }
+  state->parts = static_cast<uint32_t>(pdus.size());
+  state->remaining = state->parts;
+  uint32_t first_seq_no = pdus.front().sequence_no();
+  batch->pending.emplace(first_seq_no, state);
+  ++batch->submitted;
+
+  for (size_t i = 0; i < pdus.size(); ++i) {
+    bool last = i + 1 == pdus.size();
+    SendRequest(&pdus[i], [batch, state, first_seq_no, last](const error_code &error, PDU *resp) {
+      if (batch->aborted) {
+        return;
+      }
+      error_code ec = error ? error : ResponseError(resp);
+      if (ec && !state->result.error) {
+        state->result.error = ec;
+        state->result.message_id.clear();
+      } else if (!ec && last && !state->result.error) {
+        *resp >> state->result.message_id;
+      }
+
+      if (--state->remaining == 0) {
+        batch->pending.erase(first_seq_no);
+        batch->callback(state->result);
+      }
+    });
+  }
+}
+
+void SmppClient::FinishBatch(const shared_ptr<Batch> &batch) {
+  if (!RunUntil([batch] { return batch->pending.empty(); })) {
+    throw TransportException("Cancelled waiting for the batch to be answered");
   }
+}
+
+void SmppClient::AbortBatch(const shared_ptr<Batch> &batch) {
+  batch->aborted = true;
+  auto pending = std::move(batch->pending);
+  batch->pending.clear();
+
+  // Parts still waiting for room in the window are never sent, those in flight are left to the window.
+  auto in_batch = [&pending](const WindowedRequest &request) {
+    uint32_t seq_no = request.pdu.sequence_no();
+    auto it = pending.upper_bound(seq_no);
+    if (it == pending.begin()) {
+      return false;
+    }
+    --it;
+    return seq_no - it->first < it->second->parts;
+  };
+  window_queue_.erase(std::remove_if(window_queue_.begin(), window_queue_.end(), in_batch), window_queue_.end());
+  UpdateQueueMetrics();
+
+  for (auto &entry : pending) {
+    BatchSmsResult &result = entry.second->result;
+    if (!result.error) {
+      result.error = asio::error::operation_aborted;
+      result.message_id.clear();
+    }
+    batch->callback(result);
+  }
+}
+
+vector<PDU> SmppClient::MakeSubmitSmPdus(
+    const SmppAddress &sender,
+    const SmppAddress &receiver,
+    const string &short_message,
+    const struct SmppParams &params,
+    const TlvList &tags,
+    int *num_messages) {
+  SubmitSmBody body;
+  SetSubmitFields(sender, params, tags, &body);
+  body.dest_addr_ton = receiver.ton;
+  body.dest_addr_npi = receiver.npi;
+  body.destination_addr = receiver.value;
+
+  vector<PDU> pdus;
+  MakeSubmitPdus<SubmitSmSchema>(CommandId::SUBMIT_SM, &body, short_message, &pdus, num_messages);
+  return pdus;
+}
+
+template <class Body>
+void SmppClient::SetSubmitFields(
+    const SmppAddress &sender,
+    const struct SmppParams &params,
+    const TlvList &tags,
+    Body *body) {
+  body->service_type = params.service_type;
+  body->source_addr_ton = sender.ton;
+  body->source_addr_npi = sender.npi;
+  body->source_addr = sender.value;
+  body->esm_class = params.esm_class;
+  body->protocol_id = params.protocol_id;
+  body->priority_flag = params.priority_flag;
+  body->schedule_delivery_time = params.schedule_delivery_time;
+  body->validity_period = params.validity_period;
+  body->registered_delivery = params.registered_delivery;
+  body->replace_if_present_flag = params.replace_if_present_flag;
+  body->data_coding = params.data_coding;
+  body->sm_default_msg_id = params.sm_default_msg_id;
+  body->tlvs = &tags;
+}
+
+template <class Schema>
+void SmppClient::MakeSubmitPdus(
+    const CommandId &cmd_id,
+    typename Schema::Body *body,
+    const string &short_message,
+    vector<PDU> *pdus,
+    int *num_messages) {
+  int message_len = short_message.length();
+  int single_sms_octet_limit = SegmentSize(body->data_coding, 0);
 
   // submit_sm if the short message could fit into one pdu.
   if (message_len <= single_sms_octet_limit || csms_method_ == CSMS_PAYLOAD) {
-    auto num_messages = ceil(static_cast<double>(message_len) / static_cast<double>(single_sms_octet_limit));
-    string smsc_id = SubmitSm(sender, receiver, short_message, params, tags);
-    return std::make_pair(smsc_id, num_messages);
+    *num_messages = ceil(static_cast<double>(message_len) / static_cast<double>(single_sms_octet_limit));
+    pdus->push_back(MakeSubmitPdu<Schema>(cmd_id, body, short_message));
+    return;
   }
 
-  // CSMS -> split message
-  vector<string> parts = Split(short_message, csms_split);
-  vector<string>::iterator itr = parts.begin();
+  // CSMS -> split message, into views of short_message.
+  // The SMSC puts a UDH with a 16 bit reference ahead of segments sent with SAR TLVs.
+  size_t udh_octets = csms_method_ == CSMS_8BIT_UDH ? UDH_8BIT_REF_OCTETS : UDH_16BIT_REF_OCTETS;
+  vector<Segment> segments = SplitSegments(short_message, body->data_coding,
+                                           SegmentSize(body->data_coding, udh_octets));
+  pdus->reserve(pdus->size() + segments.size());
+  *num_messages = segments.size();
 
   if (csms_method_ == CSMS_8BIT_UDH) {
-    // encode an udh with an 8bit csms reference
-    uint8_t segment = 0;
-    uint8_t segments = static_cast<uint8_t>(parts.size());
-    string sms_id;
-    uint8_t csms_ref = static_cast<uint8_t>(msg_ref_callback_() & 0xff);
-
-    SmppParams p(params);
-    p.esm_class = ESM(p.esm_class | ESM::UHDI);
-
-    for (; itr < parts.end(); itr++) {
-      // encode udh
-      int part_size = (*itr).size();
-      int size = 6 + part_size;
-      std::unique_ptr<uint8_t[]> udh(new uint8_t[size]);
-      udh[0] = 0x05;  // length of udh excluding first byte
-      udh[1] = 0x00;  //
-      udh[2] = 0x03;  // length of the header
-      udh[3] = csms_ref;
-      udh[4] = segments;
-      udh[5] = ++segment;
-      // concatenate with message part
-      copy((*itr).begin(), (*itr).end(), &udh[6]);
-      string message(reinterpret_cast<char*>(udh.get()), size);
-      sms_id = SubmitSm(sender, receiver, message, p, tags);
+    // encode an udh with an 8bit csms reference, written into each PDU ahead of its segment
+    char udh[UDH_8BIT_REF_OCTETS] = {
+      0x05,  // length of udh excluding first byte
+      0x00,  // concatenated short messages, 8 bit reference
+      0x03,  // length of the header
+      static_cast<char>(msg_ref_callback_() & 0xff),
+      static_cast<char>(segments.size()),
+      0  // segment
+    };
+
+    ESM esm_class = body->esm_class;
+    body->esm_class = ESM(esm_class | ESM::UHDI);
+
+    for (const Segment &segment : segments) {
+      ++udh[5];
+      pdus->push_back(MakeSubmitPdu<Schema>(cmd_id, body, segment.of(short_message),
+                                            std::string_view(udh, sizeof(udh))));
     }
-    return std::make_pair(sms_id, segments);
+    body->esm_class = esm_class;
   } else {  // csmsMethod == CSMS_16BIT_TAGS)
-    tags.push_back(TLV(Tag::SAR_MSG_REF_NUM, static_cast<uint16_t>(msg_ref_callback_())));
-    tags.push_back(TLV(Tag::SAR_TOTAL_SEGMENTS, static_cast<uint8_t>(parts.size())));
-    int segment = 0;
-    string sms_id;
-
-    for (; itr < parts.end(); ++itr) {
-      tags.push_back(TLV(Tag::SAR_SEGMENT_SEQNUM, ++segment));
-      sms_id = SubmitSm(sender, receiver, (*itr), params, tags);
-      // pop SAR_SEGMENT_SEQNUM tag
-      tags.pop_back();
+    // The SAR TLVs follow the tags of the caller in each PDU.
+    body->sar_msg_ref_num = static_cast<uint16_t>(msg_ref_callback_());
+    body->sar_total_segments = static_cast<uint8_t>(segments.size());
+    body->sar_segment_seqnum = 0;
+
+    for (const Segment &segment : segments) {
+      ++*body->sar_segment_seqnum;
+      pdus->push_back(MakeSubmitPdu<Schema>(cmd_id, body, segment.of(short_message)));
     }
+  }
+}
 
-    // pop SAR_TOTAL_SEGMENTS tag
-    tags.pop_back();
-    // pop SAR_MSG_REF_NUM tag
-    tags.pop_back();
-    return std::make_pair(sms_id, segment);
+template <class Schema>
+PDU SmppClient::MakeSubmitPdu(
+    const CommandId &cmd_id,
+    typename Schema::Body *body,
+    std::string_view short_message,
+    std::string_view udh) {
+  if (csms_method_ == CSMS_PAYLOAD) {
+    body->short_message = schema::OctetParts();  // sm_length = 0
+    body->message_payload = schema::OctetParts(udh, short_message);
+  } else {
+    body->short_message = schema::OctetParts(udh, short_message,
+                                             std::string_view("", FLAGS_null_terminate_octet_strings ? 1 : 0));
   }
+  return Schema::Encode(cmd_id, [this] { return NextSequenceNumber(); }, *body, memory_resource_);
 }
 
 SMS SmppClient::ReadSms() {
   // see if we're bound correct.
-  CheckState(ClientState::BOUND_RX);
+  CheckReceiver();
+  StartRead();
 
-  // if there are any messages in the queue pop the first usable one off and return it
-  if (!pdu_queue_.empty()) {
-    return ParseSms();
-  }
-
-  // fill queue until we get a DELIVER_SM command
+  // if there are any messages in the queue pop the first usable one off and return it,
+  // otherwise wait until we get a DELIVER_SM command
+  SMS sms = ParseSms();
   try {
-    bool got_deliver_sm = false;
-
-    while (!got_deliver_sm) {
-      PDU pdu = ReadPdu(true);
-      if (pdu.command_id() == CommandId::ENQUIRE_LINK) {
-        PDU resp = PDU(CommandId::ENQUIRE_LINK_RESP, ESME::ROK, pdu.sequence_no());
-        SendPdu(&resp);
-        return ParseSms();
-      }
+    RunUntil([this, &sms] {
+          if (sms.is_null) {
+            sms = ParseSms();
+          }
+          return !sms.is_null;
+        }, std::chrono::milliseconds(FLAGS_socket_read_timeout));
+
+    // Make sure the SMSC has our responses before we return.
+    FlushWrites();
+  } catch (std::exception &e) {
+    throw TransportException(e.what());
+  }
+  return sms;
+}
 
-      if (pdu.null()) {
-        break;
-      }
+bool SmppClient::ReadSmsView(const std::function<void(const DeliverSmView &)> &visitor) {
+  CheckReceiver();
+  StartRead();
 
-      if (!pdu.null()) {
-        pdu_queue_.push_back(pdu);    // save pdu for reading later
-      }
-      got_deliver_sm = pdu.command_id() == CommandId::DELIVER_SM;
+  try {
+    if (!RunUntil([this] { return !deliver_queue_.empty(); },
+                  std::chrono::milliseconds(FLAGS_socket_read_timeout))) {
+      return false;
     }
+
+    // Make sure the SMSC has our responses before we return.
+    FlushWrites();
   } catch (std::exception &e) {
     throw TransportException(e.what());
   }
-  return ParseSms();
+
+  PDU pdu = std::move(deliver_queue_.front());
+  deliver_queue_.pop_front();
+  metrics_.Set(&metrics_.deliver_queue, deliver_queue_.size());
+  visitor(DeliverSmView(&pdu));
+  return true;
+}
+
+void SmppClient::StartReadSms(ReadSmsCallback callback) {
+  if (!CanReceive()) {
+    return callback(make_error_code(ESME::RINVBNDSTS), SMS());
+  }
+
+  sms_waiters_.push_back(callback);
+  StartRead();
+  DispatchSms();
 }
 
 void SmppClient::CancelBlocking() {
-  timer_.cancel();
-  socket_->cancel();
-  SocketExecute();
+  asio::post(ctx_, [this] {
+    cancelled_ = true;
+  });
 }
 
 QuerySmResult SmppClient::QuerySm(std::string messageid, const SmppAddress &source) {
-  PDU pdu = PDU(CommandId::QUERY_SM, ESME::ROK, NextSequenceNumber());
-  pdu << messageid;
-  pdu << source.ton;
-  pdu << source.npi;
-  pdu << source.value;
+  PDU pdu = MakeQuerySmPdu(messageid, source);
   PDU reply = SendCommand(&pdu);
-  string msgid;
-  string final_date;
-  uint8_t message_state;
-  uint8_t error_code;
-  reply >> msgid;
-  reply >> final_date;
-  reply >> message_state;
-  reply >> error_code;
+  return ParseQuerySmResp(&reply);
+}
+
+void SmppClient::StartQuerySm(const string &messageid, const SmppAddress &source, QuerySmCallback callback) {
+  if (!socket_->is_open()) {
+    return callback(asio::error::not_connected, QuerySmResult());
+  }
+
+  std::optional<PDU> pdu;
+  try {
+    pdu.emplace(MakeQuerySmPdu(messageid, source));
+  } catch (const FieldLengthException &e) {
+    VLOG(1) << "Not sending query_sm: " << e.what();
+    return callback(make_error_code(ESME::RINVPARLEN), QuerySmResult());
+  }
+  SendRequest(&*pdu, [callback](const error_code &error, PDU *resp) {
+    error_code ec = error ? error : ResponseError(resp);
+    QuerySmResult result;
+    if (!ec) {
+      try {
+        result = ParseQuerySmResp(resp);
+      } catch (SmppException &e) {
+        ec = make_error_code(ESME::RUNKNOWNERR);
+      }
+    }
+    callback(ec, result);
+  });
+}
+
+PDU SmppClient::MakeQuerySmPdu(const string &messageid, const SmppAddress &source) {
+  QuerySmBody body;
+  body.message_id = messageid;
+  body.source_addr_ton = source.ton;
+  body.source_addr_npi = source.npi;
+  body.source_addr = source.value;
+  return QuerySmSchema::Encode(CommandId::QUERY_SM, [this] { return NextSequenceNumber(); }, body, memory_resource_);
+}
+
+QuerySmResult SmppClient::ParseQuerySmResp(PDU *reply) {
+  QuerySmRespBody body;
+  QuerySmRespSchema::Decode(reply, &body);
   std::chrono::time_point<std::chrono::system_clock> tp;
 
-  if (final_date.length() > 1) {
-    timeformat::ChronoDatePair p = timeformat::ParseSmppTimestamp(final_date);
+  if (body.final_date.length() > 1) {
+    timeformat::ChronoDatePair p = timeformat::ParseSmppTimestamp(body.final_date);
     tp = p.first;
   }
 
-  return QuerySmResult(msgid, tp, message_state, error_code);
+  return QuerySmResult(body.message_id, tp, body.message_state, body.error_code);
 }
 
 void SmppClient::EnquireLink() {
   if (state_ == ClientState::OPEN) {
     return;
   }
-  PDU pdu = PDU(CommandId::ENQUIRE_LINK, ESME::ROK, NextSequenceNumber());
+  PDU pdu = PDU(CommandId::ENQUIRE_LINK, ESME::ROK, NextSequenceNumber(), memory_resource_);
   SendCommand(&pdu);
 }
 
-SMS SmppClient::ParseSms() {
-  if (pdu_queue_.empty()) {
-    return SMS();
+void SmppClient::StartEnquireLink(CompletionCallback callback) {
+  if (state_ == ClientState::OPEN) {
+    return callback(error_code());
+  }
+  if (!socket_->is_open()) {
+    return callback(asio::error::not_connected);
   }
 
-  list<PDU>::iterator it = pdu_queue_.begin();
-
-  while (it != pdu_queue_.end()) {
-    if ((*it).command_id() == CommandId::DELIVER_SM) {
-      SMS sms(&*it);
-      // send response to smsc
-      PDU resp = PDU(CommandId::DELIVER_SM_RESP, ESME::ROK, (*it).sequence_no());
-      resp << 0x0;
-      SendPdu(&resp);
-      // remove sms from queue
-      pdu_queue_.erase(it);
-      return sms;
-    }
-
-    if ((*it).command_id() == CommandId::ALERT_NOTIFICATION) {
-      it = pdu_queue_.erase(it);
-      continue;
-    }
+  PDU pdu = PDU(CommandId::ENQUIRE_LINK, ESME::ROK, NextSequenceNumber(), memory_resource_);
+  SendRequest(&pdu, [callback](const error_code &error, PDU *resp) {
+    callback(error ? error : ResponseError(resp));
+  });
+}
 
-    if ((*it).command_id() == CommandId::DATA_SM) {
-      PDU resp = PDU(CommandId::DATA_SM_RESP, ESME::ROK, (*it).sequence_no());
-      resp << 0x0;
-      SendPdu(&resp);
-      it = pdu_queue_.erase(it);
-      continue;
-    }
-    ++it;
+SMS SmppClient::ParseSms() {
+  if (deliver_queue_.empty()) {
+    return SMS();
   }
-  return SMS();
+
+  SMS sms(&deliver_queue_.front());
+  deliver_queue_.pop_front();
+  metrics_.Set(&metrics_.deliver_queue, deliver_queue_.size());
+  return sms;
 }
 
 vector<string> SmppClient::Split(const string &short_message, const int split) {
   vector<string> parts;
-  int len = short_message.length();
-  int pos = 0;
-  int n = split;
-
-  while (pos < len) {
-    if (static_cast<int>(short_message[pos + n - 1]) == 0x1b) {  // do not split at escape char
-      n--;
-    }
-
-    parts.push_back(short_message.substr(pos, n));
-    pos += n;
-    n = split;
-
-    if (pos + n > len) {
-      n = len - pos;
-    }
+  for (const Segment &segment : SplitSegments(short_message, DataCoding::DEFAULT, split)) {
+    parts.push_back(short_message.substr(segment.offset, segment.length));
   }
   return parts;
 }
 
-string SmppClient::SubmitSm(const SmppAddress &sender,
-    const SmppAddress &receiver,
-    const string &short_message,
-    const struct SmppParams &params,
-    list<TLV> tags) {
-  CheckState(ClientState::BOUND_TX);
-  PDU pdu(CommandId::SUBMIT_SM, ESME::ROK, NextSequenceNumber());
-  pdu << params.service_type;
-  pdu << sender;
-  pdu << receiver;
-  pdu << params.esm_class;
-  pdu << params.protocol_id;
-  pdu << params.priority_flag;
-  pdu << params.schedule_delivery_time;
-  pdu << params.validity_period;
-  pdu << params.registered_delivery;
-  pdu << params.replace_if_present_flag;
-  pdu << params.data_coding;
-  pdu << params.sm_default_msg_id;
-
-  if (csms_method_ == CSMS_PAYLOAD) {
-    pdu << 0;  // sm_length = 0
-    pdu << TLV(Tag::MESSAGE_PAYLOAD, short_message);
-  } else {
-    pdu.set_null_terminate_octet_strings(FLAGS_null_terminate_octet_strings);
-    pdu << static_cast<uint8_t>(short_message.length()) + (FLAGS_null_terminate_octet_strings ? 1 : 0);
-    pdu << short_message;
-    pdu.set_null_terminate_octet_strings(true);
-  }
-
-  // add  optional tags.
-  for (list<TLV>::iterator itr = tags.begin(); itr != tags.end(); itr++) {
-    pdu << *itr;
-  }
-
-  PDU resp = SendCommand(&pdu);
-  string messageid;
-  resp >> messageid;
-  return messageid;
-}
-
 uint32_t SmppClient::NextSequenceNumber() {
   if (++seq_no_ > 0x7FFFFFFF) {
     throw SmppException("Ran out of sequence numbers");
@@ -381,33 +870,38 @@ uint32_t SmppClient::NextSequenceNumber() {
 }
 
 void SmppClient::SendPdu(PDU *pdu) {
-  CheckConnection();
-  bool io_result = false;
-  bool timer_result = false;
-
-  VLOG(1) << "\n>>> Sent:" << *pdu;
-
-  timer_.expires_from_now(std::chrono::milliseconds(FLAGS_socket_write_timeout));
-  timer_.async_wait(std::bind(&SmppClient::HandleTimeout, this, &timer_result, _1));
-  async_write(*socket_,
-      buffer(static_cast<const void*>(pdu->GetOctets().c_str()),
-      pdu->Size()),
-      std::bind(&SmppClient::WriteHandler, this, &io_result, _1));
+  QueuePdu(pdu);
+  FlushWrites();
+}
 
-  SocketExecute();
+PDU SmppClient::SendCommand(PDU *pdu) {
+  struct Response {
+    bool done;
+    error_code error;
+    std::unique_ptr<PDU> pdu;
+  };
+  // Shared with the handler, which outlives this call if we throw.
+  auto response = std::make_shared<Response>();
+  response->done = false;
+  SendRequest(pdu, [response](const error_code &error, PDU *resp) {
+    response->done = true;
+    response->error = error;
+    if (resp) {
+      response->pdu.reset(new PDU(std::move(*resp)));
+    }
+  });
 
-  if (io_result) {
-    timer_.cancel();
-  } else if (timer_result) {
-    socket_->cancel();
+  if (!RunUntil([&response] { return response->done; })) {
+    throw TransportException("Cancelled waiting for reply to command");
   }
 
-  SocketExecute();
-}
+  if (response->error == asio::error::timed_out) {
+    throw TransportException("Timed out waiting for reply to command");
+  } else if (response->error) {
+    throw TransportException(system_error(response->error).what());
+  }
 
-PDU SmppClient::SendCommand(PDU *pdu) {
-  SendPdu(pdu);
-  PDU resp = ReadPduResponse(pdu->sequence_no(), pdu->command_id());
+  PDU resp(std::move(*response->pdu));
 
   switch (resp.command_status()) {
     case ESME::ROK:  // Status OK break
@@ -430,199 +924,523 @@ PDU SmppClient::SendCommand(PDU *pdu) {
   return resp;
 }
 
-PDU SmppClient::ReadPdu(const bool &is_blocking) {
-  // return NULL pdu if there is nothing on the wire for us.
-  if (!is_blocking && !SocketPeek()) {
-    return PDU();
+void SmppClient::SendRequest(PDU *pdu, ResponseHandler handler) {
+  CheckConnection();
+  VLOG(1) << "\n>>> Sent:" << *pdu;
+
+  if (in_flight_.size() < window_size_ && window_queue_.empty()
+      && (!IsThrottled(pdu->command_id()) || TakeToken())) {
+    StartRequest(pdu, handler, 0);
+  } else {
+    window_queue_.push_back(WindowedRequest { std::move(*pdu), handler, 0 });
+    ArmThrottleTimer();
   }
+  UpdateQueueMetrics();
+}
 
-  // SocketPeek left something in the queue
-  if (!pdu_queue_.empty()) {
-    PDU pdu = pdu_queue_.back();
-    pdu_queue_.pop_back();
-    VLOG(1) << "\n<<< Received:" << pdu;
-    return pdu;
+void SmppClient::StartRequest(PDU *pdu, ResponseHandler handler, const unsigned int attempts) {
+  auto now = std::chrono::system_clock::now();
+  InFlight request { handler, now + std::chrono::milliseconds(FLAGS_socket_read_timeout), now, std::nullopt,
+                     attempts };
+  in_flight_[pdu->sequence_no()] = std::move(request);
+  write_queue_.push_back(std::move(*pdu));
+  if (!writing_) {
+    StartWrite();
   }
+  StartRead();
+  ArmResponseTimer();
+}
 
-  ReadPduBlocking();
+void SmppClient::ReleaseWindow() {
+  while (in_flight_.size() < window_size_ && !window_queue_.empty()) {
+    if (IsThrottled(window_queue_.front().pdu.command_id()) && !TakeToken()) {
+      ArmThrottleTimer();
+      break;
+    }
+    WindowedRequest request = std::move(window_queue_.front());
+    window_queue_.pop_front();
+    StartRequest(&request.pdu, request.handler, request.attempts);
+  }
+  UpdateQueueMetrics();
+}
+
+void SmppClient::set_throttle(const double tps, const unsigned int burst) {
+  throttle_tps_ = tps > 0 ? tps : 0;
+  throttle_rate_ = throttle_tps_;
+  throttle_burst_ = burst > 0 ? burst : 1;
+  tokens_ = throttle_burst_;
+  tokens_updated_ = std::chrono::system_clock::now();
+}
 
-  // There are no pdus to be read return a null pdu.
-  if (pdu_queue_.empty()) {
-    return PDU();
+bool SmppClient::IsThrottled(const CommandId &command_id) {
+  return command_id == CommandId::SUBMIT_SM || command_id == CommandId::SUBMIT_MULTI
+      || command_id == CommandId::DATA_SM;
+}
+
+bool SmppClient::TakeToken() {
+  auto now = std::chrono::system_clock::now();
+  if (now < throttled_until_) {
+    return false;
+  }
+  if (throttle_tps_ <= 0) {
+    return true;
   }
 
-  // Return last the pdu inserted into the queue.
-  PDU pdu = pdu_queue_.back();
-  pdu_queue_.pop_back();
-  VLOG(1) << "\n<<< Received:" << pdu;
-  return pdu;
+  std::chrono::duration<double> elapsed = now - tokens_updated_;
+  tokens_ = std::min(throttle_burst_, tokens_ + elapsed.count() * throttle_rate_);
+  tokens_updated_ = now;
+  if (tokens_ < 1) {
+    return false;
+  }
+  tokens_ -= 1;
+  return true;
 }
 
-bool SmppClient::SocketPeek() {
-  // prepare our read
-  PduLengthHeader pdu_header;
-  async_read(*socket_, asio::buffer(pdu_header),
-      std::bind(&SmppClient::ReadPduHeaderHandler, this, _1, _2, &pdu_header));
-  size_t handlers_called = ctx_.poll_one();
-  ctx_.reset();
-  socket_->cancel();
-  SocketExecute();
+void SmppClient::BackOff(const std::chrono::time_point<std::chrono::system_clock> &sent) {
+  if (sent < backoff_started_) {
+    // Sent before we slowed down, so it says nothing about the current rate.
+    return;
+  }
 
-  return handlers_called != 0;
+  auto now = std::chrono::system_clock::now();
+  backoff_ = std::min(std::max(backoff_ * 2, std::chrono::milliseconds(100)), std::chrono::milliseconds(5000));
+  backoff_started_ = now;
+  throttled_until_ = now + backoff_;
+  if (throttle_tps_ > 0) {
+    throttle_rate_ = std::max(throttle_rate_ / 2, std::min(throttle_tps_, 1.0));
+  }
+  tokens_ = 0;
+  tokens_updated_ = throttled_until_;
+  LOG(WARNING) << "Throttled by SMSC, pausing submits for " << backoff_.count() << " ms";
 }
 
-void SmppClient::ReadPduBlocking() {
-  bool io_result = false;
-  bool timer_result = false;
-  PduLengthHeader pdu_header;
-  async_read(*socket_,
-      asio::buffer(pdu_header),
-      std::bind(&SmppClient::ReadPduHeaderHandlerBlocking,
-        this,
-        &io_result,
-        _1,
-        _2,
-        &pdu_header));
+void SmppClient::Recover() {
+  backoff_ = std::chrono::milliseconds(0);
+  if (throttle_rate_ < throttle_tps_) {
+    throttle_rate_ = std::min(throttle_tps_, throttle_rate_ + throttle_tps_ / 20);
+  }
+}
 
-  timer_.expires_from_now(std::chrono::milliseconds(FLAGS_socket_read_timeout));
-  timer_.async_wait(std::bind(&SmppClient::HandleTimeout, this, &timer_result, _1));
-  SocketExecute();
+void SmppClient::ArmThrottleTimer() {
+  if (throttle_timer_armed_ || window_queue_.empty() || in_flight_.size() >= window_size_) {
+    return;
+  }
 
-  if (io_result) {
-    timer_.cancel();
-  } else if (timer_result) {
-    socket_->cancel();
+  auto due = std::max(std::chrono::system_clock::now(), throttled_until_);
+  if (throttle_tps_ > 0 && tokens_ < 1) {
+    auto refill = std::chrono::duration<double>((1 - tokens_) / throttle_rate_);
+    due = std::max(due, tokens_updated_ + std::chrono::ceil<std::chrono::microseconds>(refill));
   }
-  SocketExecute();
+
+  throttle_timer_armed_ = true;
+  throttle_timer_.expires_at(due);
+  throttle_timer_.async_wait(std::bind(&SmppClient::HandleThrottleTimeout, this, _1));
 }
 
-void SmppClient::HandleTimeout(bool *callback_result, const error_code &error) {
-  *callback_result = true;
+void SmppClient::HandleThrottleTimeout(const error_code &error) {
+  throttle_timer_armed_ = false;
+  if (error == asio::error::operation_aborted || closing_) {
+    return;
+  }
+  ReleaseWindow();
 }
 
-void SmppClient::WriteHandler(bool *callback_result, const error_code &error) {
-  *callback_result = true;
-  if (error) {
-    throw TransportException(system_error(error).what());
+void SmppClient::QueuePdu(PDU *pdu) {
+  CheckConnection();
+  VLOG(1) << "\n>>> Sent:" << *pdu;
+  write_queue_.push_back(std::move(*pdu));
+  metrics_.Set(&metrics_.write_queue, write_queue_.size());
+  if (!writing_) {
+    StartWrite();
   }
 }
 
-void SmppClient::SocketExecute() {
-  ctx_.run_one();
-  ctx_.reset();
+void SmppClient::StartWrite() {
+  writing_ = true;
+  write_timer_.expires_from_now(std::chrono::milliseconds(FLAGS_socket_write_timeout));
+  write_timer_.async_wait(std::bind(&SmppClient::HandleWriteTimeout, this, _1));
+  // Gather every queued PDU into one write, so they share a writev.
+  // deque::push_back leaves references to existing elements intact, so the PDUs stay valid while we write them.
+  write_buffers_.clear();
+  for (auto &pdu : write_queue_) {
+    std::string_view octets = pdu.Octets();
+    write_buffers_.push_back(buffer(octets.data(), octets.size()));
+  }
+  async_write(*socket_,
+      write_buffers_,
+      std::bind(&SmppClient::WriteHandler, this, _1, _2));
 }
 
-void SmppClient::ReadPduHeaderHandler(const error_code &error, size_t len, const PduLengthHeader *pduLength) {
+void SmppClient::WriteHandler(const error_code &error, size_t written) {
+  writing_ = false;
+  if (closing_) {
+    return;
+  }
+  write_timer_.cancel();
+
   if (error) {
-    if (error == asio::error::operation_aborted) {
-      // Not treated as an error
-      return;
-    }
+    write_queue_.clear();
+    write_buffers_.clear();
+    metrics_.Set(&metrics_.write_queue, 0);
+    HandleTransportError(error == asio::error::operation_aborted ? asio::error::timed_out : error);
+    return;
+  }
 
-    throw TransportException(system_error(error).what());
+  // PDUs queued during the write are left for the next one.
+  for (size_t i = 0; i < write_buffers_.size(); ++i) {
+    KeepForRetry(&write_queue_.front());
+    write_queue_.pop_front();
   }
+  metrics_.Add(&metrics_.pdus_out, write_buffers_.size());
+  metrics_.Add(&metrics_.bytes_out, written);
+  metrics_.Set(&metrics_.write_queue, write_queue_.size());
+  write_buffers_.clear();
+  if (!write_queue_.empty()) {
+    StartWrite();
+  }
+}
 
-  assert(len == 4);
+void SmppClient::KeepForRetry(PDU *pdu) {
+  if (throttle_retries_ == 0 || !IsThrottled(pdu->command_id())) {
+    return;
+  }
+  auto it = in_flight_.find(pdu->sequence_no());
+  if (it != in_flight_.end() && it->second.attempts < throttle_retries_) {
+    it->second.written.emplace(std::move(*pdu));
+  }
+}
 
-  uint32_t i = PDU::GetPduLength(*pduLength);
-  PduData pdu_buffer;
-  pdu_buffer.resize(i);
-  // start reading after the size mark of the pdu
-  async_read(*socket_,
-      buffer(&*pdu_buffer.begin(), i - 4),
-      std::bind(&SmppClient::ReadPduBodyHandler, this, _1, _2, pduLength, &pdu_buffer));
-  SocketExecute();
+void SmppClient::HandleWriteTimeout(const error_code &error) {
+  if (error == asio::error::operation_aborted || closing_) {
+    return;
+  }
+  if (writing_) {
+    error_code ignored;
+    socket_->cancel(ignored);
+  }
 }
 
-void SmppClient::ReadPduHeaderHandlerBlocking(bool *callback_result, const error_code &error, size_t read,
-    const PduLengthHeader *pduLength) {
-  if (error) {
-    if (error == asio::error::operation_aborted) {
-      // Not treated as an error
-      return;
+void SmppClient::FlushWrites() {
+  RunUntil([this] { return write_queue_.empty(); });
+}
+
+void SmppClient::StartRead() {
+  if (reading_) {
+    return;
+  }
+  reading_ = true;
+
+  // Move a partly read PDU to the front, and make room for all of it if it is larger than the buffer.
+  if (read_begin_ > 0) {
+    std::copy(read_buffer_.begin() + read_begin_, read_buffer_.begin() + read_end_, read_buffer_.begin());
+    read_end_ -= read_begin_;
+    read_begin_ = 0;
+  }
+  if (read_end_ >= HEADERFIELD_SIZE) {
+    PduLengthHeader header;
+    std::copy_n(read_buffer_.begin(), HEADERFIELD_SIZE, header.begin());
+    uint32_t len = PDU::GetPduLength(header);
+    if (len > read_buffer_.size() && len <= MAX_PDU_LENGTH) {
+      read_buffer_.resize(len);
     }
-    throw TransportException(system_error(error).what());
   }
 
-  *callback_result = true;
-  uint32_t i = PDU::GetPduLength(*pduLength);
-  PduData pdu_buffer;
-  pdu_buffer.resize(i - 4);
-  // start reading after the size mark of the pdu
-  async_read(*socket_, buffer(static_cast<char*>(&*pdu_buffer.begin()), i - 4),
-      std::bind(&SmppClient::ReadPduBodyHandler, this, _1, _2, pduLength, &pdu_buffer));
-  SocketExecute();
+  socket_->async_read_some(buffer(read_buffer_.data() + read_end_, read_buffer_.size() - read_end_),
+      std::bind(&SmppClient::ReadHandler, this, _1, _2));
 }
 
-void SmppClient::ReadPduBodyHandler(
-    const error_code &error,
-    size_t len,
-    const PduLengthHeader *pduLength,
-    const PduData *pdu_buffer) {
+bool SmppClient::KeepReading() const {
+  return state_ != ClientState::OPEN || !in_flight_.empty() || !sms_waiters_.empty();
+}
+
+bool SmppClient::RunUntil(const std::function<bool()> &done, const std::chrono::milliseconds &timeout) {
+  // A timer of our own, so blocking calls made from handlers don't disturb the wait of their caller.
+  std::unique_ptr<ChronoDeadlineTimer> timer;
+  auto expired = std::make_shared<bool>(false);
+  if (timeout.count() > 0) {
+    timer.reset(new ChronoDeadlineTimer(ctx_));
+    timer->expires_from_now(timeout);
+    timer->async_wait([expired](const error_code &error) {
+      if (error != asio::error::operation_aborted) {
+        *expired = true;
+      }
+    });
+  }
+
+  cancelled_ = false;
+  while (!done()) {
+    if (*expired || cancelled_) {
+      cancelled_ = false;
+      return false;
+    }
+
+    SocketExecute();
+
+    if (transport_error_) {
+      error_code error = transport_error_;
+      transport_error_.clear();
+      throw TransportException(system_error(error).what());
+    }
+  }
+  return true;
+}
+
+void SmppClient::SocketExecute() {
+  ctx_.run_one();
+  ctx_.restart();
+}
+
+void SmppClient::ReadHandler(const error_code &error, size_t len) {
+  reading_ = false;
+  if (closing_) {
+    return;
+  }
+
   if (error) {
-    throw TransportException(system_error(error).what());
+    HandleTransportError(error);
+    return;
+  }
+
+  read_end_ += len;
+  metrics_.Add(&metrics_.bytes_in, len);
+  if (!DispatchReadBuffer()) {
+    return;
+  }
+
+  if (KeepReading()) {
+    StartRead();
+  }
+}
+
+bool SmppClient::DispatchReadBuffer() {
+  // The members are read on every pass, as the handlers of the dispatched PDUs may read the socket themselves.
+  while (read_end_ - read_begin_ >= HEADERFIELD_SIZE) {
+    PduLengthHeader header;
+    std::copy_n(read_buffer_.begin() + read_begin_, HEADERFIELD_SIZE, header.begin());
+    uint32_t len = PDU::GetPduLength(header);
+
+    if (len < HEADERFIELD_SIZE * 4 || len > MAX_PDU_LENGTH) {
+      HandleTransportError(make_error_code(ESME::RINVCMDLEN));
+      return false;
+    }
+
+    if (read_end_ - read_begin_ < len) {
+      break;  // wait for the rest of the PDU
+    }
+
+    PDU pdu(read_buffer_.data() + read_begin_, len, memory_resource_);
+    read_begin_ += len;
+    metrics_.Add(&metrics_.pdus_in);
+    VLOG(1) << "\n<<< Received:" << pdu;
+    DispatchPdu(&pdu);
   }
 
-  pdu_queue_.emplace_back(*pduLength, *pdu_buffer);
+  // A read started by a handler is filling the buffer from read_end_, so leave it alone then.
+  if (read_begin_ == read_end_ && !reading_) {
+    read_begin_ = read_end_ = 0;
+    if (read_buffer_.size() > READ_BUFFER_SIZE) {
+      // Don't hold on to the room for a large PDU.
+      read_buffer_.resize(READ_BUFFER_SIZE);
+      read_buffer_.shrink_to_fit();
+    }
+  }
+  return true;
 }
 
-// blocks until response is read
-PDU SmppClient::ReadPduResponse(const uint32_t &sequence, const CommandId &commandId) {
-  CommandId response = CommandId(CommandId::GENERIC_NACK | commandId);
-  list<PDU>::iterator it = pdu_queue_.begin();
-  while (it != pdu_queue_.end()) {
-    PDU pdu = (*it);
-    if (pdu.sequence_no() == sequence && pdu.command_id() == response) {
-      it = pdu_queue_.erase(it);
-      return pdu;
+void SmppClient::DispatchPdu(PDU *pdu) {
+  CommandId command_id = pdu->command_id();
+  bool is_response = (command_id | CommandId::GENERIC_NACK) == static_cast<uint32_t>(command_id);
+
+  if (!is_response) {
+    // Acknowledge SMSes as they arrive, rather than when the application gets around to reading them.
+    if (command_id == CommandId::DELIVER_SM || command_id == CommandId::DATA_SM) {
+      PDU resp = PDU(command_id == CommandId::DELIVER_SM ? CommandId::DELIVER_SM_RESP : CommandId::DATA_SM_RESP,
+                     ESME::ROK, pdu->sequence_no(), memory_resource_);
+      resp << 0x0;
+      QueuePdu(&resp);
+    }
+
+    switch (command_id) {
+      case CommandId::DELIVER_SM:
+      case CommandId::DATA_SM:
+        deliver_queue_.push_back(std::move(*pdu));
+        metrics_.Set(&metrics_.deliver_queue, deliver_queue_.size());
+        DispatchSms();
+        break;
+      case CommandId::ENQUIRE_LINK:
+        enquire_link_queue_.push_back(pdu->sequence_no());
+        break;
+      case CommandId::ALERT_NOTIFICATION:
+        break;
+      default:
+        LOG(WARNING) << "Dropping unsupported request from SMSC, cmd id:" << std::hex
+                     << static_cast<uint32_t>(command_id) << std::dec;
+    }
+    return;
+  }
+
+  auto it = in_flight_.find(pdu->sequence_no());
+  if (it == in_flight_.end() && command_id == CommandId::GENERIC_NACK && in_flight_.size() == 1) {
+    // The SMSC could not read the sequence number of our request. With one request in flight we know which it is.
+    it = in_flight_.begin();
+  }
+
+  if (it == in_flight_.end()) {
+    LOG(WARNING) << "Dropping response to unknown request, seq:" << pdu->sequence_no();
+    return;
+  }
+
+  InFlight request = std::move(it->second);
+  in_flight_.erase(it);
+  if (in_flight_.empty()) {
+    response_timer_.cancel();
+  }
+
+  metrics_.RecordResponse(command_id, pdu->command_status(),
+                          std::chrono::duration_cast<std::chrono::microseconds>(
+                              std::chrono::system_clock::now() - request.sent));
+  if (pdu->command_status() == ESME::ROK && (command_id == CommandId::BIND_RECEIVER_RESP
+      || command_id == CommandId::BIND_TRANSMITTER_RESP || command_id == CommandId::BIND_TRANSCEIVER_RESP)) {
+    if (metrics_.binds.fetch_add(1, std::memory_order_relaxed) > 0) {
+      metrics_.Add(&metrics_.reconnects);
     }
-    it++;
   }
 
-  while (true) {
-    PDU pdu = ReadPdu(true);
-    if (!pdu.null()) {
-      if ((pdu.sequence_no() == sequence && (pdu.command_id() == response
-              || pdu.command_id() == CommandId::GENERIC_NACK))
-          || (pdu.sequence_no() == 0 && pdu.command_id() == CommandId::GENERIC_NACK)) {
-        return pdu;
+  if (pdu->command_status() == ESME::RTHROTTLED || pdu->command_status() == ESME::RMSGQFUL) {
+    BackOff(request.sent);
+    if (!request.written && throttle_retries_ > 0) {
+      // The response overtook the completion of the write, which still holds the request.
+      for (const PDU &queued : write_queue_) {
+        if (queued.sequence_no() == pdu->sequence_no() && IsThrottled(queued.command_id())) {
+          request.written.emplace(queued);
+          break;
+        }
       }
     }
+    if (request.written && request.attempts < throttle_retries_) {
+      // Send it again, ahead of the requests which have waited less.
+      VLOG(1) << "Retrying throttled request, seq:" << pdu->sequence_no();
+      window_queue_.push_front(WindowedRequest { std::move(*request.written), request.handler,
+                                                 request.attempts + 1 });
+      ReleaseWindow();
+      return;
+    }
+  } else if (pdu->command_status() == ESME::ROK && request.sent >= backoff_started_
+             && IsThrottled(static_cast<CommandId>(static_cast<uint32_t>(command_id)
+                                                   ^ static_cast<uint32_t>(CommandId::GENERIC_NACK)))) {
+    Recover();
   }
+  ReleaseWindow();
+  request.handler(error_code(), pdu);
+}
 
-  PDU pdu;
-  return pdu;
+void SmppClient::DispatchSms() {
+  while (!sms_waiters_.empty()) {
+    SMS sms = ParseSms();
+    if (sms.is_null) {
+      return;
+    }
+    ReadSmsCallback callback = std::move(sms_waiters_.front());
+    sms_waiters_.pop_front();
+    callback(error_code(), sms);
+  }
 }
 
-bool SmppClient::EnquireLinkRespond() {
-  list<PDU>::iterator it = pdu_queue_.begin();
-  while (it != pdu_queue_.end()) {
-    PDU pdu = (*it);
-    if (pdu.command_id() == CommandId::ENQUIRE_LINK) {
-      PDU resp = PDU(CommandId::ENQUIRE_LINK_RESP, ESME::ROK, pdu.sequence_no());
-      SendPdu(&resp);
-      // Remove pdu
-      it = pdu_queue_.erase(it);
+void SmppClient::HandleTransportError(const error_code &error) {
+  transport_error_ = error;
+
+  auto in_flight = std::move(in_flight_);
+  auto window_queue = std::move(window_queue_);
+  auto sms_waiters = std::move(sms_waiters_);
+  in_flight_.clear();
+  window_queue_.clear();
+  sms_waiters_.clear();
+  response_timer_.cancel();
+  throttle_timer_.cancel();
+  metrics_.Add(&metrics_.transport_errors);
+  UpdateQueueMetrics();
+
+  for (auto &request : in_flight) {
+    request.second.handler(error, nullptr);
+  }
+  for (auto &request : window_queue) {
+    request.handler(error, nullptr);
+  }
+  for (auto &callback : sms_waiters) {
+    callback(error, SMS());
+  }
+}
+
+void SmppClient::UpdateQueueMetrics() {
+  metrics_.Set(&metrics_.write_queue, write_queue_.size());
+  metrics_.Set(&metrics_.in_flight, in_flight_.size());
+  metrics_.Set(&metrics_.window_queue, window_queue_.size());
+}
+
+void SmppClient::ArmResponseTimer() {
+  if (response_timer_armed_ || in_flight_.empty()) {
+    return;
+  }
+
+  auto deadline = in_flight_.begin()->second.deadline;
+  for (auto &request : in_flight_) {
+    deadline = std::min(deadline, request.second.deadline);
+  }
+
+  response_timer_armed_ = true;
+  response_timer_.expires_at(deadline);
+  response_timer_.async_wait(std::bind(&SmppClient::HandleResponseTimeout, this, _1));
+}
+
+void SmppClient::HandleResponseTimeout(const error_code &error) {
+  response_timer_armed_ = false;
+  if (closing_) {
+    return;
+  }
+  if (error == asio::error::operation_aborted) {
+    // Cancelled because the window emptied, or re-armed from a request sent meanwhile.
+    ArmResponseTimer();
+    return;
+  }
+
+  auto now = std::chrono::system_clock::now();
+  vector<ResponseHandler> expired;
+  for (auto it = in_flight_.begin(); it != in_flight_.end();) {
+    if (it->second.deadline <= now) {
+      expired.push_back(std::move(it->second.handler));
+      it = in_flight_.erase(it);
     } else {
       ++it;
     }
   }
 
-  PDU pdu = ReadPdu(false);
+  metrics_.Add(&metrics_.timeouts, expired.size());
+  ReleaseWindow();
+  ArmResponseTimer();
+  for (auto &handler : expired) {
+    handler(asio::error::timed_out, nullptr);
+  }
+}
 
-  if (pdu.null()) {
-    return false;
+bool SmppClient::EnquireLinkRespond() {
+  if (state_ != ClientState::OPEN) {
+    StartRead();
   }
 
-  if (pdu.command_id() == CommandId::ENQUIRE_LINK) {
-    PDU resp = PDU(CommandId::ENQUIRE_LINK_RESP, ESME::ROK, pdu.sequence_no());
-    SendPdu(&resp);
-    return true;
+  // Handle whatever has arrived, without blocking.
+  ctx_.poll();
+  ctx_.restart();
+
+  bool responded = !enquire_link_queue_.empty();
+  for (; !enquire_link_queue_.empty(); enquire_link_queue_.pop_front()) {
+    PDU resp = PDU(CommandId::ENQUIRE_LINK_RESP, ESME::ROK, enquire_link_queue_.front(), memory_resource_);
+    QueuePdu(&resp);
   }
 
-  // Not enquire link pdu, put it back in the queue.
-  pdu_queue_.emplace_back(pdu);
-  return false;
+  if (responded) {
+    FlushWrites();
+  }
+  return responded;
 }
 
 void SmppClient::CheckConnection() {
@@ -637,6 +1455,18 @@ void SmppClient::CheckState(const ClientState &state) {
   }
 }
 
+void SmppClient::CheckTransmitter() {
+  if (!CanTransmit()) {
+    throw SmppException("Client in wrong state");
+  }
+}
+
+void SmppClient::CheckReceiver() {
+  if (!CanReceive()) {
+    throw SmppException("Client in wrong state");
+  }
+}
+
 uint16_t SmppClient::DefaultMessageRef() {
   static int ref = 0;
   return (ref++ % 0xffff);
@@ -9,21 +9,30 @@
 
 #include <chrono>
 #include <cstdint>
+#include <deque>
 #include <functional>
-#include <list>
+#include <map>
 #include <memory>
+#include <memory_resource>
+#include <optional>
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <tuple>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
 #include <boost/asio.hpp>
 namespace asio = boost::asio;
 
+#include "smpp/commands.h"
+#include "smpp/deliver_sm_view.h"
 #include "smpp/exceptions.h"
+#include "smpp/metrics.h"
 #include "smpp/pdu.h"
+#include "smpp/segmentation.h"
 #include "smpp/smpp.h"
 #include "smpp/smpp_params.h"
 #include "smpp/sms.h"
@@ -44,10 +53,74 @@ typedef asio::basic_deadline_timer<std::chrono::system_clock, smpp::CXX11Traits<
     ChronoDeadlineTimer;
 typedef std::tuple<std::string, std::chrono::time_point<std::chrono::system_clock>, int, int> QuerySmResult;
 
+// Outcome of a submit_sm sent through the submit window.
+// message_id is only set when command_status is ESME::ROK.
+// error is set if no response was received, ie. on timeout or connection failure.
+struct SubmitSmResult {
+  uint32_t sequence_no;
+  ESME command_status;
+  std::string message_id;
+  boost::system::error_code error;
+};
+typedef std::function<void(const SubmitSmResult &)> SubmitSmCallback;
+
+// Outcome of an SMS sent with SmppClient::SubmitMulti.
+struct SubmitMultiResult {
+  std::string message_id;  // smsc id of the last submit_multi.
+  int num_messages;  // SMSes each destination receives.
+  std::vector<UnsuccessSme> unsuccess_smes;  // Destinations the SMSC could not submit to, each once.
+};
+
+// Outcome of a data_sm sent with SmppClient::SendDataSm.
+// message_id is only set when command_status is ESME::ROK. An SMSC refusing a data_sm may explain why
+// in the optional parameters, eg. DELIVERY_FAILURE_REASON and NETWORK_ERROR_CODE.
+struct DataSmResult {
+  ESME command_status;
+  std::string message_id;
+  TlvList tlvs;  // Optional parameters of the data_sm_resp.
+};
+
+// One SMS of a batch sent with SmppClient::SendSmsBatch.
+struct BatchSms {
+  SmppAddress receiver;
+  std::string short_message;
+  SmppParams params;
+  TlvList tags;
+
+  BatchSms(const SmppAddress &receiver, const std::string &short_message,
+           const SmppParams &params = SmppParams(), const TlvList &tags = TlvList()) :
+    receiver(receiver),
+    short_message(short_message),
+    params(params),
+    tags(tags) {
+  }
+};
+
+// Outcome of one SMS of a batch.
+// error is the first error among the parts of the SMS, an ESME command status in smpp::esme_category()
+// if the SMSC refused one, and message_id is the smsc id of its last part, set if there was no error.
+struct BatchSmsResult {
+  size_t index;  // Position of the SMS in the batch.
+  boost::system::error_code error;
+  std::string message_id;
+  int num_messages;
+};
+typedef std::function<void(const BatchSmsResult &)> BatchSmsCallback;
+
 // Class for sending and receiving SMSes through the SMPP protocol.
 // This clients goal is to simplify sending an SMS and receiving
 // delivery reports and therefore not all features of the SMPP protocol is
 // implemented.
+//
+// Every operation comes in a blocking flavour, which drives the io_context until it completes,
+// and an asynchronous flavour taking an asio completion token (a callback, asio::use_future,
+// asio::use_awaitable, ...), which completes when the io_context is run by the caller.
+// Asynchronous operations report ESME command statuses as error_codes in smpp::esme_category(), and only
+// throw once the client runs out of sequence numbers: a field longer than SMPP allows completes with
+// ESME_RINVPARLEN and a closed socket with asio::error::not_connected. Those still pending when the client is destroyed complete with
+// asio::error::operation_aborted.
+// Both flavours may be mixed on the same client, but the client must only be used from
+// the thread running the io_context.
 class SmppClient {
  public:
   enum class ClientState {
@@ -59,7 +132,16 @@ class SmppClient {
     CSMS_PAYLOAD, CSMS_16BIT_TAGS, CSMS_8BIT_UDH
   };
 
-  explicit SmppClient(std::shared_ptr<asio::ip::tcp::socket>, asio::io_context& ctx);
+  typedef std::function<void(boost::system::error_code)> CompletionCallback;
+  typedef std::function<void(boost::system::error_code, std::pair<std::string, int>)> SendSmsCallback;
+  typedef std::function<void(boost::system::error_code, QuerySmResult)> QuerySmCallback;
+  typedef std::function<void(boost::system::error_code, SMS)> ReadSmsCallback;
+  typedef std::function<void(boost::system::error_code, DataSmResult)> DataSmCallback;
+
+  // @param memory_resource Resource for the PDUs and queues of the client, eg. a pool per session.
+  //   It must outlive the client.
+  explicit SmppClient(std::shared_ptr<asio::ip::tcp::socket>, asio::io_context& ctx,
+                      std::pmr::memory_resource *memory_resource = std::pmr::get_default_resource());
   ~SmppClient();
 
   // Binds the client in transmitter mode.
@@ -68,9 +150,56 @@ class SmppClient {
   // Binds the client in receiver mode.
   void BindReceiver(const std::string &login, const std::string &password);
 
+  // Binds the client in transceiver mode.
+  // SMSes are sent and received over the same connection.
+  void BindTransceiver(const std::string &login, const std::string &password);
+
+  // Asynchronously binds the client in transmitter mode.
+  // Completion signature: void(boost::system::error_code).
+  template <typename CompletionToken>
+  auto BindTransmitterAsync(const std::string &login, const std::string &password, CompletionToken &&token) {
+    return asio::async_initiate<CompletionToken, void(boost::system::error_code)>(
+        [this](auto handler, const std::string &login, const std::string &password) {
+          StartBind(CommandId::BIND_TRANSMITTER, login, password,
+                    WrapHandler<boost::system::error_code>(std::move(handler)));
+        }, token, login, password);
+  }
+
+  // Asynchronously binds the client in receiver mode.
+  // Completion signature: void(boost::system::error_code).
+  template <typename CompletionToken>
+  auto BindReceiverAsync(const std::string &login, const std::string &password, CompletionToken &&token) {
+    return asio::async_initiate<CompletionToken, void(boost::system::error_code)>(
+        [this](auto handler, const std::string &login, const std::string &password) {
+          StartBind(CommandId::BIND_RECEIVER, login, password,
+                    WrapHandler<boost::system::error_code>(std::move(handler)));
+        }, token, login, password);
+  }
+
+  // Asynchronously binds the client in transceiver mode.
+  // Completion signature: void(boost::system::error_code).
+  template <typename CompletionToken>
+  auto BindTransceiverAsync(const std::string &login, const std::string &password, CompletionToken &&token) {
+    return asio::async_initiate<CompletionToken, void(boost::system::error_code)>(
+        [this](auto handler, const std::string &login, const std::string &password) {
+          StartBind(CommandId::BIND_TRANSCEIVER, login, password,
+                    WrapHandler<boost::system::error_code>(std::move(handler)));
+        }, token, login, password);
+  }
+
   // Unbinds the client.
   void Unbind();
 
+  // Asynchronously unbinds the client.
+  // Completion signature: void(boost::system::error_code).
+  template <typename CompletionToken>
+  auto UnbindAsync(CompletionToken &&token) {
+    return asio::async_initiate<CompletionToken, void(boost::system::error_code)>(
+        [this](auto handler) {
+          StartUnbind(WrapHandler<boost::system::error_code>(std::move(handler)));
+        }, token);
+  }
+
   // Sends an SMS to the SMSC with default parameters and no optional tags
   // The SMS is split into multiple messages if it dosen't into one.
   // Returns smsc id and number of smses sent.
@@ -90,13 +219,153 @@ class SmppClient {
   std::pair<std::string, int> SendSms(const SmppAddress &sender, const SmppAddress &receiver,
                                       const std::string &shortMessage,
                                       const SmppParams &params,
-                                      std::list<TLV> tags);
+                                      const TlvList &tags);
+
+  // Asynchronously sends an SMS to the SMSC, splitting it into multiple messages if needed.
+  // The submit_sm PDUs go through the submit window.
+  // Completion signature: void(boost::system::error_code, std::pair<std::string, int>),
+  // with the smsc id of the last part and number of smses sent.
+  template <typename CompletionToken>
+  auto SendSmsAsync(const SmppAddress &sender, const SmppAddress &receiver,
+                    const std::string &short_message,
+                    const SmppParams &params,
+                    TlvList tags,
+                    CompletionToken &&token) {
+    return asio::async_initiate<CompletionToken, void(boost::system::error_code, std::pair<std::string, int>)>(
+        [this](auto handler, const SmppAddress &sender, const SmppAddress &receiver,
+               const std::string &short_message, const SmppParams &params, const TlvList &tags) {
+          StartSendSms(sender, receiver, short_message, params, tags,
+                       WrapHandler<boost::system::error_code, std::pair<std::string, int>>(std::move(handler)));
+        }, token, sender, receiver, short_message, params, std::move(tags));
+  }
+
+  // Asynchronously sends an SMS to the SMSC with default parameters and no optional tags.
+  template <typename CompletionToken>
+  auto SendSmsAsync(const SmppAddress &sender, const SmppAddress &receiver,
+                    const std::string &short_message,
+                    CompletionToken &&token) {
+    return SendSmsAsync(sender, receiver, short_message, SmppParams(), TlvList(),
+                        std::forward<CompletionToken>(token));
+  }
+
+  // Sends an SMS through the submit window, without waiting for the SMSC to respond.
+  // The call only blocks while window_size() PDUs are outstanding.
+  // callback is invoked once for each submit_sm PDU when its response arrives,
+  // in the order the SMSC answers them, which may differ from the order they were sent.
+  // Returns the number of submit_sm PDUs sent.
+  int SendSmsWindowed(const SmppAddress &sender, const SmppAddress &receiver,
+                      const std::string &short_message,
+                      const SmppParams &params,
+                      const TlvList &tags,
+                      SubmitSmCallback callback);
+
+  // Blocks until every outstanding windowed submit_sm has been answered.
+  // Responses that don't arrive within the read timeout are reported to their callback
+  // with SubmitSmResult::error set.
+  void FlushWindow();
+
+  // Sends one SMS to many destinations with submit_multi, 255 destinations per PDU.
+  // The message is split as SendSms splits it, and every part is sent to every group of destinations.
+  // Destinations the SMSC refuses are reported in the result, the call only throws if the SMSC refuses
+  // a submit_multi as a whole.
+  // @param destinations SME addresses and distribution list names.
+  // @throw SmppException if there are no destinations, or a field is longer than SMPP allows.
+  SubmitMultiResult SubmitMulti(const SmppAddress &sender,
+                                const std::vector<DestAddress> &destinations,
+                                const std::string &short_message,
+                                const SmppParams &params = SmppParams(),
+                                const TlvList &tags = TlvList());
+
+  // Sends a message with data_sm and blocks until the SMSC responds.
+  // The whole message goes in one MESSAGE_PAYLOAD, without the fixed fields of a submit_sm and without
+  // splitting it, so it may be up to 65535 octets if the SMSC accepts that.
+  // A data_sm the SMSC refuses doesn't throw, its status and optional parameters are returned.
+  // @param payload Sent in MESSAGE_PAYLOAD, unless empty, eg. when tags carry the payload.
+  // @param params Only service_type, esm_class, registered_delivery and data_coding apply to a data_sm.
+  // @throw SmppException if a field is longer than SMPP allows.
+  // @throw TransportException on timeout or connection failure.
+  DataSmResult SendDataSm(const SmppAddress &sender, const SmppAddress &receiver,
+                          const std::string &payload,
+                          const SmppParams &params = SmppParams(),
+                          const TlvList &tags = TlvList());
+
+  // Asynchronously sends a message with data_sm.
+  // Completion signature: void(boost::system::error_code, smpp::DataSmResult). The result holds
+  // the status and optional parameters of the data_sm_resp, also when the SMSC refused the data_sm.
+  template <typename CompletionToken>
+  auto SendDataSmAsync(const SmppAddress &sender, const SmppAddress &receiver,
+                       const std::string &payload,
+                       const SmppParams &params,
+                       TlvList tags,
+                       CompletionToken &&token) {
+    return asio::async_initiate<CompletionToken, void(boost::system::error_code, DataSmResult)>(
+        [this](auto handler, const SmppAddress &sender, const SmppAddress &receiver,
+               const std::string &payload, const SmppParams &params, const TlvList &tags) {
+          StartSendDataSm(sender, receiver, payload, params, tags,
+                          WrapHandler<boost::system::error_code, DataSmResult>(std::move(handler)));
+        }, token, sender, receiver, payload, params, std::move(tags));
+  }
+
+  // Sends a batch of SMSes from one sender through the submit window, and blocks until all are answered.
+  // Each SMS is split and encoded only once there is room for it in the window, so the batch may be
+  // of any size, eg. read lazily through an input iterator. The io_context is only run while the window
+  // is full, so the submits queued meanwhile go out in one gathered write.
+  // callback is invoked once for each SMS, when all of its parts are answered, in the order the SMSC
+  // answers them. An SMS which can't be encoded, eg. for an address longer than SMPP allows, isn't sent
+  // and is reported with ESME::RINVPARLEN.
+  // If the call throws, the SMSes not yet answered and those not yet sent are first reported with
+  // asio::error::operation_aborted, so callback is never invoked once the call is over. SMSes already
+  // written may still be delivered by the SMSC.
+  // @param first, last Range of BatchSms.
+  // @return Number of SMSes in the batch.
+  // @throw TransportException if the window stays full for the read timeout, the connection fails or
+  // CancelBlocking is called.
+  // @throw SmppException if the client runs out of sequence numbers.
+  template <typename InputIterator>
+  size_t SendSmsBatch(const SmppAddress &sender, InputIterator first, InputIterator last,
+                      BatchSmsCallback callback) {
+    std::shared_ptr<Batch> batch = StartBatch(std::move(callback));
+    size_t index = 0;
+    try {
+      for (; first != last; ++first, ++index) {
+        SubmitBatchSms(sender, *first, index, batch);
+      }
+      FinishBatch(batch);
+    } catch (...) {
+      AbortBatch(batch);
+      for (; first != last; ++first, ++index) {
+        if (index >= batch->submitted) {
+          batch->callback(BatchSmsResult { index, asio::error::operation_aborted, std::string(), 0 });
+        }
+      }
+      throw;
+    }
+    return index;
+  }
 
   // Returns the first SMS in the PDU queue,
   // or does a blocking read on the socket until we receive an SMS from the SMSC.
+  // SMSes come from DELIVER_SM and DATA_SM, see SMS::command_id.
   smpp::SMS ReadSms();
 
+  // Like ReadSms, but hands the SMS to visitor as a view of the DELIVER_SM or DATA_SM,
+  // without copying any of its fields.
+  // The view is only valid during the call.
+  // @return False if no SMS arrived before the read timeout, or the read was cancelled.
+  bool ReadSmsView(const std::function<void(const DeliverSmView &)> &visitor);
+
+  // Asynchronously waits for the next SMS from the SMSC.
+  // Completion signature: void(boost::system::error_code, smpp::SMS).
+  template <typename CompletionToken>
+  auto ReadSmsAsync(CompletionToken &&token) {
+    return asio::async_initiate<CompletionToken, void(boost::system::error_code, SMS)>(
+        [this](auto handler) {
+          StartReadSms(WrapHandler<boost::system::error_code, SMS>(std::move(handler)));
+        }, token);
+  }
+
   // Cancels a blocking call.
+  // Safe to call from any thread.
   void CancelBlocking();
 
   // Query the SMSC about current state/status of a previous sent SMS.
@@ -107,9 +376,30 @@ class SmppClient {
   //
   QuerySmResult QuerySm(std::string messageid, const SmppAddress &source);
 
+  // Asynchronously queries the SMSC about the state of a previous sent SMS.
+  // Completion signature: void(boost::system::error_code, smpp::QuerySmResult).
+  template <typename CompletionToken>
+  auto QuerySmAsync(const std::string &messageid, const SmppAddress &source, CompletionToken &&token) {
+    return asio::async_initiate<CompletionToken, void(boost::system::error_code, QuerySmResult)>(
+        [this](auto handler, const std::string &messageid, const SmppAddress &source) {
+          StartQuerySm(messageid, source,
+                       WrapHandler<boost::system::error_code, QuerySmResult>(std::move(handler)));
+        }, token, messageid, source);
+  }
+
   // Sends an enquire link command to SMSC and blocks until we a response.
   void EnquireLink();
 
+  // Asynchronously sends an enquire link command to the SMSC.
+  // Completion signature: void(boost::system::error_code).
+  template <typename CompletionToken>
+  auto EnquireLinkAsync(CompletionToken &&token) {
+    return asio::async_initiate<CompletionToken, void(boost::system::error_code)>(
+        [this](auto handler) {
+          StartEnquireLink(WrapHandler<boost::system::error_code>(std::move(handler)));
+        }, token);
+  }
+
   // Checks if the SMSC has sent us a enquire link command.
   // If they have, a response is sent.
   bool EnquireLinkRespond();
@@ -119,6 +409,16 @@ class SmppClient {
     return state_ != ClientState::OPEN;
   }
 
+  // Returns true if the client is bound as transmitter or transceiver.
+  inline bool CanTransmit() const {
+    return state_ == ClientState::BOUND_TX || state_ == ClientState::BOUND_TRX;
+  }
+
+  // Returns true if the client is bound as receiver or transceiver.
+  inline bool CanReceive() const {
+    return state_ == ClientState::BOUND_RX || state_ == ClientState::BOUND_TRX;
+  }
+
   inline void set_csms_method(const int csms_method) {
     csms_method_ = csms_method;
   }
@@ -127,6 +427,66 @@ class SmppClient {
     return csms_method_;
   }
 
+  // Sets the maximum number of requests awaiting a response.
+  // Requests sent while the window is full are held back until a response arrives.
+  inline void set_window_size(const unsigned int window_size) {
+    window_size_ = window_size > 0 ? window_size : 1;
+  }
+
+  inline unsigned int window_size() const {
+    return window_size_;
+  }
+
+  // Limits the rate at which submits are written, with a token bucket holding up to burst submits.
+  // Submits over the rate wait in the window queue. The rate is halved whenever the SMSC answers
+  // ESME_RTHROTTLED or ESME_RMSGQFUL, and creeps back up to tps as submits are accepted again.
+  // @param tps Submits per second, 0 for no limit.
+  // @param burst Submits which may be written back to back after a pause.
+  void set_throttle(const double tps, const unsigned int burst = 1);
+
+  inline double throttle_tps() const {
+    return throttle_tps_;
+  }
+
+  // Returns the current submit rate, which is below throttle_tps() while backing off.
+  inline double throttle_rate() const {
+    return throttle_rate_;
+  }
+
+  // Sets how many times a submit answered with ESME_RTHROTTLED or ESME_RMSGQFUL is sent again,
+  // before the status is handed to the caller. 0 disables the retries.
+  inline void set_throttle_retries(const unsigned int throttle_retries) {
+    throttle_retries_ = throttle_retries;
+  }
+
+  inline unsigned int throttle_retries() const {
+    return throttle_retries_;
+  }
+
+  // Returns the number of requests awaiting a response.
+  inline size_t in_flight() const {
+    return in_flight_.size();
+  }
+
+  // Returns the number of requests awaiting a response or room in the window.
+  inline size_t pending() const {
+    return in_flight_.size() + window_queue_.size();
+  }
+
+  // Returns a copy of the counters, queue depths and latency histograms of the client.
+  // Safe to call from any thread, eg. one exporting the metrics of the process.
+  inline MetricsSnapshot metrics() const {
+    return metrics_.Snapshot();
+  }
+
+  // Splits a string, without leaving a dangling escape character, into an vector of substrings of a given length.
+  // SplitSegments does the same for any encoding, without copying the message.
+  // @param shortMessage String to split.
+  // @param split How long each substring should be.
+  // @return Vector of substrings.
+  // @throw SmppException if split is below 2, which can't keep an escape sequence whole.
+  static std::vector<std::string> Split(const std::string &short_message, const int split);
+
   // Set callback method for generating message references.
   // The returned integer must be modulo 65535 (0xffff)
   inline void set_msg_ref_callback(std::function<uint16_t()> msg_ref_callback) {
@@ -134,97 +494,257 @@ class SmppClient {
   }
 
  private:
+  // An SMS of a batch awaiting the responses to its parts, which have consecutive sequence numbers.
+  struct BatchSmsState {
+    BatchSmsResult result;
+    uint32_t parts;
+    uint32_t remaining;  // Parts not yet answered.
+  };
+
+  // SMSes of a batch still awaiting a response, and where to report them.
+  struct Batch {
+    BatchSmsCallback callback;
+    std::pmr::map<uint32_t, std::shared_ptr<BatchSmsState>> pending;  // By sequence number of the first part.
+    size_t submitted;  // SMSes reported or pending, those after them are reported by SendSmsBatch on failure.
+    bool aborted;  // The SMSes were reported, responses arriving later are ignored.
+  };
+
+  // Handler for the response to a request, pdu is null if error is set.
+  typedef std::function<void(const boost::system::error_code &error, PDU *pdu)> ResponseHandler;
+
+  // A request awaiting its response.
+  struct InFlight {
+    ResponseHandler handler;
+    std::chrono::time_point<std::chrono::system_clock> deadline;
+    std::chrono::time_point<std::chrono::system_clock> sent;
+    std::optional<PDU> written;  // A submit once it is written, kept to send again if it is throttled.
+    unsigned int attempts;  // Times the request was throttled so far.
+  };
+
+  // A request held back because the window is full or the throttle is out of tokens.
+  struct WindowedRequest {
+    PDU pdu;
+    ResponseHandler handler;
+    unsigned int attempts;
+  };
+
+  // Wraps an asio completion handler, which may be move-only, into a copyable callback.
+  // The handler is invoked through its associated executor, never from within the initiating function.
+  template <typename... Args, typename Handler>
+  std::function<void(Args...)> WrapHandler(Handler &&handler) {
+    auto h = std::make_shared<typename std::decay<Handler>::type>(std::forward<Handler>(handler));
+    auto ex = asio::get_associated_executor(*h, ctx_.get_executor());
+    return [h, ex](Args... args) {
+      auto a = std::make_tuple(std::move(args)...);
+      asio::post(ex, [h, a]() mutable {
+        std::apply(std::move(*h), std::move(a));
+      });
+    };
+  }
+
   // Binds the client to be in the mode specified in the mode parameter.
   void Bind(const CommandId &bind_cmd, const std::string &login, const std::string &password);
 
+  void StartBind(const CommandId &bind_cmd, const std::string &login, const std::string &password,
+                 CompletionCallback callback);
+  void StartUnbind(CompletionCallback callback);
+  void StartSendSms(const SmppAddress &sender, const SmppAddress &receiver, const std::string &short_message,
+                    const SmppParams &params, const TlvList &tags, SendSmsCallback callback);
+  void StartQuerySm(const std::string &messageid, const SmppAddress &source, QuerySmCallback callback);
+  void StartEnquireLink(CompletionCallback callback);
+  void StartReadSms(ReadSmsCallback callback);
+  void StartSendDataSm(const SmppAddress &sender, const SmppAddress &receiver, const std::string &payload,
+                       const SmppParams &params, const TlvList &tags, DataSmCallback callback);
+
+  // Returns the client state after a successful bind with the given command.
+  static ClientState BoundState(const CommandId &bind_cmd);
+
   // Constructs a PDU for binding the client.
   smpp::PDU MakeBindPdu(const CommandId &cmd_id, const std::string &login, const std::string &password);
 
-  // Runs through the PDU queue and returns the first sms it finds, and sends a reponse to the SMSC.
-  // While running through the PDU queuy, Alert notification and DataSm PDU are handled as well.
-  // @return First sms found in the PDU queue or a null sms if there was no smses.
-  smpp::SMS ParseSms();
+  // Constructs a QUERY_SM PDU.
+  smpp::PDU MakeQuerySmPdu(const std::string &messageid, const SmppAddress &source);
 
-  // Splits a string, without leaving a dangling escape character, into an vector of substrings of a given length,
-  // @param shortMessage String to split.
-  // @param split How long each substring should be.
-  // @return Vector of substrings.
-  static std::vector<std::string> Split(const std::string &short_message, const int split);
+  // Reads the body of a QUERY_SM_RESP PDU.
+  static QuerySmResult ParseQuerySmResp(PDU *pdu);
 
-  // Sends a SUBMIT_SM pdu with the required details for sending an SMS to the SMSC.
-  // It blocks until it gets a response from the SMSC.
+  // Constructs a DATA_SM PDU.
+  // @throw SmppException if a field is longer than SMPP allows.
+  smpp::PDU MakeDataSmPdu(const SmppAddress &sender, const SmppAddress &receiver, const std::string &payload,
+                          const SmppParams &params, const TlvList &tags);
+
+  // Pops the first DELIVER_SM or DATA_SM off the deliver queue and parses it.
+  // @return First sms in the deliver queue or a null sms if there was no smses.
+  smpp::SMS ParseSms();
+
+  // Constructs the SUBMIT_SM PDUs needed to send an SMS, splitting it according to the csms method.
   // @param sender
   // @param receiver
   // @param short_message
   // @param params
   // @param tags
-  // @return SMSC sms id.
-  std::string SubmitSm(const SmppAddress &sender,
+  // @param num_messages Set to the number of SMSes the message will be delivered as.
+  // @return The PDUs to send, in order.
+  std::vector<PDU> MakeSubmitSmPdus(const SmppAddress &sender,
       const SmppAddress &receiver,
       const std::string &short_message,
       const struct SmppParams &params,
-      std::list<TLV> tags);
+      const TlvList &tags,
+      int *num_messages);
+
+  // Fills the fields a SUBMIT_SM and SUBMIT_MULTI body share, except for the short message.
+  // The body views the sender, params and tags, which must outlive it.
+  template <class Body>
+  static void SetSubmitFields(const SmppAddress &sender,
+      const struct SmppParams &params,
+      const TlvList &tags,
+      Body *body);
+
+  // Constructs the PDUs needed to send an SMS with a SUBMIT_SM or SUBMIT_MULTI body,
+  // splitting it according to the csms method.
+  // @param cmd_id
+  // @param body Body with every field but the short message set.
+  // @param short_message
+  // @param pdus The PDUs are appended to pdus, in order.
+  // @param num_messages Set to the number of SMSes the message will be delivered as.
+  // @throw SmppException if a field is longer than SMPP allows.
+  template <class Schema>
+  void MakeSubmitPdus(const CommandId &cmd_id,
+      typename Schema::Body *body,
+      const std::string &short_message,
+      std::vector<PDU> *pdus,
+      int *num_messages);
+
+  // Constructs one PDU with a SUBMIT_SM or SUBMIT_MULTI body, carrying the short message as the csms method dictates.
+  // @param cmd_id
+  // @param body
+  // @param short_message
+  // @param udh Written ahead of short_message, as part of it.
+  // @throw SmppException if a field is longer than SMPP allows.
+  template <class Schema>
+  PDU MakeSubmitPdu(const CommandId &cmd_id,
+      typename Schema::Body *body,
+      std::string_view short_message,
+      std::string_view udh = std::string_view());
 
   // @return Returns the next sequence number.
   // @throw SmppException Throws an SmppException if we run out of sequence numbers.
   uint32_t NextSequenceNumber();
 
-  // Sends one PDU to the SMSC.
+  // Sends one PDU to the SMSC and blocks until it is written.
   void SendPdu(PDU *pdu);
 
   // Sends one PDU to the SMSC and blocks until we a response to it.
   // @param pdu PDU to send.
   // @return PDU PDU response to the one we sent.
+  // @throw TransportException on timeout, connection failure or CancelBlocking.
   smpp::PDU SendCommand(PDU *pdu);
 
-  // Returns one PDU from SMSC.
-  PDU ReadPdu(const bool &);
+  // @throw SmppException if callback is empty or the client can't transmit.
+  std::shared_ptr<Batch> StartBatch(BatchSmsCallback callback);
+
+  // Sends the submit_sm PDUs of one SMS in a batch, blocking first if the window is full.
+  void SubmitBatchSms(const SmppAddress &sender, const BatchSms &sms, const size_t index,
+                      const std::shared_ptr<Batch> &batch);
 
-  void ReadPduBlocking();
+  // Blocks until every SMS of the batch is answered.
+  // @throw TransportException on connection failure or CancelBlocking.
+  void FinishBatch(const std::shared_ptr<Batch> &batch);
 
-  void HandleTimeout(bool *callback_result, const boost::system::error_code &error);
+  // Reports the SMSes of the batch awaiting a response as aborted, and drops their parts not yet sent.
+  void AbortBatch(const std::shared_ptr<Batch> &batch);
+
+  // Sends a request to the SMSC through the window, handler is invoked with its response.
+  // The PDU is moved into the write queue or the window, rather than copied.
+  void SendRequest(PDU *pdu, ResponseHandler handler);
+
+  // Writes a request and registers it as in flight.
+  void StartRequest(PDU *pdu, ResponseHandler handler, const unsigned int attempts);
+
+  // Sends requests held back by the window, as long as there is room in it and the throttle allows.
+  void ReleaseWindow();
+
+  // Returns true for the requests subject to the throttle.
+  static bool IsThrottled(const CommandId &command_id);
+
+  // Takes a token from the bucket, after refilling it for the time passed.
+  // @return false if the submit must wait.
+  bool TakeToken();
+
+  // Slows down after the SMSC throttled a request sent at the given time.
+  // Requests sent before the last back-off started don't slow us down any further.
+  void BackOff(const std::chrono::time_point<std::chrono::system_clock> &sent);
+
+  // Speeds back up after a submit was accepted.
+  void Recover();
+
+  // Arms the throttle timer to release the window when the next token is due.
+  void ArmThrottleTimer();
+
+  void HandleThrottleTimeout(const boost::system::error_code &error);
+
+  // Moves one PDU into the write queue. PDUs are written in the order they are queued,
+  // straight from their own buffer.
+  void QueuePdu(PDU *pdu);
+
+  void StartWrite();
 
   // Async write handler.
-  // @param
-  // @throw TransportException if an error occurred.
-  void WriteHandler(bool *callback_result, const boost::system::error_code &error);
+  void WriteHandler(const boost::system::error_code &error, size_t written);
 
-  // Peeks at the socket and returns true if there is data to be read.
-  //
-  // Because ASIO doesn't allow peeking. SocketPeek accutally reads the
-  // data on the socket and if it is a valid PDU, it is put in the pdu
-  // queue.
-  bool SocketPeek();
+  // Hands a written submit back to its entry in the in-flight table, if it may be retried,
+  // so a throttled submit is sent again without having kept a copy of it.
+  void KeepForRetry(PDU *pdu);
+
+  void HandleWriteTimeout(const boost::system::error_code &error);
+
+  // Blocks until every queued PDU has been written.
+  void FlushWrites();
+
+  // Starts reading PDUs from the socket, unless a read is already in progress.
+  void StartRead();
+
+  // Returns true if the socket should be read after the current PDU.
+  bool KeepReading() const;
+
+  // Handler for reading the socket.
+  // Whatever was available is appended to the read buffer, and every complete PDU in it is dispatched.
+  void ReadHandler(const boost::system::error_code &error, size_t read);
+
+  // Slices every complete PDU out of the read buffer and dispatches it.
+  // @return false if the buffer holds an invalid PDU, which fails the connection.
+  bool DispatchReadBuffer();
+
+  // Hands a response to the handler of the request with the same sequence number, which may move from it.
+  // DELIVER_SM, DATA_SM and ENQUIRE_LINK requests are queued for the application. DELIVER_SM and DATA_SM
+  // are acknowledged right away, so the SMSC doesn't wait for the application to read them.
+  void DispatchPdu(PDU *pdu);
+
+  // Hands a completed SMS to a pending ReadSmsAsync, if there is one and an SMS in the queue.
+  void DispatchSms();
+
+  // Fails every request in flight and every pending read.
+  void HandleTransportError(const boost::system::error_code &error);
+
+  // Updates the queue depths in the metrics.
+  void UpdateQueueMetrics();
+
+  // Removes the requests which have waited longer than the read timeout and fails them.
+  void HandleResponseTimeout(const boost::system::error_code &error);
+
+  void ArmResponseTimer();
+
+  // Runs the io_context until done returns true.
+  // A timeout of zero waits until done, otherwise the wait ends when the timeout expires or
+  // CancelBlocking is called.
+  // @return false if done did not return true.
+  // @throw TransportException if the connection failed while waiting.
+  bool RunUntil(const std::function<bool()> &done,
+                const std::chrono::milliseconds &timeout = std::chrono::milliseconds::zero());
 
   // Executes any pending async operations on the socket.
   void SocketExecute();
 
-  // Handler for reading a PDU header.
-  // If we read a valid PDU header on the socket, the readPduBodyHandler is invoked.
-  void ReadPduHeaderHandler(const boost::system::error_code &error, size_t read,
-                            const PduLengthHeader *pdu_length);
-
-  void ReadPduHeaderHandlerBlocking(bool *callback_result,
-                                    const boost::system::error_code &error, size_t read,
-                                    const PduLengthHeader *pdu_length);
-
-  // Handler for reading a PDU body.
-  // Reads a PDU body on the socket and pushes it onto the PDU queue.
-  void ReadPduBodyHandler(const boost::system::error_code &error, size_t read,
-                          const PduLengthHeader *pdu_length,
-                          const PduData *pdu_buffer);
-
-  // Returns a response for a PDU we have sent,
-  // specified by its sequence number and its command id.
-  // First the PDU queue is checked for any responses,
-  // if we don't find any we do a blocking read on the socket until
-  // we get the desired response.
-  //
-  // @param sequence Sequence number to look for.
-  // @param commandId Command id to look for.
-  // @return PDU response to PDU with the given sequence number and command id.
-  PDU ReadPduResponse(const uint32_t &sequence, const CommandId &command_id);
-
   // Checks the connection.
   // @throw TransportException if there was an problem with the connection.
   void CheckConnection();
@@ -234,6 +754,14 @@ class SmppClient {
   // @throw SmppException if the client is not in the desired state.
   void CheckState(const ClientState &state);
 
+  // Checks if the client may send SMSes, ie. is bound as transmitter or transceiver.
+  // @throw SmppException if the client is not.
+  void CheckTransmitter();
+
+  // Checks if the client may receive SMSes, ie. is bound as receiver or transceiver.
+  // @throw SmppException if the client is not.
+  void CheckReceiver();
+
   // Default implementation for msgRefCallback.
   // Simple initializes a integer on the heap and increments it for each message reference.
   // Returns a modulo 0xffff int.
@@ -245,8 +773,39 @@ class SmppClient {
   ClientState state_;  // Bind state
   asio::io_context& ctx_;
   std::shared_ptr<asio::ip::tcp::socket> socket_;
-  smpp::ChronoDeadlineTimer timer_;
+  std::pmr::memory_resource *memory_resource_;
+  smpp::ChronoDeadlineTimer write_timer_;
+  smpp::ChronoDeadlineTimer response_timer_;
+  smpp::ChronoDeadlineTimer throttle_timer_;
   uint32_t seq_no_;
-  std::list<PDU> pdu_queue_;
+  std::pmr::deque<PDU> deliver_queue_;  // DELIVER_SM and DATA_SM PDUs from the SMSC, waiting to be read.
+  std::pmr::deque<uint32_t> enquire_link_queue_;  // Sequence numbers of ENQUIRE_LINKs waiting for a response.
+  unsigned int window_size_;  // Max number of requests awaiting a response.
+  std::pmr::unordered_map<uint32_t, InFlight> in_flight_;  // Requests awaiting a response by sequence number.
+  std::pmr::deque<WindowedRequest> window_queue_;  // Requests waiting for room in the window.
+  double throttle_tps_;  // Configured submits per second, 0 for no limit.
+  double throttle_rate_;  // Current submits per second, lowered while backing off.
+  double throttle_burst_;
+  double tokens_;  // Submits which may be written right away.
+  std::chrono::time_point<std::chrono::system_clock> tokens_updated_;
+  std::chrono::time_point<std::chrono::system_clock> throttled_until_;  // No submits until then.
+  std::chrono::time_point<std::chrono::system_clock> backoff_started_;
+  std::chrono::milliseconds backoff_;  // Current pause after a throttling response.
+  unsigned int throttle_retries_;
+  std::pmr::deque<ReadSmsCallback> sms_waiters_;  // Pending ReadSmsAsync calls.
+  std::pmr::deque<PDU> write_queue_;  // PDUs waiting to be written, those at the front are being written.
+  std::pmr::vector<asio::const_buffer> write_buffers_;  // Octets of the PDUs being written.
+  bool writing_;
+  bool reading_;
+  bool response_timer_armed_;
+  bool throttle_timer_armed_;
+  bool cancelled_;  // Set by CancelBlocking.
+  bool closing_;
+  boost::system::error_code transport_error_;
+  std::pmr::vector<char> read_buffer_;  // Octets read from the socket, reused for every read.
+                                        // Grows while a PDU larger than it is read.
+  size_t read_begin_;  // First octet in the read buffer not yet dispatched.
+  size_t read_end_;  // End of the octets read into the read buffer.
+  Metrics metrics_;
 };
 }  // namespace smpp
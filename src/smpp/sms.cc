@@ -3,15 +3,69 @@
 // @author hd@onlinecity.dk & td@onlinecity.dk
 
 #include "smpp/sms.h"
-#include <regex>
+#include <algorithm>
+#include <cctype>
 #include <string>
+#include <string_view>
+
+#include "smpp/commands.h"
 
 namespace smpp {
-using std::stoi;
-using std::streamsize;
 using std::string;
+using std::string_view;
+
+namespace {
+// Values of stat in delivery receipts, by message state.
+const char *const kStates[] = { "", "ENROUTE", "DELIVRD", "EXPIRED", "DELETED", "UNDELIV", "ACCEPTD", "UNKNOWN",
+                                "REJECTD" };
+
+// Returns true if a receipt key matches the expected one, ignoring case, spaces and underscores.
+// @param expected Lower case key without spaces.
+bool IsKey(string_view key, string_view expected) {
+  size_t j = 0;
+  for (char c : key) {
+    if (c == ' ' || c == '_') {
+      continue;
+    }
+    if (j == expected.size() || std::tolower(static_cast<unsigned char>(c)) != expected[j]) {
+      return false;
+    }
+    ++j;
+  }
+  return j == expected.size();
+}
+
+// Returns the value of a decimal field, 0 if it isn't one.
+uint32_t ParseNumber(string_view value) {
+  uint32_t n = 0;
+  for (char c : value) {
+    if (c < '0' || c > '9') {
+      return 0;
+    }
+    n = n * 10 + (c - '0');
+  }
+  return n;
+}
+
+// Parses a date of 10 or 12 digits, leaving date alone if it is neither.
+void ParseDate(string_view value, std::chrono::time_point<std::chrono::system_clock> *date) {
+  if ((value.size() == 10 || value.size() == 12)
+      && std::all_of(value.begin(), value.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+    *date = smpp::timeformat::ParseDlrTimestamp(value);
+  }
+}
+
+// Strips the null termination some SMSCs include in the receipt or its TLVs.
+string_view StripNull(string_view value) {
+  while (!value.empty() && value.back() == '\0') {
+    value.remove_suffix(1);
+  }
+  return value;
+}
+}  // namespace
 
 SMS::SMS() :
+  command_id(CommandId::DELIVER_SM),
   service_type(""),
   source_addr_ton(TON::UNKNOWN),
   source_addr_npi(NPI::UNKNOWN),
@@ -35,6 +89,7 @@ SMS::SMS() :
 }
 
 SMS::SMS(PDU *pdu) :
+  command_id(pdu->command_id()),
   service_type(""),
   source_addr_ton(TON::UNKNOWN),
   source_addr_npi(NPI::UNKNOWN),
@@ -55,53 +110,20 @@ SMS::SMS(PDU *pdu) :
   short_message(""),
   tlvs(),
   is_null(false) {
-  *pdu >> service_type;
-  *pdu >> source_addr_ton;
-  *pdu >> source_addr_npi;
-  *pdu >> source_addr;
-  *pdu >> dest_addr_ton;
-  *pdu >> dest_addr_npi;
-  *pdu >> dest_addr;
-  *pdu >> esm_class;
-  *pdu >> protocol_id;
-  *pdu >> priority_flag;
-  *pdu >> schedule_delivery_time;
-  *pdu >> validity_period;
-  *pdu >> registered_delivery;
-  *pdu >> replace_if_present_flag;
-  *pdu >> data_coding;
-  *pdu >> sm_default_msg_id;
-  *pdu >> sm_length;
-  // read short_message with readOctets to ensure we get all chars including null bytes
-  PduData msg;
-  msg.resize(sm_length);
-  pdu->ReadOctets(&msg, sm_length);
-  short_message = msg;
-  // fetch any optional tags
-  Tag tag(Tag::NA);
-  uint16_t len = 0;
-
-  while (pdu->HasMoreData()) {
-    *pdu >> tag;
-    *pdu >> len;
-
-    if (tag == Tag::NA) {
-      break;
-    }
-
-    if (len == 0) {
-      tlvs.push_back(TLV(tag));
-      continue;
+  if (command_id == CommandId::DATA_SM) {
+    DataSmSmsSchema::Decode(pdu, this);
+    const TLV *payload = tlvs.find(Tag::MESSAGE_PAYLOAD);
+    if (payload != nullptr) {
+      short_message.assign(payload->octets());
     }
-
-    PduData octets;
-    octets.resize(len);
-    pdu->ReadOctets(&octets, len);
-    tlvs.push_back(TLV(tag, octets));
+  } else {
+    DeliverSmSchema::Decode(pdu, this);
   }
+  sm_length = short_message.size();
 }
 
 SMS::SMS(const SMS &rhs) :
+  command_id(rhs.command_id),
   service_type(rhs.service_type),
   source_addr_ton(rhs.source_addr_ton),
   source_addr_npi(rhs.source_addr_npi),
@@ -123,7 +145,7 @@ SMS::SMS(const SMS &rhs) :
   tlvs(),
   is_null(rhs.is_null) {
   if (!is_null) {
-    tlvs.assign(rhs.tlvs.begin(), rhs.tlvs.end());
+    tlvs = rhs.tlvs;
   }
 }
 
@@ -136,7 +158,8 @@ DeliveryReport::DeliveryReport() :
   done_date_(),
   stat(""),
   err(""),
-  text("") {
+  text(""),
+  state(State::UNKNOWN) {
 }
 
 DeliveryReport::DeliveryReport(const SMS &sms) :
@@ -148,21 +171,65 @@ DeliveryReport::DeliveryReport(const SMS &sms) :
   done_date_(),
   stat(""),
   err(""),
-  text("") {
-  std::regex expression(
-    "^id:([^ ]+)\\s+sub:(\\d{1,3})\\s+dlvrd:(\\d{1,3})\\s+submit\\s+date:(\\d{1,10})"
-    "\\s+done\\s+date:(\\d{1,10})\\s+stat:([A-Z]{7})\\s+err:(\\d{1,3})\\s+text:(.*)$");
-  std::smatch what;
-
-  if (std::regex_match(short_message, what, expression)) {
-    id = what[1];
-    sub = stoi(what[2]);
-    dlvrd = stoi(what[3]);
-    submit_date_ = smpp::timeformat::ParseDlrTimestamp(what[4]);
-    done_date_ = smpp::timeformat::ParseDlrTimestamp(what[5]);
-    stat = what[6];
-    err = what[7];
-    text = what[8];
+  text(""),
+  state(State::UNKNOWN) {
+  string_view receipt = StripNull(short_message);
+  if (receipt.size() >= 3 && IsKey(receipt.substr(0, 2), "id") && receipt[2] == ':') {
+    // One pass over "key:value" fields separated by spaces. Keys may hold a space, text takes the rest.
+    size_t pos = 0;
+    while (pos < receipt.size()) {
+      size_t colon = receipt.find(':', pos);
+      if (colon == string_view::npos) {
+        break;
+      }
+      string_view key = receipt.substr(pos, colon - pos);
+      if (IsKey(key, "text")) {
+        text.assign(receipt.substr(colon + 1));
+        break;
+      }
+      size_t end = std::min(receipt.find(' ', colon + 1), receipt.size());
+      string_view value = receipt.substr(colon + 1, end - colon - 1);
+
+      if (IsKey(key, "id")) {
+        id.assign(value);
+      } else if (IsKey(key, "sub")) {
+        sub = ParseNumber(value);
+      } else if (IsKey(key, "dlvrd")) {
+        dlvrd = ParseNumber(value);
+      } else if (IsKey(key, "submitdate")) {
+        ParseDate(value, &submit_date_);
+      } else if (IsKey(key, "donedate")) {
+        ParseDate(value, &done_date_);
+      } else if (IsKey(key, "stat")) {
+        stat.assign(value);
+        std::transform(stat.begin(), stat.end(), stat.begin(),
+                       [](char c) { return static_cast<char>(std::toupper(static_cast<unsigned char>(c))); });
+      } else if (IsKey(key, "err")) {
+        err.assign(value);
+      }
+      pos = receipt.find_first_not_of(' ', end);
+    }
+  }
+
+  bool has_state = false;
+  const TLV *tlv = tlvs.find(Tag::RECEIPTED_MESSAGE_ID);
+  if (tlv != nullptr && !StripNull(tlv->octets()).empty()) {
+    id.assign(StripNull(tlv->octets()));
+  }
+  tlv = tlvs.find(Tag::MESSAGE_STATE);
+  if (tlv != nullptr && tlv->len() == 1) {
+    uint8_t value = tlv->get<uint8_t>();
+    if (value >= static_cast<uint8_t>(State::ENROUTE) && value <= static_cast<uint8_t>(State::REJECTED)) {
+      state = static_cast<State>(value);
+      stat = kStates[value];
+      has_state = true;
+    }
+  }
+  if (!has_state) {
+    const char *const *it = std::find(std::begin(kStates) + 1, std::end(kStates), stat);
+    if (it != std::end(kStates)) {
+      state = static_cast<State>(it - std::begin(kStates));
+    }
   }
 }
 
@@ -175,7 +242,8 @@ DeliveryReport::DeliveryReport(const DeliveryReport &rhs) :
   done_date_(rhs.done_date_),
   stat(rhs.stat),
   err(rhs.err),
-  text(rhs.text) {
+  text(rhs.text),
+  state(rhs.state) {
 }
 }  // namespace smpp
 
@@ -187,6 +255,7 @@ std::ostream &smpp::operator<<(std::ostream &out, smpp::SMS &sms) {
   }
 
   out << "sms values:" << endl;
+  out << "command_id:" << std::hex << static_cast<uint32_t>(sms.command_id) << std::dec << endl;
   out << "service_type: " << sms.service_type << endl;
   out << "source_addr_ton:" << sms.source_addr_ton << endl;
   out << "source_addr_npi:" << sms.source_addr_npi << endl;
@@ -5,7 +5,6 @@
 #pragma once
 
 #include <chrono>
-#include <list>
 #include <string>
 
 #include "smpp/pdu.h"
@@ -16,6 +15,10 @@
 namespace smpp {
 class SMS {
  public:
+  // DELIVER_SM, or DATA_SM. A DATA_SM has no protocol_id to sm_length, and its short_message
+  // is the MESSAGE_PAYLOAD parameter.
+  CommandId command_id;
+
   std::string service_type;
   TON source_addr_ton;
   NPI source_addr_npi;
@@ -40,7 +43,7 @@ class SMS {
   int sm_length;
 
   std::string short_message;
-  std::list<TLV> tlvs;
+  TlvList tlvs;
 
   bool is_null;
 
@@ -62,10 +65,14 @@ class DeliveryReport: public SMS {
   std::string stat;
   std::string err;
   std::string text;
+  State state;  // stat as a message state, UNKNOWN if the SMSC gave none.
 
   DeliveryReport();
 
   // Constructs a delivery report from an SMS.
+  // The short message is read as "id:IIII sub:SSS dlvrd:DDD submit date:YYMMDDhhmm done date:YYMMDDhhmm
+  // stat:DDDDDDD err:EEE text:...", with keys in any case, dates with or without seconds and text optional.
+  // The RECEIPTED_MESSAGE_ID and MESSAGE_STATE TLVs take precedence over id and stat when present.
   explicit DeliveryReport(const smpp::SMS &sms);
 
   DeliveryReport(const DeliveryReport &rhs);
@@ -0,0 +1,634 @@
+// Copyright (C) 2011-2014 OnlineCity
+// Licensed under the MIT license, which can be read at: http://www.opensource.org/licenses/mit-license.php
+// @author hd@onlinecity.dk & td@onlinecity.dk
+
+#include "smpp/smsc_simulator.h"
+#include <glog/logging.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <string>
+#include <utility>
+#include <vector>
+#include "smpp/commands.h"
+#include "smpp/exceptions.h"
+#include "smpp/timeformat.h"
+
+namespace smpp {
+using std::string;
+using boost::system::error_code;
+using asio::ip::tcp;
+
+namespace {
+constexpr size_t READ_BUFFER_SIZE = 64 * 1024;  // Grows for a larger PDU.
+constexpr size_t MAX_PDU_LENGTH = 1024 * 1024;
+
+// Returns the response command to a request.
+CommandId ResponseId(const CommandId &command_id) {
+  return static_cast<CommandId>(static_cast<uint32_t>(command_id) | static_cast<uint32_t>(CommandId::GENERIC_NACK));
+}
+
+// Formats the time as the YYMMDDhhmm of a delivery receipt, in UTC as ParseDlrTimestamp reads it.
+string DlrTimestamp(const std::chrono::time_point<std::chrono::system_clock> &time) {
+  char buffer[timeformat::SMPP_TIMESTAMP_LENGTH + 1];
+  timeformat::ToSmppTimeString(time, buffer);
+  return string(buffer, 10);
+}
+}  // namespace
+
+// One bound, or not yet bound, connection to the simulator.
+class SmscSimulator::Session : public std::enable_shared_from_this<SmscSimulator::Session> {
+ public:
+  Session(SmscSimulator *smsc, tcp::socket socket) :
+    smsc_(smsc),
+    socket_(std::move(socket)),
+    bind_(CommandId::NOT_DEFINED),
+    system_id_(),
+    seq_no_(0),
+    read_buffer_(READ_BUFFER_SIZE),
+    read_end_(0),
+    write_queue_(),
+    write_buffers_(),
+    writing_(false),
+    closed_(false) {
+  }
+
+  void Start() {
+    Read();
+  }
+
+  // Closes the connection, leaving the simulator if still attached to it.
+  void Close() {
+    if (closed_) {
+      return;
+    }
+    closed_ = true;
+    error_code ignored;
+    socket_.close(ignored);
+    if (smsc_) {
+      smsc_->Remove(this);
+    }
+  }
+
+  // Closes the connection without touching the simulator, which is going away.
+  void Detach() {
+    smsc_ = nullptr;
+    Close();
+  }
+
+  // Sends a PDU to the ESME after the delay.
+  void Send(PDU pdu, const std::chrono::milliseconds &delay) {
+    if (delay.count() <= 0) {
+      return Queue(std::move(pdu));
+    }
+    auto timer = std::make_shared<asio::steady_timer>(socket_.get_executor(), delay);
+    auto self = shared_from_this();
+    timer->async_wait([self, timer, pdu = std::move(pdu)](const error_code &error) mutable {
+      if (!error && !self->closed_) {
+        self->Queue(std::move(pdu));
+      }
+    });
+  }
+
+  uint32_t NextSequenceNumber() {
+    if (++seq_no_ > 0x7FFFFFFF) {
+      seq_no_ = 1;
+    }
+    return seq_no_;
+  }
+
+  bool CanReceive() const {
+    return bind_ == CommandId::BIND_RECEIVER || bind_ == CommandId::BIND_TRANSCEIVER;
+  }
+
+  bool CanTransmit() const {
+    return bind_ == CommandId::BIND_TRANSMITTER || bind_ == CommandId::BIND_TRANSCEIVER;
+  }
+
+  const string &system_id() const {
+    return system_id_;
+  }
+
+ private:
+  void Read() {
+    auto self = shared_from_this();
+    socket_.async_read_some(asio::buffer(read_buffer_.data() + read_end_, read_buffer_.size() - read_end_),
+                            [self](const error_code &error, size_t read) {
+      self->HandleRead(error, read);
+    });
+  }
+
+  void HandleRead(const error_code &error, size_t read) {
+    if (closed_ || !smsc_) {
+      return;
+    }
+    if (error) {
+      if (error != asio::error::eof) {
+        VLOG(1) << "Session read failed: " << error.message();
+      }
+      return Close();
+    }
+
+    read_end_ += read;
+    size_t begin = 0;
+    while (read_end_ - begin >= HEADERFIELD_SIZE && !closed_) {
+      const unsigned char *octets = reinterpret_cast<const unsigned char *>(read_buffer_.data() + begin);
+      uint32_t len = static_cast<uint32_t>(octets[0]) << 24 | static_cast<uint32_t>(octets[1]) << 16
+                     | static_cast<uint32_t>(octets[2]) << 8 | octets[3];
+      if (len < HEADERFIELD_SIZE * 4 || len > MAX_PDU_LENGTH) {
+        LOG(WARNING) << "Closing session sending a PDU of invalid length " << len;
+        return Close();
+      }
+      if (read_end_ - begin < len) {
+        if (len > read_buffer_.size()) {
+          read_buffer_.resize(len);  // The rest is read after the PDU is moved to the front.
+        }
+        break;
+      }
+      PDU pdu(read_buffer_.data() + begin, len);
+      begin += len;
+      try {
+        Dispatch(&pdu);
+      } catch (SmppException &e) {
+        LOG(WARNING) << "Invalid PDU from ESME: " << e.what();
+        Send(PDU(CommandId::GENERIC_NACK, ESME::RSYSERR, pdu.sequence_no()), std::chrono::milliseconds(0));
+      }
+    }
+
+    if (closed_ || !smsc_) {
+      return;
+    }
+    std::copy(read_buffer_.begin() + begin, read_buffer_.begin() + read_end_, read_buffer_.begin());
+    read_end_ -= begin;
+    Read();
+  }
+
+  void Dispatch(PDU *pdu) {
+    switch (pdu->command_id()) {
+      case CommandId::BIND_RECEIVER:
+      case CommandId::BIND_TRANSMITTER:
+      case CommandId::BIND_TRANSCEIVER:
+        return HandleBind(pdu);
+      case CommandId::SUBMIT_SM:
+        return HandleSubmit(pdu);
+      case CommandId::SUBMIT_MULTI:
+        return HandleSubmitMulti(pdu);
+      case CommandId::DATA_SM:
+        return HandleDataSm(pdu);
+      case CommandId::QUERY_SM:
+        return HandleQuery(pdu);
+      case CommandId::ENQUIRE_LINK:
+        return Respond(pdu, ESME::ROK);
+      case CommandId::UNBIND:
+        bind_ = CommandId::NOT_DEFINED;
+        return Respond(pdu, ESME::ROK);
+      case CommandId::DELIVER_SM_RESP:
+      case CommandId::DATA_SM_RESP:
+      case CommandId::ENQUIRE_LINK_RESP:
+      case CommandId::GENERIC_NACK:
+        return;
+      default:
+        Send(PDU(CommandId::GENERIC_NACK, ESME::RINVCMDID, pdu->sequence_no()), smsc_->ResponseDelay());
+    }
+  }
+
+  // Sends a response without a body.
+  void Respond(PDU *request, const ESME &status) {
+    Send(PDU(ResponseId(request->command_id()), status, request->sequence_no()), smsc_->ResponseDelay());
+  }
+
+  void HandleBind(PDU *pdu) {
+    string system_id;
+    string password;
+    *pdu >> system_id;
+    *pdu >> password;
+
+    ESME status = ESME::ROK;
+    if (bind_ != CommandId::NOT_DEFINED) {
+      status = ESME::RALYBND;
+    } else if (!smsc_->system_id_.empty() && system_id != smsc_->system_id_) {
+      status = ESME::RINVSYSID;
+    } else if (!smsc_->system_id_.empty() && password != smsc_->password_) {
+      status = ESME::RINVPASWD;
+    }
+
+    PDU resp(ResponseId(pdu->command_id()), status, pdu->sequence_no());
+    if (status == ESME::ROK) {
+      bind_ = pdu->command_id();
+      system_id_ = system_id;
+      ++smsc_->stats_.binds;
+      VLOG(1) << "Bound " << system_id << ", cmd id:" << std::hex << static_cast<uint32_t>(bind_) << std::dec;
+      resp << string("SMSCSIM");
+    }
+    Send(std::move(resp), smsc_->ResponseDelay());
+  }
+
+  void HandleSubmit(PDU *pdu) {
+    if (!CanTransmit()) {
+      return Respond(pdu, ESME::RINVBNDSTS);
+    }
+
+    SMS submit(pdu);
+    ++smsc_->stats_.submits;
+    auto delay = smsc_->ResponseDelay();
+    ESME status = smsc_->SubmitStatus(smsc_->stats_.submits);
+    if (status == ESME::RSYSERR) {
+      return Send(PDU(CommandId::GENERIC_NACK, status, pdu->sequence_no()), delay);
+    } else if (status != ESME::ROK) {
+      return Respond(pdu, status);
+    }
+
+    string message_id = smsc_->NextMessageId();
+    PDU resp(CommandId::SUBMIT_SM_RESP, ESME::ROK, pdu->sequence_no());
+    resp << message_id;
+    Send(std::move(resp), delay);
+
+    if (smsc_->receipts_ && (submit.registered_delivery & 0x03) != 0) {
+      auto target = smsc_->ReceiptTarget(this);
+      if (target) {
+        ++smsc_->stats_.receipts;
+        target->Send(smsc_->MakeReceipt(submit, message_id, target->NextSequenceNumber()),
+                     delay + smsc_->receipt_delay_);
+      }
+    }
+  }
+
+  void HandleSubmitMulti(PDU *pdu) {
+    if (!CanTransmit()) {
+      return Respond(pdu, ESME::RINVBNDSTS);
+    }
+
+    string service_type;
+    uint8_t source_addr_ton;
+    uint8_t source_addr_npi;
+    string source_addr;
+    std::vector<DestAddress> dests;
+    *pdu >> service_type >> source_addr_ton >> source_addr_npi >> source_addr;
+    schema::DestAddresses::Get(pdu, &dests);
+    ++smsc_->stats_.submit_multis;
+
+    auto delay = smsc_->ResponseDelay();
+    ESME status = smsc_->SubmitStatus(smsc_->stats_.submit_multis);
+    if (status == ESME::RSYSERR) {
+      return Send(PDU(CommandId::GENERIC_NACK, status, pdu->sequence_no()), delay);
+    } else if (status != ESME::ROK) {
+      return Respond(pdu, status);
+    }
+
+    SubmitMultiRespBody resp;
+    resp.message_id = smsc_->NextMessageId();
+    auto is_digit = [](char c) { return c >= '0' && c <= '9'; };
+    for (const DestAddress &dest : dests) {
+      const string &value = dest.address.value;
+      if (dest.dest_flag == DestFlag::DEST_FLAG_DISTLIST) {
+        resp.unsuccess_smes.push_back(UnsuccessSme { dest.address, ESME::RINVDLNAME });
+      } else if (value.empty() || !std::all_of(value.begin(), value.end(), is_digit)) {
+        resp.unsuccess_smes.push_back(UnsuccessSme { dest.address, ESME::RINVDSTADR });
+      }
+    }
+    PDU reply = SubmitMultiRespSchema::Encode(CommandId::SUBMIT_MULTI_RESP, pdu->sequence_no(), resp);
+    Send(std::move(reply), delay);
+  }
+
+  void HandleDataSm(PDU *pdu) {
+    if (!CanTransmit()) {
+      return Respond(pdu, ESME::RINVBNDSTS);
+    }
+
+    SMS data_sm(pdu);
+    ++smsc_->stats_.data_sms;
+    const string &dest = data_sm.dest_addr;
+    if (dest.empty() || !std::all_of(dest.begin(), dest.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+      PDU resp(CommandId::DATA_SM_RESP, ESME::RDELIVERYFAILURE, pdu->sequence_no());
+      resp << string("");  // message_id
+      resp << TLV(Tag::DELIVERY_FAILURE_REASON, static_cast<uint8_t>(1));  // Invalid destination address
+      resp << TLV(Tag::NETWORK_ERROR_CODE, string("\x03\x00\x01", 3));  // GSM, unknown subscriber
+      return Send(std::move(resp), smsc_->ResponseDelay());
+    }
+
+    PDU resp(CommandId::DATA_SM_RESP, ESME::ROK, pdu->sequence_no());
+    resp << smsc_->NextMessageId();
+    Send(std::move(resp), smsc_->ResponseDelay());
+  }
+
+  void HandleQuery(PDU *pdu) {
+    string message_id;
+    *pdu >> message_id;
+
+    PDU resp(CommandId::QUERY_SM_RESP, ESME::ROK, pdu->sequence_no());
+    resp << message_id;
+    resp << string("");  // final_date
+    resp << static_cast<uint8_t>(2);  // message_state, DELIVERED
+    resp << static_cast<uint8_t>(0);  // error_code
+    Send(std::move(resp), smsc_->ResponseDelay());
+  }
+
+  void Queue(PDU pdu) {
+    write_queue_.push_back(std::move(pdu));
+    if (!writing_) {
+      Write();
+    }
+  }
+
+  // Writes every queued PDU with one gathered write.
+  void Write() {
+    writing_ = true;
+    write_buffers_.clear();
+    for (auto &pdu : write_queue_) {
+      std::string_view octets = pdu.Octets();
+      write_buffers_.push_back(asio::buffer(octets.data(), octets.size()));
+    }
+    auto self = shared_from_this();
+    asio::async_write(socket_, write_buffers_, [self](const error_code &error, size_t) {
+      self->HandleWrite(error);
+    });
+  }
+
+  void HandleWrite(const error_code &error) {
+    writing_ = false;
+    if (closed_) {
+      return;
+    }
+    if (error) {
+      VLOG(1) << "Session write failed: " << error.message();
+      return Close();
+    }
+    for (size_t i = 0; i < write_buffers_.size(); ++i) {
+      write_queue_.pop_front();
+    }
+    if (!write_queue_.empty()) {
+      Write();
+    }
+  }
+
+  SmscSimulator *smsc_;  // Null once the simulator stopped.
+  tcp::socket socket_;
+  CommandId bind_;  // Command the session was bound with, NOT_DEFINED while unbound.
+  string system_id_;
+  uint32_t seq_no_;
+  std::vector<char> read_buffer_;
+  size_t read_end_;
+  std::deque<PDU> write_queue_;
+  std::vector<asio::const_buffer> write_buffers_;
+  bool writing_;
+  bool closed_;
+};
+
+SmscSimulator::SmscSimulator(asio::io_context &ctx, const tcp::endpoint &endpoint) :
+  ctx_(ctx),
+  acceptor_(ctx),
+  listen_endpoint_(endpoint),
+  sessions_(),
+  next_receiver_(0),
+  deliver_timer_(ctx),
+  random_(std::random_device()()),
+  system_id_(),
+  password_(),
+  latency_(0),
+  jitter_(0),
+  throttle_every_(0),
+  max_tps_(0),
+  nack_every_(0),
+  receipts_(true),
+  receipt_delay_(0),
+  deliver_rate_(0),
+  deliver_data_sm_(false),
+  deliver_due_(),
+  message_id_(0),
+  tps_second_(),
+  tps_count_(0),
+  stats_(),
+  started_(false) {
+}
+
+SmscSimulator::~SmscSimulator() {
+  Stop();
+
+  // The aborted accept and timer handlers refer to the simulator, so run them before we go away.
+  error_code ignored;
+  ctx_.restart();
+  ctx_.poll(ignored);
+  ctx_.restart();
+}
+
+void SmscSimulator::Start() {
+  try {
+    acceptor_.open(listen_endpoint_.protocol());
+    acceptor_.set_option(tcp::acceptor::reuse_address(true));
+    acceptor_.bind(listen_endpoint_);
+    acceptor_.listen();
+  } catch (boost::system::system_error &e) {
+    error_code ignored;
+    acceptor_.close(ignored);
+    throw TransportException(string("Simulator failed to listen: ") + e.what());
+  }
+
+  started_ = true;
+  tps_second_ = std::chrono::steady_clock::now();
+  deliver_due_ = tps_second_;
+  Accept();
+  ArmDeliverTimer();
+}
+
+void SmscSimulator::Stop() {
+  started_ = false;
+  error_code ignored;
+  acceptor_.close(ignored);
+  deliver_timer_.cancel();
+
+  auto sessions = std::move(sessions_);
+  sessions_.clear();
+  for (auto &session : sessions) {
+    session->Detach();
+  }
+}
+
+tcp::endpoint SmscSimulator::endpoint() const {
+  error_code ignored;
+  return acceptor_.local_endpoint(ignored);
+}
+
+void SmscSimulator::set_deliver_rate(const double rate) {
+  deliver_rate_ = rate;
+  deliver_due_ = std::chrono::steady_clock::now();
+  if (started_) {
+    deliver_timer_.cancel();
+    ArmDeliverTimer();
+  }
+}
+
+void SmscSimulator::Accept() {
+  acceptor_.async_accept([this](const error_code &error, tcp::socket socket) {
+    if (error == asio::error::operation_aborted || !started_) {
+      return;
+    }
+    if (error) {
+      LOG(WARNING) << "Simulator failed to accept: " << error.message();
+    } else {
+      auto session = std::make_shared<Session>(this, std::move(socket));
+      sessions_.push_back(session);
+      session->Start();
+    }
+    Accept();
+  });
+}
+
+void SmscSimulator::Remove(Session *session) {
+  sessions_.remove_if([session](const std::shared_ptr<Session> &s) {
+    return s.get() == session;
+  });
+}
+
+std::shared_ptr<SmscSimulator::Session> SmscSimulator::ReceiptTarget(Session *session) {
+  if (session->CanReceive()) {
+    return session->shared_from_this();
+  }
+  for (auto &s : sessions_) {
+    if (s->CanReceive() && s->system_id() == session->system_id()) {
+      return s;
+    }
+  }
+  return nullptr;
+}
+
+std::shared_ptr<SmscSimulator::Session> SmscSimulator::NextReceiver() {
+  if (sessions_.empty()) {
+    return nullptr;
+  }
+  size_t first = next_receiver_ % sessions_.size();
+  auto it = std::next(sessions_.begin(), first);
+  for (size_t n = 0; n < sessions_.size(); ++n, ++it) {
+    if (it == sessions_.end()) {
+      it = sessions_.begin();
+    }
+    if ((*it)->CanReceive()) {
+      next_receiver_ = first + n + 1;
+      return *it;
+    }
+  }
+  return nullptr;
+}
+
+string SmscSimulator::NextMessageId() {
+  char buffer[24];
+  std::snprintf(buffer, sizeof(buffer), "%016llx", static_cast<unsigned long long>(++message_id_));  // NOLINT
+  return buffer;
+}
+
+ESME SmscSimulator::SubmitStatus(const uint64_t count) {
+  if (nack_every_ > 0 && count % nack_every_ == 0) {
+    ++stats_.nacked;
+    return ESME::RSYSERR;
+  }
+  if (throttle_every_ > 0 && count % throttle_every_ == 0) {
+    ++stats_.throttled;
+    return ESME::RTHROTTLED;
+  }
+  if (max_tps_ > 0) {
+    auto now = std::chrono::steady_clock::now();
+    if (now - tps_second_ >= std::chrono::seconds(1)) {
+      tps_second_ = now;
+      tps_count_ = 0;
+    }
+    if (tps_count_ >= max_tps_) {
+      ++stats_.throttled;
+      return ESME::RTHROTTLED;
+    }
+    ++tps_count_;
+  }
+  return ESME::ROK;
+}
+
+std::chrono::milliseconds SmscSimulator::ResponseDelay() {
+  if (jitter_.count() <= 0) {
+    return latency_;
+  }
+  std::uniform_int_distribution<int64_t> jitter(0, jitter_.count());
+  return latency_ + std::chrono::milliseconds(jitter(random_));
+}
+
+PDU SmscSimulator::MakeReceipt(const SMS &submit, const string &message_id, const uint32_t seq_no) {
+  auto now = std::chrono::system_clock::now();
+  string text = "id:" + message_id + " sub:001 dlvrd:001 submit date:" + DlrTimestamp(now)
+                + " done date:" + DlrTimestamp(now) + " stat:DELIVRD err:000 text:"
+                + submit.short_message.substr(0, std::min<size_t>(20, submit.short_message.find('\0')));
+
+  PDU pdu(CommandId::DELIVER_SM, ESME::ROK, seq_no);
+  pdu << string("");  // service_type
+  pdu << SmppAddress(submit.dest_addr, submit.dest_addr_ton, submit.dest_addr_npi);
+  pdu << SmppAddress(submit.source_addr, submit.source_addr_ton, submit.source_addr_npi);
+  pdu << ESM::DELIVER_SMSC_RECEIPT;
+  pdu << 0;  // protocol_id
+  pdu << 0;  // priority_flag
+  pdu << string("");  // schedule_delivery_time
+  pdu << string("");  // validity_period
+  pdu << 0;  // registered_delivery
+  pdu << 0;  // replace_if_present_flag
+  pdu << DataCoding::DEFAULT;
+  pdu << 0;  // sm_default_msg_id
+  pdu << static_cast<uint8_t>(text.size());
+  pdu.AddOctets(text, text.size());
+  pdu << TLV(Tag::RECEIPTED_MESSAGE_ID, message_id);
+  pdu << TLV(Tag::MESSAGE_STATE, static_cast<uint8_t>(2));  // DELIVERED
+  return pdu;
+}
+
+void SmscSimulator::ArmDeliverTimer() {
+  if (deliver_rate_ <= 0 || !started_) {
+    return;
+  }
+  deliver_timer_.expires_at(deliver_due_);
+  deliver_timer_.async_wait(std::bind(&SmscSimulator::HandleDeliverTimeout, this, std::placeholders::_1));
+}
+
+void SmscSimulator::HandleDeliverTimeout(const error_code &error) {
+  if (error == asio::error::operation_aborted || !started_) {
+    return;
+  }
+
+  auto interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+      std::chrono::duration<double>(1 / deliver_rate_));
+  auto now = std::chrono::steady_clock::now();
+  for (; deliver_due_ <= now; deliver_due_ += interval) {
+    auto target = NextReceiver();
+    if (!target) {
+      // Nobody to deliver to, don't build up a backlog meanwhile.
+      deliver_due_ = now + interval;
+      break;
+    }
+
+    string message = "Message " + std::to_string(++stats_.delivers) + " from the simulator";
+    if (deliver_data_sm_) {
+      PDU pdu(CommandId::DATA_SM, ESME::ROK, target->NextSequenceNumber());
+      pdu << string("");  // service_type
+      pdu << SmppAddress("4512345678", TON::INTERNATIONAL, NPI::E164);
+      pdu << SmppAddress(target->system_id(), TON::ALPHANUMERIC, NPI::UNKNOWN);
+      pdu << ESM::SUBMIT_MODE_SMSC_DEFAULT;
+      pdu << 0;  // registered_delivery
+      pdu << DataCoding::DEFAULT;
+      pdu << TLV(Tag::MESSAGE_PAYLOAD, message);
+      target->Send(std::move(pdu), std::chrono::milliseconds(0));
+      continue;
+    }
+
+    PDU pdu(CommandId::DELIVER_SM, ESME::ROK, target->NextSequenceNumber());
+    pdu << string("");  // service_type
+    pdu << SmppAddress("4512345678", TON::INTERNATIONAL, NPI::E164);
+    pdu << SmppAddress(target->system_id(), TON::ALPHANUMERIC, NPI::UNKNOWN);
+    pdu << ESM::SUBMIT_MODE_SMSC_DEFAULT;
+    pdu << 0;  // protocol_id
+    pdu << 0;  // priority_flag
+    pdu << string("");  // schedule_delivery_time
+    pdu << string("");  // validity_period
+    pdu << 0;  // registered_delivery
+    pdu << 0;  // replace_if_present_flag
+    pdu << DataCoding::DEFAULT;
+    pdu << 0;  // sm_default_msg_id
+    pdu << static_cast<uint8_t>(message.size());
+    pdu.AddOctets(message, message.size());
+    target->Send(std::move(pdu), std::chrono::milliseconds(0));
+  }
+  ArmDeliverTimer();
+}
+}  // namespace smpp
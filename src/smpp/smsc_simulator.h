@@ -0,0 +1,171 @@
+// Copyright (C) 2011-2014 OnlineCity
+// Licensed under the MIT license, which can be read at: http://www.opensource.org/licenses/mit-license.php
+// @author hd@onlinecity.dk & td@onlinecity.dk
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <random>
+#include <string>
+
+#include <boost/asio.hpp>
+namespace asio = boost::asio;
+
+#include "smpp/pdu.h"
+#include "smpp/smpp.h"
+#include "smpp/sms.h"
+
+namespace smpp {
+// Counters kept by the simulator since it was constructed.
+struct SmscStats {
+  uint64_t binds;
+  uint64_t submits;  // submit_sm PDUs received, including those rejected.
+  uint64_t submit_multis;  // submit_multi PDUs received, including those rejected.
+  uint64_t data_sms;  // data_sm PDUs received, including those rejected.
+  uint64_t throttled;  // submit_sm and submit_multi answered with ESME_RTHROTTLED.
+  uint64_t nacked;  // submit_sm and submit_multi answered with generic_nack.
+  uint64_t receipts;  // Delivery receipts sent.
+  uint64_t delivers;  // Mobile originated deliver_sm or data_sm sent.
+};
+
+// SMSC simulator for testing and load generation without a real SMSC.
+// It accepts binds, answers submit_sm with generated message ids, sends delivery receipts in the
+// format DeliveryReport parses and pushes deliver_sm to receivers at a configurable rate. Latency,
+// throttling and generic_nack responses can be injected.
+// submit_multi is answered too, refusing distribution lists, which the simulator has none of, and
+// SME addresses which aren't all digits. data_sm is answered likewise, failing a destination which
+// isn't all digits with DELIVERY_FAILURE_REASON and NETWORK_ERROR_CODE. Receipts are only sent for submit_sm.
+// The simulator runs on the given io_context, which may be shared with the clients under test.
+class SmscSimulator {
+ public:
+  // @param ctx io_context for the listening socket and the sessions.
+  // @param endpoint Address to listen on. Port 0 picks a free port, see endpoint().
+  SmscSimulator(asio::io_context &ctx, const asio::ip::tcp::endpoint &endpoint);
+  ~SmscSimulator();
+
+  SmscSimulator(const SmscSimulator &) = delete;
+  SmscSimulator &operator=(const SmscSimulator &) = delete;
+
+  // Starts listening and accepting sessions.
+  // @throw TransportException if the endpoint can't be listened on.
+  void Start();
+
+  // Stops listening and closes every session.
+  void Stop();
+
+  // Returns the address the simulator listens on.
+  asio::ip::tcp::endpoint endpoint() const;
+
+  // Only binds with these credentials are accepted. Any are if system_id is empty, the default.
+  inline void set_credentials(const std::string &system_id, const std::string &password) {
+    system_id_ = system_id;
+    password_ = password;
+  }
+
+  // Delays every response by latency plus a random share of jitter.
+  inline void set_latency(const std::chrono::milliseconds &latency,
+                          const std::chrono::milliseconds &jitter = std::chrono::milliseconds(0)) {
+    latency_ = latency;
+    jitter_ = jitter;
+  }
+
+  // Answers every n-th submit_sm, and every n-th submit_multi, with ESME_RTHROTTLED, 0 never does.
+  // The two are counted apart, so submit_multis don't shift which submit_sm is throttled.
+  inline void set_throttle_every(const unsigned int n) {
+    throttle_every_ = n;
+  }
+
+  // Answers the submit_sm and submit_multi beyond max_tps within a second with ESME_RTHROTTLED, 0 for no limit.
+  inline void set_max_tps(const unsigned int max_tps) {
+    max_tps_ = max_tps;
+  }
+
+  // Answers every n-th submit_sm, and every n-th submit_multi, with generic_nack, 0 never does.
+  inline void set_nack_every(const unsigned int n) {
+    nack_every_ = n;
+  }
+
+  // Sends a delivery receipt for every accepted submit_sm requesting one, after delay.
+  // The receipt goes to the submitting session if it is a transceiver, otherwise to a receiver
+  // bound with the same system id. Receipts are on by default, without delay.
+  inline void set_receipts(const bool receipts,
+                           const std::chrono::milliseconds &delay = std::chrono::milliseconds(0)) {
+    receipts_ = receipts;
+    receipt_delay_ = delay;
+  }
+
+  // Pushes mobile originated deliver_sm to the receivers, in turn, at rate per second. 0 pushes none.
+  void set_deliver_rate(const double rate);
+
+  // Pushes the mobile originated messages as data_sm, with the message in MESSAGE_PAYLOAD, rather than
+  // as deliver_sm.
+  inline void set_deliver_data_sm(const bool data_sm) {
+    deliver_data_sm_ = data_sm;
+  }
+
+  inline const SmscStats &stats() const {
+    return stats_;
+  }
+
+ private:
+  class Session;
+
+  void Accept();
+
+  // Takes a closed session out of the simulator.
+  void Remove(Session *session);
+
+  // Returns the session a delivery receipt for a submit on the given session should go to, or null.
+  std::shared_ptr<Session> ReceiptTarget(Session *session);
+
+  // Returns the next receiver in turn, or null if no session can receive.
+  std::shared_ptr<Session> NextReceiver();
+
+  // Returns a new message id.
+  std::string NextMessageId();
+
+  // Decides how to answer a submit_sm or submit_multi.
+  // @param count Number of PDUs of that command received so far, this one included.
+  // @return ESME_ROK, ESME_RTHROTTLED or ESME_RSYSERR for a generic_nack.
+  ESME SubmitStatus(const uint64_t count);
+
+  // Returns the delay to apply to a response.
+  std::chrono::milliseconds ResponseDelay();
+
+  // Builds a delivery receipt for an accepted submit.
+  PDU MakeReceipt(const SMS &submit, const std::string &message_id, const uint32_t seq_no);
+
+  void ArmDeliverTimer();
+  void HandleDeliverTimeout(const boost::system::error_code &error);
+
+  asio::io_context &ctx_;
+  asio::ip::tcp::acceptor acceptor_;
+  asio::ip::tcp::endpoint listen_endpoint_;
+  std::list<std::shared_ptr<Session>> sessions_;
+  size_t next_receiver_;  // Session to push the next deliver_sm to.
+  asio::steady_timer deliver_timer_;
+  std::mt19937 random_;
+
+  std::string system_id_;
+  std::string password_;
+  std::chrono::milliseconds latency_;
+  std::chrono::milliseconds jitter_;
+  unsigned int throttle_every_;
+  unsigned int max_tps_;
+  unsigned int nack_every_;
+  bool receipts_;
+  std::chrono::milliseconds receipt_delay_;
+  double deliver_rate_;
+  bool deliver_data_sm_;
+  std::chrono::steady_clock::time_point deliver_due_;  // When the next deliver_sm should be pushed.
+
+  uint64_t message_id_;
+  std::chrono::steady_clock::time_point tps_second_;  // Start of the second submits are counted in.
+  unsigned int tps_count_;  // Submits accepted in that second.
+  SmscStats stats_;
+  bool started_;
+};
+}  // namespace smpp
@@ -3,132 +3,246 @@
 // @author hd@onlinecity.dk & td@onlinecity.dk
 
 #include "smpp/timeformat.h"
-#include <complex>
-#include <cstdio>
+#include <cstdint>
 #include <string>
 
 namespace smpp {
 namespace timeformat {
 using std::string;
-using std::stoi;
-using std::regex;
-using std::smatch;
-
-std::chrono::time_point<std::chrono::system_clock> ParseDlrTimestamp(const std::string &time) {
-  const char* ts = time.c_str();
-  std::tm tm;
-  tm.tm_year = (ts[0] - '0') * 10 + (ts[1] - '0');  // years since 1900
-  if (tm.tm_year < 70) {
-    tm.tm_year += 100;
+namespace sc = std::chrono;
+
+namespace {
+// Fields of a “YYMMDDhhmmsstnnp” timestamp.
+struct Fields {
+  int yy;
+  int mon;
+  int dd;
+  int hh;
+  int min;
+  int sec;
+  int tenths;
+  int quarters;  // UTC offset in quarter hours.
+  char p;
+};
+
+inline bool IsDigit(const char c) {
+  return c >= '0' && c <= '9';
+}
+
+// Returns the number written with the two digits at s.
+inline int TwoDigits(const char *s) {
+  return (s[0] - '0') * 10 + (s[1] - '0');
+}
+
+// Writes the number as two digits at s.
+inline void PutTwoDigits(char *s, const int64_t n) {
+  s[0] = static_cast<char>('0' + n / 10);
+  s[1] = static_cast<char>('0' + n % 10);
+}
+
+[[noreturn]] void ThrowWrongFormat(std::string_view time) {
+  throw SmppException(string("Timestamp \"") + string(time) + "\" has the wrong format.");
+}
+
+// Reads the fields of a timestamp, or throws if it has the wrong format.
+Fields ReadFields(std::string_view time) {
+  if (time.size() != SMPP_TIMESTAMP_LENGTH) {
+    ThrowWrongFormat(time);
   }
-  tm.tm_mon = (ts[2] - '0') * 10 + (ts[3] - '0') - 1;  // months since january (0-11)
-  tm.tm_mday = (ts[4] - '0') * 10 + (ts[5] - '0');
-  tm.tm_hour = (ts[6] - '0') * 10 + (ts[7] - '0');
-  tm.tm_min = (ts[8] - '0') * 10 + (ts[9] - '0');
-  tm.tm_isdst = -1;  // Set to avoid garbage.
-  tm.tm_sec = 0;     // Set to avoid garbage.
-  return std::chrono::system_clock::from_time_t(std::mktime(&tm));
-}
-
-std::chrono::seconds ParseRelativeTimestamp(const smatch &match) {
-  int yy = stoi(match[1]);
-  int mon = stoi(match[2]);
-  int dd = stoi(match[3]);
-  int hh = stoi(match[4]);
-  int min = stoi(match[5]);
-  int sec = stoi(match[6]);
-  int total_hours = (yy * 365 * 24) + (mon * 30 * 24) + (dd * 24) + hh;
-  int64_t total_minutes = (total_hours * 60) + min;
-  int64_t total_seconds = (total_minutes * 60) + sec;
-  return std::chrono::seconds(total_seconds);
-}
-
-std::chrono::time_point<std::chrono::system_clock> ParseAbsoluteTimestamp(const std::smatch &match) {
-  int yy = stoi(match[1]);
-  int mon = stoi(match[2]);
-  int dd = stoi(match[3]);
-  int hh = stoi(match[4]);
-  int min = stoi(match[5]);
-  int sec = stoi(match[6]);
-  // Parse timezone offset
-  int n = stoi(match[8]);
-  int offset_hours = (n >> 2);
-  int offset_minutes = (n % 4) * 15;
-
-  struct tm tm;
-  tm.tm_year = 2000 + yy - 1900;
-  tm.tm_mon = mon - 1;
-  tm.tm_mday = dd;
-  tm.tm_hour = hh;
-  tm.tm_min = min;
-  tm.tm_sec = sec;
-  tm.tm_isdst = -1;
-
-  return std::chrono::system_clock::from_time_t(mktime(&tm));
-}
-
-ChronoDatePair ParseSmppTimestamp(const string &time) {
-  namespace sc = std::chrono;
-  // Matches the pattern “YYMMDDhhmmsstnnp”
-  static const regex pattern("^(\\d{2})(\\d{2})(\\d{2})(\\d{2})(\\d{2})(\\d{2})(\\d{1})(\\d{2})([R+-])$");
-  smatch match;
-
-  if (regex_match(time.begin(), time.end(), match, pattern)) {
-    // relative
-    if (match[match.size() - 1] == "R") {
-      // parse the relative timestamp
-      auto td = ParseRelativeTimestamp(match);
-      // Construct a absolute timestamp based on the relative timestamp
-      sc::time_point<sc::system_clock> tp = sc::system_clock::now();
-      tp += td;
-      return ChronoDatePair(tp, td);
-    } else {
-      // parse the absolute timestamp
-      sc::time_point<sc::system_clock> tp = ParseAbsoluteTimestamp(match);
-      // construct a relative timestamp based on the local clock and the absolute timestamp
-      sc::time_point<sc::system_clock> now = sc::system_clock::now();
-      auto td = sc::duration_cast<sc::seconds>(tp - now);
-      return ChronoDatePair(tp, td);
+  for (size_t i = 0; i < SMPP_TIMESTAMP_LENGTH - 1; ++i) {
+    if (!IsDigit(time[i])) {
+      ThrowWrongFormat(time);
     }
   }
-  throw smpp::SmppException(string("Timestamp \"") + time + "\" has the wrong format.");
+  char p = time[SMPP_TIMESTAMP_LENGTH - 1];
+  if (p != 'R' && p != '+' && p != '-') {
+    ThrowWrongFormat(time);
+  }
+  const char *s = time.data();
+  return Fields{TwoDigits(s), TwoDigits(s + 2), TwoDigits(s + 4), TwoDigits(s + 6), TwoDigits(s + 8),
+                TwoDigits(s + 10), s[12] - '0', TwoDigits(s + 13), p};
+}
+
+// Returns the number of days from 1970-01-01 to the date, in the proleptic Gregorian calendar.
+// See http://howardhinnant.github.io/date_algorithms.html#days_from_civil.
+constexpr int64_t DaysFromCivil(int64_t y, const int64_t m, const int64_t d) {
+  y -= m <= 2;
+  const int64_t era = (y >= 0 ? y : y - 399) / 400;
+  const int64_t yoe = y - era * 400;                                  // [0, 399]
+  const int64_t doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;  // [0, 365]
+  const int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;          // [0, 146096]
+  return era * 146097 + doe - 719468;
+}
+
+// The inverse of DaysFromCivil.
+constexpr void CivilFromDays(int64_t z, int64_t *y, int64_t *m, int64_t *d) {
+  z += 719468;
+  const int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+  const int64_t doe = z - era * 146097;                                   // [0, 146096]
+  const int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;  // [0, 399]
+  const int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);            // [0, 365]
+  const int64_t mp = (5 * doy + 2) / 153;                                 // [0, 11]
+  *d = doy - (153 * mp + 2) / 5 + 1;
+  *m = mp < 10 ? mp + 3 : mp - 9;
+  *y = yoe + era * 400 + (*m <= 2);
+}
+
+static_assert(DaysFromCivil(1970, 1, 1) == 0, "The calendar starts at the epoch of system_clock");
+static_assert(DaysFromCivil(2000, 3, 1) == 11017, "2000 is a leap year");
+
+inline sc::time_point<sc::system_clock> MakeTimePoint(const int year, const int mon, const int dd, const int hh,
+                                                      const int min, const int sec) {
+  int64_t seconds = DaysFromCivil(year, mon, dd) * 86400 + hh * 3600 + min * 60 + sec;
+  return sc::time_point<sc::system_clock>(sc::seconds(seconds));
+}
+
+inline sc::seconds RelativeSeconds(const Fields &f) {
+  int64_t total_hours = (f.yy * 365 * 24) + (f.mon * 30 * 24) + (f.dd * 24) + f.hh;
+  int64_t total_minutes = (total_hours * 60) + f.min;
+  return sc::seconds((total_minutes * 60) + f.sec);
+}
+
+inline sc::time_point<sc::system_clock> AbsoluteTimePoint(const Fields &f) {
+  // The time is local to the offset, so UTC is behind it for + and ahead of it for -.
+  sc::minutes offset(f.quarters * 15);
+  sc::time_point<sc::system_clock> tp = MakeTimePoint(2000 + f.yy, f.mon, f.dd, f.hh, f.min, f.sec)
+      + sc::milliseconds(f.tenths * 100);
+  return f.p == '-' ? tp + offset : tp - offset;
+}
+}  // namespace
+
+std::chrono::time_point<std::chrono::system_clock> ParseDlrTimestamp(std::string_view time) {
+  if (time.size() != 10 && time.size() != 12) {
+    ThrowWrongFormat(time);
+  }
+  for (const char c : time) {
+    if (!IsDigit(c)) {
+      ThrowWrongFormat(time);
+    }
+  }
+  const char* ts = time.data();
+  int year = TwoDigits(ts);
+  year += year < 70 ? 2000 : 1900;
+  int sec = time.size() >= 12 ? TwoDigits(ts + 10) : 0;
+  return MakeTimePoint(year, TwoDigits(ts + 2), TwoDigits(ts + 4), TwoDigits(ts + 6), TwoDigits(ts + 8), sec);
+}
+
+std::chrono::seconds ParseRelativeTimestamp(std::string_view time) {
+  Fields fields = ReadFields(time);
+  if (fields.p != 'R') {
+    ThrowWrongFormat(time);
+  }
+  return RelativeSeconds(fields);
+}
+
+std::chrono::time_point<std::chrono::system_clock> ParseAbsoluteTimestamp(std::string_view time) {
+  Fields fields = ReadFields(time);
+  if (fields.p == 'R') {
+    ThrowWrongFormat(time);
+  }
+  return AbsoluteTimePoint(fields);
+}
+
+ChronoDatePair ParseSmppTimestamp(std::string_view time) {
+  Fields fields = ReadFields(time);
+  // relative
+  if (fields.p == 'R') {
+    auto td = RelativeSeconds(fields);
+    // Construct a absolute timestamp based on the relative timestamp
+    sc::time_point<sc::system_clock> tp = sc::system_clock::now();
+    tp += td;
+    return ChronoDatePair(tp, td);
+  }
+  // parse the absolute timestamp
+  sc::time_point<sc::system_clock> tp = AbsoluteTimePoint(fields);
+  // construct a relative timestamp based on the local clock and the absolute timestamp
+  sc::time_point<sc::system_clock> now = sc::system_clock::now();
+  auto td = sc::duration_cast<sc::seconds>(tp - now);
+  return ChronoDatePair(tp, td);
+}
+
+size_t ToSmppTimeString(const struct tm &tm, char *buffer) {
+  //  YY  MM  DD  hh  mm  ss  t
+  PutTwoDigits(buffer, tm.tm_year % 100);
+  PutTwoDigits(buffer + 2, tm.tm_mon + 1);
+  PutTwoDigits(buffer + 4, tm.tm_mday);
+  PutTwoDigits(buffer + 6, tm.tm_hour);
+  PutTwoDigits(buffer + 8, tm.tm_min);
+  PutTwoDigits(buffer + 10, tm.tm_sec);
+  buffer[12] = '0';
+  buffer[13] = '\0';
+  return 13;
 }
 
 string ToSmppTimeString(const struct tm &tm) {
-  int yy = tm.tm_year % 100;
-  int mm = tm.tm_mon + 1;
-  int dd = tm.tm_mday;
-  int h = tm.tm_hour;
-  int m = tm.tm_min;
-  int s = tm.tm_sec;
-  char buf[17];
-  //                               YY  MM  DD  hh   mm   ss  000R
-  std::snprintf(buf, sizeof(buf), "%02i%02i%02i%02i%02i%02i0", yy, mm, dd, h, m, s);
-  return string(buf);
+  char buf[SMPP_TIMESTAMP_LENGTH + 1];
+  return string(buf, ToSmppTimeString(tm, buf));
 }
 
-string ToSmppTimeString(const std::chrono::seconds &d) {
-  namespace sc = std::chrono;
-  auto tmp(d);
-  auto h = sc::duration_cast<sc::hours>(tmp).count();
-  tmp -= sc::hours(h);
-  auto m = sc::duration_cast<sc::minutes>(tmp).count();
-  tmp -= sc::minutes(m);
-  auto s = sc::duration_cast<sc::seconds>(tmp).count();
-  int yy = h / 24 / 365;
+size_t ToSmppTimeString(const std::chrono::time_point<std::chrono::system_clock> &tp, char *buffer) {
+  int64_t ms = sc::duration_cast<sc::milliseconds>(tp.time_since_epoch()).count();
+  int64_t seconds = ms >= 0 ? ms / 1000 : (ms - 999) / 1000;
+  int64_t days = seconds >= 0 ? seconds / 86400 : (seconds - 86399) / 86400;
+  int64_t second_of_day = seconds - days * 86400;
+  int64_t y, m, d;
+  CivilFromDays(days, &y, &m, &d);
+  //  YY  MM  DD  hh  mm  ss  t nn p
+  PutTwoDigits(buffer, ((y % 100) + 100) % 100);
+  PutTwoDigits(buffer + 2, m);
+  PutTwoDigits(buffer + 4, d);
+  PutTwoDigits(buffer + 6, second_of_day / 3600);
+  PutTwoDigits(buffer + 8, second_of_day / 60 % 60);
+  PutTwoDigits(buffer + 10, second_of_day % 60);
+  buffer[12] = static_cast<char>('0' + (ms - seconds * 1000) / 100);
+  buffer[13] = '0';
+  buffer[14] = '0';
+  buffer[15] = '+';
+  buffer[16] = '\0';
+  return SMPP_TIMESTAMP_LENGTH;
+}
+
+string ToSmppTimeString(const std::chrono::time_point<std::chrono::system_clock> &tp) {
+  char buf[SMPP_TIMESTAMP_LENGTH + 1];
+  return string(buf, ToSmppTimeString(tp, buf));
+}
+
+size_t ToSmppTimeString(const std::chrono::seconds &d, char *buffer) {
+  if (d.count() < 0) {
+    throw SmppException("Time duration is negative");
+  }
+  int64_t s = d.count();
+  int64_t m = s / 60;
+  s %= 60;
+  int64_t h = m / 60;
+  m %= 60;
+  int64_t yy = h / 24 / 365;
   h -= (yy * 24 * 365);
-  int mon = h / 24 / 30;
+  int64_t mon = h / 24 / 30;
   h -= (mon * 24 * 30);
-  int dd = h / 24;
+  int64_t dd = h / 24;
   h -= (dd * 24);
   if (yy > 99) {
     throw SmppException("Time duration overflows");
   }
 
-  char buf[17];
-  //            YY  MM  DD  hh   mm   ss  000R
-  std::snprintf(buf, sizeof(buf), "%02i%02i%02i%02li%02li%02lli000R", yy, mon, dd, h, m, s);
-  return string(buf);
+  //  YY  MM  DD  hh  mm  ss  000R
+  PutTwoDigits(buffer, yy);
+  PutTwoDigits(buffer + 2, mon);
+  PutTwoDigits(buffer + 4, dd);
+  PutTwoDigits(buffer + 6, h);
+  PutTwoDigits(buffer + 8, m);
+  PutTwoDigits(buffer + 10, s);
+  buffer[12] = '0';
+  buffer[13] = '0';
+  buffer[14] = '0';
+  buffer[15] = 'R';
+  buffer[16] = '\0';
+  return SMPP_TIMESTAMP_LENGTH;
+}
+
+string ToSmppTimeString(const std::chrono::seconds &d) {
+  char buf[SMPP_TIMESTAMP_LENGTH + 1];
+  return string(buf, ToSmppTimeString(d, buf));
 }
 
 }  // namespace timeformat
@@ -5,36 +5,69 @@
 #pragma once
 
 #include <chrono>
-#include <regex>
+#include <cstddef>
+#include <ctime>
 #include <string>
+#include <string_view>
 #include <utility>
 
 #include "smpp/exceptions.h"
 
+// The timestamps are parsed and formatted with digit arithmetic and a proleptic Gregorian calendar,
+// without std::regex, mktime or the TZ state of libc, so they never allocate (save for the std::string
+// overloads) and may be used from any number of threads at once.
 namespace smpp {
 namespace timeformat {
 
+// Length of a “YYMMDDhhmmsstnnp” timestamp. Buffers passed to ToSmppTimeString hold at least one more char.
+const size_t SMPP_TIMESTAMP_LENGTH = 16;
+
 typedef std::pair<std::chrono::time_point<std::chrono::system_clock>,
         std::chrono::seconds> ChronoDatePair;
-// Parses a relative timestamp and returns it as a chrono seconds duration.
-//
-std::chrono::seconds ParseRelativeTimestamp(const std::smatch &match);
 
-// Parses an absolute timestamp and returns it as a time_point.
-std::chrono::time_point<std::chrono::system_clock> ParseAbsoluteTimestamp(const std::smatch &match);
+// Parses a relative timestamp, “YYMMDDhhmmss000R”, and returns it as a chrono seconds duration.
+// A year is taken to be 365 days and a month 30 days.
+// @throw SmppException if the timestamp has the wrong format.
+std::chrono::seconds ParseRelativeTimestamp(std::string_view time);
+
+// Parses an absolute timestamp, “YYMMDDhhmmsstnn+” or “YYMMDDhhmmsstnn-”, and returns it as a time_point.
+// The time is local to the UTC offset of nn quarter hours, which is applied.
+// @throw SmppException if the timestamp has the wrong format.
+std::chrono::time_point<std::chrono::system_clock> ParseAbsoluteTimestamp(std::string_view time);
 
 // Parses a smpp timestamp and returns a DatePair representation of the timestamp.
 // The smpp timestamp has the following format: “YYMMDDhhmmsstnnp”, an SmppException
 // thrown if the input timeformat differs.
 // @throw SmppException.
-ChronoDatePair ParseSmppTimestamp(const std::string &time);
+ChronoDatePair ParseSmppTimestamp(std::string_view time);
+
+// Parses a delivery receipt timestamp, “YYMMDDhhmm” or “YYMMDDhhmmss”, and returns it as time_point.
+// Receipts carry no UTC offset, so the time is taken to be UTC.
+// @throw SmppException if the timestamp has the wrong format.
+std::chrono::time_point<std::chrono::system_clock> ParseDlrTimestamp(std::string_view time);
 
-// Parses a delivery receipt timestamp and returns it as time_point.
-std::chrono::time_point<std::chrono::system_clock> ParseDlrTimestamp(const std::string &time);
+// Writes the struct tm formatted as an absolute timestamp, “YYMMDDhhmmss0”, without a UTC offset.
+// @param buffer Room for SMPP_TIMESTAMP_LENGTH + 1 chars, the timestamp is null terminated.
+// @return Length of the timestamp.
+size_t ToSmppTimeString(const struct tm &tm, char *buffer);
 
 // Returns the struct tm as a string formatted as an absolute timestamp
 std::string ToSmppTimeString(const struct tm &tm);
 
+// Writes the time_point formatted as an absolute timestamp in UTC, “YYMMDDhhmmsst00+”.
+// @param buffer Room for SMPP_TIMESTAMP_LENGTH + 1 chars, the timestamp is null terminated.
+// @return Length of the timestamp.
+size_t ToSmppTimeString(const std::chrono::time_point<std::chrono::system_clock> &tp, char *buffer);
+
+// Returns the time_point as a string formatted as an absolute timestamp in UTC.
+std::string ToSmppTimeString(const std::chrono::time_point<std::chrono::system_clock> &tp);
+
+// Writes a relative timestamp created from the duration, see the std::string overload.
+// @param buffer Room for SMPP_TIMESTAMP_LENGTH + 1 chars, the timestamp is null terminated.
+// @return Length of the timestamp.
+// @throw SmppException if the duration is negative or 100 years or more.
+size_t ToSmppTimeString(const std::chrono::seconds &d, char *buffer);
+
 // Returns a relative timestamp created from the time_duration. Since a time_duration does not handle
 // dates, the relative dates is calculated with the assumption of one year equals 365 days and a month is 30 days long.
 std::string ToSmppTimeString(const std::chrono::seconds &d);
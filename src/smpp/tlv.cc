@@ -0,0 +1,124 @@
+// Copyright (C) 2011-2014 OnlineCity
+// Licensed under the MIT license, which can be read at: http://www.opensource.org/licenses/mit-license.php
+// @author hd@onlinecity.dk & td@onlinecity.dk
+
+#include "smpp/tlv.h"
+#include <cstring>
+
+namespace smpp {
+TLV::TLV(const Tag &tag, const char *octets, const size_t len, std::pmr::memory_resource *memory_resource) :
+  tag_(tag),
+  len_(0),
+  memory_resource_(memory_resource) {
+  if (len > UINT16_MAX) {
+    throw SmppException("TLV value is longer than 65535 octets");
+  }
+  if (len > INLINE_OCTETS) {
+    allocated_ = static_cast<char*>(memory_resource_->allocate(len, 1));
+  }
+  len_ = static_cast<uint16_t>(len);
+  std::memcpy(len_ > INLINE_OCTETS ? allocated_ : inline_, octets, len);
+}
+
+TLV::TLV(const TLV &rhs) :
+  TLV(rhs.tag_, rhs.octets().data(), rhs.len_, rhs.memory_resource_) {
+}
+
+TLV::TLV(TLV &&rhs) noexcept :
+  tag_(rhs.tag_),
+  len_(rhs.len_),
+  memory_resource_(rhs.memory_resource_) {
+  std::memcpy(inline_, rhs.inline_, sizeof(inline_));  // Takes over an allocated value too.
+  rhs.len_ = 0;
+}
+
+TLV &TLV::operator=(const TLV &rhs) {
+  if (this != &rhs) {
+    *this = TLV(rhs);
+  }
+  return *this;
+}
+
+TLV &TLV::operator=(TLV &&rhs) noexcept {
+  if (this != &rhs) {
+    Release();
+    tag_ = rhs.tag_;
+    len_ = rhs.len_;
+    memory_resource_ = rhs.memory_resource_;
+    std::memcpy(inline_, rhs.inline_, sizeof(inline_));
+    rhs.len_ = 0;
+  }
+  return *this;
+}
+
+TLV::~TLV() {
+  Release();
+}
+
+void TLV::Release() {
+  if (len_ > INLINE_OCTETS) {
+    memory_resource_->deallocate(allocated_, len_, 1);
+  }
+  len_ = 0;
+}
+
+static_assert(TlvList::INDEXED * 2 == 16, "Slot() picks one of 16 slots");
+
+TlvList::TlvList() :
+  tlvs_(),
+  index_() {
+}
+
+TlvList::TlvList(std::initializer_list<TLV> tlvs) :
+  tlvs_(tlvs),
+  index_() {
+  for (size_t i = 0; i < tlvs_.size() && i < INDEXED; ++i) {
+    Index(i);
+  }
+}
+
+void TlvList::pop_back() {
+  tlvs_.pop_back();
+  if (tlvs_.size() < INDEXED) {
+    // Removing from an open addressed index could break the probe sequences of the others, so rebuild it.
+    index_.fill(0);
+    for (size_t i = 0; i < tlvs_.size(); ++i) {
+      Index(i);
+    }
+  }
+}
+
+void TlvList::clear() {
+  tlvs_.clear();
+  index_.fill(0);
+}
+
+const TLV *TlvList::find(const Tag &tag) const {
+  for (size_t slot = Slot(tag); index_[slot] != 0; slot = (slot + 1) % SLOTS) {
+    const TLV &tlv = tlvs_[index_[slot] - 1];
+    if (tlv.tag() == tag) {
+      return &tlv;
+    }
+  }
+  for (size_t i = INDEXED; i < tlvs_.size(); ++i) {
+    if (tlvs_[i].tag() == tag) {
+      return &tlvs_[i];
+    }
+  }
+  return nullptr;
+}
+
+void TlvList::Index(const size_t pos) {
+  if (pos >= INDEXED) {
+    return;
+  }
+  Tag tag = tlvs_[pos].tag();
+  size_t slot = Slot(tag);
+  for (; index_[slot] != 0; slot = (slot + 1) % SLOTS) {
+    if (tlvs_[index_[slot] - 1].tag() == tag) {
+      return;
+    }
+  }
+  index_[slot] = static_cast<uint8_t>(pos + 1);
+}
+}  // namespace smpp
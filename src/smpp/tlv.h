@@ -5,9 +5,18 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
+#include <cstdint>
+#include <initializer_list>
 #include <iomanip>
+#include <memory_resource>
 #include <string>
+#include <string_view>
 #include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "smpp/exceptions.h"
 
 namespace smpp {
 
@@ -60,21 +69,43 @@ enum class Tag : uint16_t {
 };
 
 // TLV container class.
+// Values of up to INLINE_OCTETS, which covers every integer parameter, are kept in the TLV itself.
+// Longer values are allocated from the memory resource given at construction, the default resource if none is.
 class TLV {
  public:
-  explicit TLV(const Tag &tag):
-    tag_(tag), len_(0), octets_() {
+  static const size_t INLINE_OCTETS = 8;
+
+  explicit TLV(const Tag &tag, std::pmr::memory_resource *memory_resource = std::pmr::get_default_resource()):
+    tag_(tag), len_(0), memory_resource_(memory_resource) {
   }
 
+  // The integer is kept in network byte order, as it goes on the wire.
   template <class Integral, class = typename std::enable_if<std::is_integral<Integral>::value >::type>
-  TLV(const Tag &tag, Integral value):
-    tag_(tag), len_(sizeof(value)), octets_(reinterpret_cast<char*>(&value), sizeof(value)) {
+  TLV(const Tag &tag, Integral value,
+      std::pmr::memory_resource *memory_resource = std::pmr::get_default_resource()):
+    tag_(tag), len_(sizeof(value)), memory_resource_(memory_resource) {
+    static_assert(sizeof(value) <= INLINE_OCTETS, "Integers are kept inline");
+    for (size_t i = 0; i < sizeof(value); ++i) {
+      inline_[i] = static_cast<char>(static_cast<uint64_t>(value) >> (8 * (sizeof(value) - 1 - i)));
+    }
   }
 
-  TLV(const Tag &tag, const std::basic_string<char> &s) :
-    tag_(tag), len_(s.length()), octets_(s) {
+  TLV(const Tag &tag, const std::basic_string<char> &s,
+      std::pmr::memory_resource *memory_resource = std::pmr::get_default_resource()) :
+    TLV(tag, s.data(), s.length(), memory_resource) {
   }
 
+  // @throw SmppException if len is over 65535 octets, which a TLV can't hold.
+  TLV(const Tag &tag, const char *octets, const size_t len,
+      std::pmr::memory_resource *memory_resource = std::pmr::get_default_resource());
+
+  // Copies rhs, allocating from the memory resource of rhs.
+  TLV(const TLV &rhs);
+  TLV(TLV &&rhs) noexcept;
+  TLV &operator=(const TLV &rhs);
+  TLV &operator=(TLV &&rhs) noexcept;
+  ~TLV();
+
   inline Tag tag() const {
     return tag_;
   }
@@ -83,13 +114,130 @@ class TLV {
     return len_;
   }
 
-  inline std::string octets() const {
-    return octets_;
+  // Returns the value without copying it.
+  inline std::string_view octets() const {
+    return std::string_view(len_ > INLINE_OCTETS ? allocated_ : inline_, len_);
+  }
+
+  // Returns the value as an unsigned integer in network byte order. A value shorter than Integral,
+  // eg. a one octet parameter read as uint16_t, is widened.
+  // @throw SmppException if the value is longer than Integral.
+  template <class Integral, class = typename std::enable_if<std::is_integral<Integral>::value >::type>
+  Integral get() const {
+    if (len_ > sizeof(Integral)) {
+      throw SmppException("TLV value is too long for the type it was read as");
+    }
+    uint64_t value = 0;
+    for (size_t i = 0; i < len_; ++i) {
+      value = value << 8 | static_cast<uint8_t>(inline_[i]);
+    }
+    return static_cast<Integral>(value);
   }
 
  private:
+  // Frees a value which isn't inline.
+  void Release();
+
   Tag tag_;
   uint16_t len_;
-  std::string octets_;
+  std::pmr::memory_resource *memory_resource_;
+  union {
+    char inline_[INLINE_OCTETS];
+    char *allocated_;
+  };
+};
+
+// Optional parameters of a PDU, kept in order in one flat array.
+// The first INDEXED parameters are found through a small open addressed index kept inline, so looking
+// a tag up takes constant time. Parameters beyond those, which are rare, are searched linearly.
+// Where a tag occurs more than once, lookups find the first.
+class TlvList {
+ public:
+  typedef std::vector<TLV>::const_iterator const_iterator;
+  typedef const_iterator iterator;
+
+  static const size_t INDEXED = 8;
+
+  TlvList();
+  TlvList(std::initializer_list<TLV> tlvs);
+
+  inline const_iterator begin() const {
+    return tlvs_.begin();
+  }
+
+  inline const_iterator end() const {
+    return tlvs_.end();
+  }
+
+  inline size_t size() const {
+    return tlvs_.size();
+  }
+
+  inline bool empty() const {
+    return tlvs_.empty();
+  }
+
+  inline const TLV &front() const {
+    return tlvs_.front();
+  }
+
+  inline const TLV &back() const {
+    return tlvs_.back();
+  }
+
+  inline void reserve(const size_t n) {
+    tlvs_.reserve(n);
+  }
+
+  inline void push_back(const TLV &tlv) {
+    tlvs_.push_back(tlv);
+    Index(tlvs_.size() - 1);
+  }
+
+  inline void push_back(TLV &&tlv) {
+    tlvs_.push_back(std::move(tlv));
+    Index(tlvs_.size() - 1);
+  }
+
+  template <class... Args>
+  inline void emplace_back(Args&&... args) {
+    tlvs_.emplace_back(std::forward<Args>(args)...);
+    Index(tlvs_.size() - 1);
+  }
+
+  void pop_back();
+  void clear();
+
+  // Returns the first parameter with the tag, or nullptr if there is none.
+  const TLV *find(const Tag &tag) const;
+
+  inline bool contains(const Tag &tag) const {
+    return find(tag) != nullptr;
+  }
+
+  // Returns the value of the first parameter with the tag as an integer, see TLV::get.
+  // @throw SmppException if there is no parameter with the tag, or its value is longer than Integral.
+  template <class Integral, class = typename std::enable_if<std::is_integral<Integral>::value >::type>
+  Integral get(const Tag &tag) const {
+    const TLV *tlv = find(tag);
+    if (tlv == nullptr) {
+      throw SmppException("No TLV with the tag");
+    }
+    return tlv->get<Integral>();
+  }
+
+ private:
+  static const size_t SLOTS = INDEXED * 2;
+
+  // Returns the slot a tag is looked for from.
+  static inline size_t Slot(const Tag &tag) {
+    return static_cast<uint32_t>(static_cast<uint16_t>(tag)) * 2654435761u >> 28;
+  }
+
+  // Adds the parameter at pos to the index, if it is among the first INDEXED and the first with its tag.
+  void Index(const size_t pos);
+
+  std::vector<TLV> tlvs_;
+  std::array<uint8_t, SLOTS> index_;  // Position + 1 of a parameter, 0 for an empty slot.
 };
 }  // namespace smpp
@@ -0,0 +1,32 @@
+//
+// Copyright (C) 2014 OnlineCity
+// Licensed under the MIT license, which can be read at: http://www.opensource.org/licenses/mit-license.php
+//
+
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+
+// Memory resource counting the allocations made from it, and those not yet freed.
+class CountingResource : public std::pmr::memory_resource {
+ public:
+  int allocations = 0;
+  int outstanding = 0;
+
+ private:
+  void *do_allocate(size_t bytes, size_t alignment) override {
+    ++allocations;
+    ++outstanding;
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+  }
+
+  void do_deallocate(void *p, size_t bytes, size_t alignment) override {
+    --outstanding;
+    std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+  }
+
+  bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+    return this == &other;
+  }
+};
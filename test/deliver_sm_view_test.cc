@@ -0,0 +1,163 @@
+//
+// Copyright (C) 2014 OnlineCity
+// Licensed under the MIT license, which can be read at: http://www.opensource.org/licenses/mit-license.php
+//
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "smpp/deliver_sm_view.h"
+#include "smpp/pdu.h"
+#include "smpp/smpp.h"
+#include "smpp/sms.h"
+#include "smpp/tlv.h"
+
+using smpp::DeliverSmView;
+using smpp::PDU;
+using smpp::SmppAddress;
+using smpp::Tag;
+using smpp::TLV;
+using std::string;
+
+namespace {
+// Returns the octets of a DELIVER_SM with a binary short message and three optional parameters.
+string MakeDeliverSm() {
+  PDU pdu(smpp::CommandId::DELIVER_SM, smpp::ESME::ROK, 42);
+  pdu << string("WAP");
+  pdu << SmppAddress("4526159917", smpp::TON::INTERNATIONAL, smpp::NPI::E164);
+  pdu << SmppAddress("1234", smpp::TON::NATIONAL, smpp::NPI::NATIONAL);
+  pdu << smpp::ESM::DELIVER_SMSC_RECEIPT;
+  pdu << 1 << 2;
+  pdu << string("") << string("000001000000000R");
+  pdu << 1 << 0 << smpp::DataCoding::BINARY << 0;
+  pdu << 5;
+  pdu.AddOctets(std::string_view("a\0b\0c", 5));
+  pdu << TLV(Tag::RECEIPTED_MESSAGE_ID, string("abc"));
+  pdu << TLV(Tag::MORE_MESSAGES_TO_SEND);
+  pdu << TLV(Tag::MESSAGE_STATE, static_cast<uint8_t>(2));
+  return string(pdu.Octets());
+}
+}  // namespace
+
+TEST(DeliverSmViewTest, Fields) {
+  string octets = MakeDeliverSm();
+  DeliverSmView view(octets);
+  EXPECT_EQ(smpp::CommandId::DELIVER_SM, view.command_id());
+  EXPECT_EQ(42u, view.sequence_no());
+  EXPECT_EQ("WAP", view.service_type());
+  EXPECT_EQ(smpp::TON::INTERNATIONAL, view.source_addr_ton());
+  EXPECT_EQ(smpp::NPI::E164, view.source_addr_npi());
+  EXPECT_EQ("4526159917", view.source_addr());
+  EXPECT_EQ(smpp::TON::NATIONAL, view.dest_addr_ton());
+  EXPECT_EQ(smpp::NPI::NATIONAL, view.dest_addr_npi());
+  EXPECT_EQ("1234", view.dest_addr());
+  EXPECT_EQ(smpp::ESM::DELIVER_SMSC_RECEIPT, view.esm_class());
+  EXPECT_EQ(1, view.protocol_id());
+  EXPECT_EQ(2, view.priority_flag());
+  EXPECT_EQ("", view.schedule_delivery_time());
+  EXPECT_EQ("000001000000000R", view.validity_period());
+  EXPECT_EQ(1, view.registered_delivery());
+  EXPECT_EQ(smpp::DataCoding::BINARY, view.data_coding());
+  EXPECT_EQ(5, view.sm_length());
+  EXPECT_EQ(std::string_view("a\0b\0c", 5), view.short_message());
+  // The view points into the PDU.
+  EXPECT_GE(view.dest_addr().data(), octets.data());
+  EXPECT_LT(view.dest_addr().data(), octets.data() + octets.size());
+}
+
+TEST(DeliverSmViewTest, Tlvs) {
+  string octets = MakeDeliverSm();
+  DeliverSmView view(octets);
+  std::vector<Tag> tags;
+  for (const smpp::TlvView &tlv : view.tlvs()) {
+    tags.push_back(tlv.tag);
+  }
+  EXPECT_EQ(std::vector<Tag>({ Tag::RECEIPTED_MESSAGE_ID, Tag::MORE_MESSAGES_TO_SEND, Tag::MESSAGE_STATE }), tags);
+
+  std::string_view value;
+  ASSERT_TRUE(view.FindTlv(Tag::RECEIPTED_MESSAGE_ID, &value));
+  EXPECT_EQ("abc", value);
+  ASSERT_TRUE(view.FindTlv(Tag::MORE_MESSAGES_TO_SEND, &value));
+  EXPECT_TRUE(value.empty());
+  ASSERT_TRUE(view.FindTlv(Tag::MESSAGE_STATE, &value));
+  EXPECT_EQ(string(1, 2), value);
+  EXPECT_FALSE(view.FindTlv(Tag::MESSAGE_PAYLOAD, &value));
+}
+
+TEST(DeliverSmViewTest, ToSms) {
+  string octets = MakeDeliverSm();
+  PDU pdu(octets.data(), octets.size());
+  smpp::SMS expected(&pdu);
+  smpp::SMS sms = DeliverSmView(octets).ToSms();
+  EXPECT_FALSE(sms.is_null);
+  EXPECT_EQ(expected.service_type, sms.service_type);
+  EXPECT_EQ(expected.source_addr, sms.source_addr);
+  EXPECT_EQ(expected.dest_addr, sms.dest_addr);
+  EXPECT_EQ(expected.dest_addr_ton, sms.dest_addr_ton);
+  EXPECT_EQ(expected.esm_class, sms.esm_class);
+  EXPECT_EQ(expected.validity_period, sms.validity_period);
+  EXPECT_EQ(expected.data_coding, sms.data_coding);
+  EXPECT_EQ(expected.short_message, sms.short_message);
+  ASSERT_EQ(expected.tlvs.size(), sms.tlvs.size());
+  auto it = expected.tlvs.begin();
+  for (const TLV &tlv : sms.tlvs) {
+    EXPECT_EQ(it->tag(), tlv.tag());
+    EXPECT_EQ(it->octets(), tlv.octets());
+    ++it;
+  }
+}
+
+TEST(DeliverSmViewTest, DataSm) {
+  PDU pdu(smpp::CommandId::DATA_SM, smpp::ESME::ROK, 7);
+  pdu << string("USSD");
+  pdu << SmppAddress("4526159917", smpp::TON::INTERNATIONAL, smpp::NPI::E164);
+  pdu << SmppAddress("1234", smpp::TON::NATIONAL, smpp::NPI::NATIONAL);
+  pdu << smpp::ESM::SUBMIT_MODE_SMSC_DEFAULT;
+  pdu << 1 << smpp::DataCoding::BINARY;
+  pdu << TLV(Tag::USER_MESSAGE_REFERENCE, static_cast<uint16_t>(7));
+  pdu << TLV(Tag::MESSAGE_PAYLOAD, string(300, 'x'));
+  string octets(pdu.Octets());
+
+  DeliverSmView view(octets);
+  EXPECT_EQ(smpp::CommandId::DATA_SM, view.command_id());
+  EXPECT_EQ("USSD", view.service_type());
+  EXPECT_EQ("1234", view.dest_addr());
+  EXPECT_EQ(smpp::NPI::NATIONAL, view.dest_addr_npi());
+  EXPECT_EQ(1, view.registered_delivery());
+  EXPECT_EQ(smpp::DataCoding::BINARY, view.data_coding());
+  EXPECT_EQ(0, view.protocol_id());
+  EXPECT_EQ("", view.validity_period());
+  EXPECT_EQ(string(300, 'x'), view.short_message());  // The message payload.
+  EXPECT_EQ(300, view.sm_length());
+
+  PDU received(octets.data(), octets.size());
+  smpp::SMS expected(&received);
+  smpp::SMS sms = view.ToSms();
+  EXPECT_EQ(smpp::CommandId::DATA_SM, sms.command_id);
+  EXPECT_EQ(expected.command_id, sms.command_id);
+  EXPECT_EQ(expected.source_addr, sms.source_addr);
+  EXPECT_EQ(expected.registered_delivery, sms.registered_delivery);
+  EXPECT_EQ(expected.data_coding, sms.data_coding);
+  EXPECT_EQ(expected.sm_length, sms.sm_length);
+  EXPECT_EQ(expected.short_message, sms.short_message);
+  EXPECT_EQ(2u, sms.tlvs.size());
+}
+
+TEST(DeliverSmViewTest, Truncated) {
+  string octets = MakeDeliverSm();
+  EXPECT_THROW(DeliverSmView(std::string_view(octets.data(), 12)), smpp::SmppException);
+  EXPECT_THROW(DeliverSmView(std::string_view(octets.data(), 20)), smpp::SmppException);
+
+  // A PDU which ends inside its short message, or an optional parameter, is viewed as far as it goes.
+  size_t end = octets.find("a") + 3;
+  DeliverSmView message(std::string_view(octets.data(), end));
+  EXPECT_EQ(std::string_view("a\0b", 3), message.short_message());
+  EXPECT_TRUE(message.tlvs().empty());
+
+  DeliverSmView tlv(std::string_view(octets.data(), octets.find("abc") + 2));
+  std::string_view value;
+  ASSERT_TRUE(tlv.FindTlv(Tag::RECEIPTED_MESSAGE_ID, &value));
+  EXPECT_EQ("ab", value);
+}
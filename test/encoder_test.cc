@@ -6,6 +6,7 @@
 #include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <string>
+#include <vector>
 #include "gtest/gtest.h"
 #include "smpp/gsmencoding.h"
 
@@ -17,3 +18,84 @@ TEST(GsmEncoder, EncodeDecode) {
   std::string o3 = smpp::encoding::GsmEncoder::EncodeUtf8(o1);
   ASSERT_EQ(i1, o3);
 }
+
+TEST(GsmEncoder, Unmappable) {
+  std::vector<size_t> unmappable;
+  std::string encoded = smpp::encoding::GsmEncoder::EncodeGsm0338("a`b\xE2\x98\x83" "c\xFF" "d€", &unmappable);
+  EXPECT_EQ("a?b?c?d\x1B\x65", encoded);
+  EXPECT_EQ(std::vector<size_t>({ 1, 3, 7 }), unmappable);
+  // A truncated sequence is replaced octet by octet.
+  unmappable.clear();
+  EXPECT_EQ("x??", smpp::encoding::GsmEncoder::EncodeGsm0338("x\xE2\x98", &unmappable));
+  EXPECT_EQ(std::vector<size_t>({ 1, 2 }), unmappable);
+}
+
+TEST(GsmEncoder, Table) {
+  // Every code of the basic and extension tables survives a round trip.
+  std::string gsm;
+  for (int code = 0; code < 0x80; ++code) {
+    if (code != 0x1B) {
+      gsm += static_cast<char>(code);
+    }
+  }
+  for (char code : std::string("\x0A\x14\x28\x29\x2F\x3C\x3D\x3E\x40\x65")) {
+    gsm += '\x1B';
+    gsm += code;
+  }
+  std::string utf8 = smpp::encoding::GsmEncoder::EncodeUtf8(gsm);
+  EXPECT_EQ(gsm, smpp::encoding::GsmEncoder::EncodeGsm0338(utf8));
+  EXPECT_EQ("¡\r\n", smpp::encoding::GsmEncoder::EncodeUtf8("\x40\r\n"));
+}
+
+TEST(GsmEncoder, PlainRuns) {
+  // Characters to translate at every offset of the runs copied as they are.
+  for (std::string c : { "@", "$", "[", "_", "`", "{", "~", "\n", "é", "€" }) {
+    std::string expected = smpp::encoding::GsmEncoder::EncodeGsm0338(c);
+    for (size_t offset = 0; offset < 70; ++offset) {
+      std::string input = std::string(offset, 'a') + c + std::string(70 - offset, 'Z');
+      std::string encoded = smpp::encoding::GsmEncoder::EncodeGsm0338(input);
+      EXPECT_EQ(std::string(offset, 'a') + expected + std::string(70 - offset, 'Z'), encoded) << offset;
+      if (c != "`") {
+        EXPECT_EQ(input, smpp::encoding::GsmEncoder::EncodeUtf8(encoded)) << offset;
+      }
+    }
+  }
+}
+
+TEST(GsmEncoder, EncodeUcs2) {
+  using smpp::encoding::GsmEncoder;
+  EXPECT_EQ(std::string("\x00" "A\x00\xE9\x04\x10\x20\xAC", 8), GsmEncoder::EncodeUcs2("Aé\xD0\x90€"));
+  // Beyond the BMP as a surrogate pair, invalid UTF-8 as U+FFFD.
+  EXPECT_EQ(std::string("\xD8\x3D\xDE\x00\xFF\xFD", 6), GsmEncoder::EncodeUcs2("\xF0\x9F\x98\x80\xC0"));
+
+  // ASCII runs of every length around the vectorized blocks.
+  for (size_t length = 0; length < 40; ++length) {
+    std::string input = std::string(length, 'x') + "Ж" + std::string(length, 'y');
+    std::string expected;
+    for (char c : std::string(length, 'x')) {
+      expected += '\0';
+      expected += c;
+    }
+    expected += "\x04\x16";
+    for (char c : std::string(length, 'y')) {
+      expected += '\0';
+      expected += c;
+    }
+    EXPECT_EQ(expected, GsmEncoder::EncodeUcs2(input)) << length;
+  }
+}
+
+TEST(GsmEncoder, EncodeSms) {
+  using smpp::encoding::GsmEncoder;
+  smpp::SmppParams params;
+  params.data_coding = smpp::DataCoding::UCS2;
+  EXPECT_EQ(GsmEncoder::EncodeGsm0338("Hello {world} €"), GsmEncoder::EncodeSms("Hello {world} €", &params));
+  EXPECT_EQ(smpp::DataCoding::DEFAULT, params.data_coding);
+
+  EXPECT_EQ(GsmEncoder::EncodeUcs2("Hello мир"), GsmEncoder::EncodeSms("Hello мир", &params));
+  EXPECT_EQ(smpp::DataCoding::UCS2, params.data_coding);
+
+  // Invalid UTF-8 alone does not call for UCS-2.
+  EXPECT_EQ("a?", GsmEncoder::EncodeSms("a\xFF", &params));
+  EXPECT_EQ(smpp::DataCoding::DEFAULT, params.data_coding);
+}
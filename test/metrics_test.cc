@@ -0,0 +1,65 @@
+//
+// Copyright (C) 2014 OnlineCity
+// Licensed under the MIT license, which can be read at: http://www.opensource.org/licenses/mit-license.php
+//
+
+#include <chrono>
+
+#include "gtest/gtest.h"
+#include "smpp/metrics.h"
+
+using smpp::HistogramSnapshot;
+using std::chrono::microseconds;
+
+TEST(MetricsTest, Buckets) {
+  EXPECT_EQ(0u, HistogramSnapshot::Bucket(0));
+  EXPECT_EQ(31u, HistogramSnapshot::Bucket(31));
+  EXPECT_EQ(32u, HistogramSnapshot::Bucket(32));
+  EXPECT_EQ(32u, HistogramSnapshot::Bucket(33));
+  EXPECT_EQ(33u, HistogramSnapshot::Bucket(34));
+  EXPECT_EQ(HistogramSnapshot::BUCKETS - 1, HistogramSnapshot::Bucket(UINT64_MAX));
+
+  // Every value lies within the limits of its bucket.
+  for (uint64_t us : { 32ull, 100ull, 1000ull, 12345ull, 1000000ull, (1ull << 32) - 1 }) {
+    size_t bucket = HistogramSnapshot::Bucket(us);
+    EXPECT_LE(us, HistogramSnapshot::BucketLimit(bucket));
+    EXPECT_GT(us, HistogramSnapshot::BucketLimit(bucket - 1));
+    EXPECT_LE(HistogramSnapshot::BucketLimit(bucket) - HistogramSnapshot::BucketLimit(bucket - 1), us / 16 + 1);
+  }
+}
+
+TEST(MetricsTest, Percentile) {
+  smpp::LatencyHistogram histogram;
+  EXPECT_EQ(0u, histogram.Snapshot().Percentile(0.5));
+  for (int us = 1; us <= 1000; ++us) {
+    histogram.Record(microseconds(us));
+  }
+  histogram.Record(microseconds(-1));
+
+  HistogramSnapshot snapshot = histogram.Snapshot();
+  EXPECT_EQ(1001u, snapshot.count);
+  EXPECT_EQ(1000u, snapshot.max);
+  EXPECT_NEAR(500, snapshot.Mean(), 1);
+  EXPECT_NEAR(500, snapshot.Percentile(0.5), 500 / 16);
+  EXPECT_NEAR(990, snapshot.Percentile(0.99), 990 / 16);
+  EXPECT_EQ(1000u, snapshot.Percentile(1));
+  EXPECT_EQ(0u, snapshot.Percentile(0));
+}
+
+TEST(MetricsTest, Responses) {
+  smpp::Metrics metrics;
+  metrics.RecordResponse(smpp::CommandId::SUBMIT_SM_RESP, smpp::ESME::ROK, microseconds(10));
+  metrics.RecordResponse(smpp::CommandId::SUBMIT_SM_RESP, smpp::ESME::RTHROTTLED, microseconds(20));
+  metrics.RecordResponse(smpp::CommandId::ENQUIRE_LINK_RESP, static_cast<smpp::ESME>(0x400), microseconds(30));
+  metrics.Add(&metrics.bytes_out, 100);
+
+  smpp::MetricsSnapshot snapshot = metrics.Snapshot();
+  EXPECT_EQ(100u, snapshot.bytes_out);
+  EXPECT_EQ(1u, snapshot.status(smpp::ESME::ROK));
+  EXPECT_EQ(1u, snapshot.status(smpp::ESME::RTHROTTLED));
+  EXPECT_EQ(1u, snapshot.statuses[smpp::MetricsSnapshot::STATUSES - 1]);
+  EXPECT_EQ(2u, snapshot.latency_of(smpp::MetricCommand::SUBMIT_SM).count);
+  EXPECT_EQ(20u, snapshot.latency_of(smpp::MetricCommand::SUBMIT_SM).max);
+  EXPECT_EQ(1u, snapshot.latency_of(smpp::MetricCommand::ENQUIRE_LINK).count);
+  EXPECT_EQ(0u, snapshot.latency_of(smpp::MetricCommand::BIND).count);
+}
@@ -0,0 +1,241 @@
+//
+// Copyright (C) 2014 OnlineCity
+// Licensed under the MIT license, which can be read at: http://www.opensource.org/licenses/mit-license.php
+//
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "smpp/commands.h"
+#include "smpp/exceptions.h"
+#include "smpp/pdu.h"
+#include "smpp/smpp.h"
+#include "smpp/sms.h"
+#include "smpp/tlv.h"
+
+using smpp::PDU;
+using smpp::SmppAddress;
+using smpp::SubmitSmBody;
+using smpp::SubmitSmSchema;
+using smpp::Tag;
+using smpp::TLV;
+using smpp::TlvList;
+using std::string;
+
+namespace {
+SubmitSmBody MakeBody(const TlvList *tlvs) {
+  SubmitSmBody body;
+  body.service_type = "WAP";
+  body.source_addr_ton = smpp::TON::INTERNATIONAL;
+  body.source_addr_npi = smpp::NPI::E164;
+  body.source_addr = "4526159917";
+  body.dest_addr_ton = smpp::TON::NATIONAL;
+  body.destination_addr = "1234";
+  body.validity_period = "000001000000000R";
+  body.data_coding = smpp::DataCoding::BINARY;
+  body.short_message = smpp::schema::OctetParts(std::string_view("a\0b", 3), "cd");
+  body.tlvs = tlvs;
+  return body;
+}
+}  // namespace
+
+TEST(PduSchemaTest, EncodedSize) {
+  TlvList tlvs = { TLV(Tag::USER_MESSAGE_REFERENCE, static_cast<uint16_t>(7)) };
+  SubmitSmBody body = MakeBody(&tlvs);
+  body.sar_segment_seqnum = 2;
+
+  PDU pdu = SubmitSmSchema::Encode(smpp::CommandId::SUBMIT_SM, 42, body);
+  EXPECT_EQ(smpp::HEADERFIELD_SIZE * 4 + SubmitSmSchema::EncodedSize(body), pdu.Octets().size());
+
+  // The same octets as a PDU written field by field.
+  PDU expected(smpp::CommandId::SUBMIT_SM, smpp::ESME::ROK, 42);
+  expected << string("WAP");
+  expected << SmppAddress("4526159917", smpp::TON::INTERNATIONAL, smpp::NPI::E164);
+  expected << SmppAddress("1234", smpp::TON::NATIONAL, smpp::NPI::UNKNOWN);
+  expected << 0 << 0 << 0;
+  expected << string("") << string("000001000000000R");
+  expected << 0 << 0 << smpp::DataCoding::BINARY << 0;
+  expected << 5;
+  expected.AddOctets(std::string_view("a\0bcd", 5));
+  expected << TLV(Tag::USER_MESSAGE_REFERENCE, static_cast<uint16_t>(7));
+  expected << TLV(Tag::SAR_SEGMENT_SEQNUM, static_cast<uint8_t>(2));
+  EXPECT_EQ(expected.Octets(), pdu.Octets());
+}
+
+TEST(PduSchemaTest, Validate) {
+  SubmitSmBody body = MakeBody(nullptr);
+  EXPECT_NO_THROW(SubmitSmSchema::Validate(body));
+
+  string addr(21, '1');
+  body.source_addr = addr;  // One more than 20 octets and the null terminator.
+  EXPECT_THROW(SubmitSmSchema::Encode(smpp::CommandId::SUBMIT_SM, 1, body), smpp::SmppException);
+  EXPECT_THROW(SubmitSmSchema::Validate(body), smpp::FieldLengthException);
+  // A rejected body takes no sequence number.
+  uint32_t seq_no = 0;
+  auto next_seq_no = [&seq_no] { return ++seq_no; };
+  EXPECT_THROW(SubmitSmSchema::Encode(smpp::CommandId::SUBMIT_SM, next_seq_no, body), smpp::SmppException);
+  EXPECT_EQ(0u, seq_no);
+  body.source_addr = std::string_view(addr.data(), 20);
+  EXPECT_NO_THROW(SubmitSmSchema::Validate(body));
+  EXPECT_EQ(1u, SubmitSmSchema::Encode(smpp::CommandId::SUBMIT_SM, next_seq_no, body).sequence_no());
+
+  string message(255, 'x');
+  body.short_message = std::string_view(message);
+  EXPECT_THROW(SubmitSmSchema::Validate(body), smpp::SmppException);
+  body.short_message = smpp::schema::OctetParts();
+  body.message_payload = std::string_view(message);  // Longer messages go in the payload.
+  EXPECT_NO_THROW(SubmitSmSchema::Validate(body));
+}
+
+TEST(PduSchemaTest, Decode) {
+  TlvList tlvs = { TLV(Tag::RECEIPTED_MESSAGE_ID, string("abc")), TLV(Tag::MORE_MESSAGES_TO_SEND) };
+  SubmitSmBody body = MakeBody(&tlvs);
+  body.esm_class = smpp::ESM::DELIVER_SMSC_RECEIPT;
+  PDU pdu = SubmitSmSchema::Encode(smpp::CommandId::DELIVER_SM, 1, body);
+  PDU received(pdu.Octets().data(), pdu.Octets().size());
+
+  smpp::SMS sms(&received);
+  EXPECT_EQ("WAP", sms.service_type);
+  EXPECT_EQ(smpp::TON::INTERNATIONAL, sms.source_addr_ton);
+  EXPECT_EQ(smpp::NPI::E164, sms.source_addr_npi);
+  EXPECT_EQ("4526159917", sms.source_addr);
+  EXPECT_EQ(smpp::TON::NATIONAL, sms.dest_addr_ton);
+  EXPECT_EQ("1234", sms.dest_addr);
+  EXPECT_EQ(smpp::ESM::DELIVER_SMSC_RECEIPT, sms.esm_class);
+  EXPECT_EQ("000001000000000R", sms.validity_period);
+  EXPECT_EQ(smpp::DataCoding::BINARY, sms.data_coding);
+  EXPECT_EQ(5, sms.sm_length);
+  EXPECT_EQ(string("a\0bcd", 5), sms.short_message);
+  ASSERT_EQ(2u, sms.tlvs.size());
+  EXPECT_EQ("abc", sms.tlvs.front().octets());
+  EXPECT_EQ(Tag::MORE_MESSAGES_TO_SEND, sms.tlvs.back().tag());
+}
+
+TEST(PduSchemaTest, QuerySmResp) {
+  PDU pdu(smpp::CommandId::QUERY_SM_RESP, smpp::ESME::ROK, 1);
+  pdu << string("msgid") << string("") << 2 << 0;
+  PDU received(pdu.Octets().data(), pdu.Octets().size());
+
+  smpp::QuerySmRespBody body;
+  smpp::QuerySmRespSchema::Decode(&received, &body);
+  EXPECT_EQ("msgid", body.message_id);
+  EXPECT_EQ("", body.final_date);
+  EXPECT_EQ(2, body.message_state);
+  EXPECT_EQ(0, body.error_code);
+
+  // A response cut short before its integers.
+  PDU truncated(pdu.Octets().data(), pdu.Octets().size() - 2);
+  EXPECT_THROW(smpp::QuerySmRespSchema::Decode(&truncated, &body), smpp::SmppException);
+}
+
+TEST(PduSchemaTest, SubmitMulti) {
+  std::vector<smpp::DestAddress> dests = {
+    smpp::DestAddress(SmppAddress("4513371337", smpp::TON::INTERNATIONAL, smpp::NPI::E164)),
+    smpp::DestAddress(string("friends"))
+  };
+  smpp::SubmitMultiBody body;
+  body.source_addr = "CPPSMPP";
+  body.dest_addresses.data = dests.data();
+  body.dest_addresses.size = dests.size();
+  body.short_message = std::string_view("hello");
+  PDU pdu = smpp::SubmitMultiSchema::Encode(smpp::CommandId::SUBMIT_MULTI, 1, body);
+  EXPECT_EQ(smpp::HEADERFIELD_SIZE * 4 + smpp::SubmitMultiSchema::EncodedSize(body), pdu.Octets().size());
+
+  PDU received(pdu.Octets().data(), pdu.Octets().size());
+  string service_type;
+  string source_addr;
+  int ton;
+  int npi;
+  received >> service_type >> ton >> npi >> source_addr;
+  std::vector<smpp::DestAddress> decoded;
+  smpp::schema::DestAddresses::Get(&received, &decoded);
+  ASSERT_EQ(2u, decoded.size());
+  EXPECT_EQ(smpp::DestFlag::DEST_FLAG_SME, decoded[0].dest_flag);
+  EXPECT_EQ(smpp::TON::INTERNATIONAL, decoded[0].address.ton);
+  EXPECT_EQ(smpp::NPI::E164, decoded[0].address.npi);
+  EXPECT_EQ("4513371337", decoded[0].address.value);
+  EXPECT_EQ(smpp::DestFlag::DEST_FLAG_DISTLIST, decoded[1].dest_flag);
+  EXPECT_EQ("friends", decoded[1].address.value);
+
+  // From 1 to 255 destinations.
+  body.dest_addresses.size = 0;
+  EXPECT_THROW(smpp::SubmitMultiSchema::Validate(body), smpp::SmppException);
+  std::vector<smpp::DestAddress> many(256, dests[0]);
+  body.dest_addresses.data = many.data();
+  body.dest_addresses.size = many.size();
+  EXPECT_THROW(smpp::SubmitMultiSchema::Validate(body), smpp::SmppException);
+  body.dest_addresses.size = 255;
+  EXPECT_NO_THROW(smpp::SubmitMultiSchema::Validate(body));
+}
+
+TEST(PduSchemaTest, SubmitMultiResp) {
+  smpp::SubmitMultiRespBody body;
+  body.message_id = "msgid";
+  body.unsuccess_smes.push_back({ SmppAddress("4513371337", smpp::TON::INTERNATIONAL, smpp::NPI::E164),
+                                  smpp::ESME::RINVDSTADR });
+  body.unsuccess_smes.push_back({ SmppAddress("friends"), smpp::ESME::RINVDLNAME });
+  PDU pdu = smpp::SubmitMultiRespSchema::Encode(smpp::CommandId::SUBMIT_MULTI_RESP, 1, body);
+  PDU received(pdu.Octets().data(), pdu.Octets().size());
+
+  smpp::SubmitMultiRespBody decoded;
+  smpp::SubmitMultiRespSchema::Decode(&received, &decoded);
+  EXPECT_EQ("msgid", decoded.message_id);
+  ASSERT_EQ(2u, decoded.unsuccess_smes.size());
+  EXPECT_EQ("4513371337", decoded.unsuccess_smes[0].address.value);
+  EXPECT_EQ(smpp::TON::INTERNATIONAL, decoded.unsuccess_smes[0].address.ton);
+  EXPECT_EQ(smpp::ESME::RINVDSTADR, decoded.unsuccess_smes[0].error_status_code);
+  EXPECT_EQ("friends", decoded.unsuccess_smes[1].address.value);
+  EXPECT_EQ(smpp::ESME::RINVDLNAME, decoded.unsuccess_smes[1].error_status_code);
+  EXPECT_FALSE(received.HasMoreData());
+}
+
+TEST(PduSchemaTest, DataSm) {
+  TlvList tlvs = { TLV(Tag::USER_MESSAGE_REFERENCE, static_cast<uint16_t>(7)) };
+  string payload(1000, 'x');
+  string dest(64, '1');  // Longer than submit_sm allows.
+  smpp::DataSmBody body;
+  body.service_type = "USSD";
+  body.source_addr_ton = smpp::TON::INTERNATIONAL;
+  body.source_addr = "4526159917";
+  body.destination_addr = dest;
+  body.registered_delivery = smpp::RegisteredDelivery::DELIVERY_SMSC_BOTH;
+  body.message_payload = std::string_view(payload);
+  body.tlvs = &tlvs;
+  PDU pdu = smpp::DataSmSchema::Encode(smpp::CommandId::DATA_SM, 1, body);
+  EXPECT_EQ(smpp::HEADERFIELD_SIZE * 4 + smpp::DataSmSchema::EncodedSize(body), pdu.Octets().size());
+
+  // Read as an inbound data_sm, the payload is the short message.
+  PDU received(pdu.Octets().data(), pdu.Octets().size());
+  smpp::SMS sms(&received);
+  EXPECT_EQ(smpp::CommandId::DATA_SM, sms.command_id);
+  EXPECT_EQ("USSD", sms.service_type);
+  EXPECT_EQ(smpp::TON::INTERNATIONAL, sms.source_addr_ton);
+  EXPECT_EQ("4526159917", sms.source_addr);
+  EXPECT_EQ(dest, sms.dest_addr);
+  EXPECT_EQ(static_cast<int>(smpp::RegisteredDelivery::DELIVERY_SMSC_BOTH), sms.registered_delivery);
+  EXPECT_EQ(payload, sms.short_message);
+  EXPECT_EQ(1000, sms.sm_length);
+  ASSERT_EQ(2u, sms.tlvs.size());
+  EXPECT_EQ(7, sms.tlvs.get<uint16_t>(Tag::USER_MESSAGE_REFERENCE));
+
+  string addr(65, '1');
+  body.destination_addr = addr;
+  EXPECT_THROW(smpp::DataSmSchema::Validate(body), smpp::SmppException);
+}
+
+TEST(PduSchemaTest, DataSmResp) {
+  PDU pdu(smpp::CommandId::DATA_SM_RESP, smpp::ESME::RDELIVERYFAILURE, 1);
+  pdu << string("");
+  pdu << TLV(Tag::DELIVERY_FAILURE_REASON, static_cast<uint8_t>(1));
+  pdu << TLV(Tag::NETWORK_ERROR_CODE, string("\x03\x00\x01", 3));
+  PDU received(pdu.Octets().data(), pdu.Octets().size());
+
+  smpp::DataSmRespBody body;
+  smpp::DataSmRespSchema::Decode(&received, &body);
+  EXPECT_EQ("", body.message_id);
+  EXPECT_EQ(1, body.tlvs.get<uint8_t>(Tag::DELIVERY_FAILURE_REASON));
+  ASSERT_TRUE(body.tlvs.contains(Tag::NETWORK_ERROR_CODE));
+  EXPECT_EQ(string("\x03\x00\x01", 3), body.tlvs.find(Tag::NETWORK_ERROR_CODE)->octets());
+}
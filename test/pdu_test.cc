@@ -7,9 +7,14 @@
 #include <glog/logging.h>
 
 #include <algorithm>
+#include <memory_resource>
 #include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
 
 #include "gtest/gtest.h"
+#include "counting_resource.h"
 #include "smpp/pdu.h"
 
 TEST(PduTest, readWrite) {
@@ -38,6 +43,76 @@ TEST(PduTest, readWrite) {
   EXPECT_EQ(o8, i8);
 }
 
+TEST(PduTest, move) {
+  smpp::PDU pdu(smpp::CommandId::SUBMIT_SM_RESP, smpp::ESME::ROK, 7);
+  pdu << std::string("id");
+  pdu << uint32_t(0xdeadbeef);
+  pdu.ResetMarker();
+  std::string s;
+  pdu >> s;
+  smpp::PDU moved(std::move(pdu));
+  EXPECT_EQ(moved.command_id(), smpp::CommandId::SUBMIT_SM_RESP);
+  EXPECT_EQ(moved.sequence_no(), uint32_t(7));
+  uint32_t o32;
+  moved >> o32;  // continues from the read marker of the moved-from PDU
+  EXPECT_EQ(o32, uint32_t(0xdeadbeef));
+  EXPECT_EQ(moved.Size(), 16 + 3 + 4);
+  static_assert(std::is_nothrow_move_constructible<smpp::PDU>::value, "vectors of PDUs should move them");
+
+  smpp::PDU assigned;
+  assigned = std::move(moved);
+  EXPECT_EQ(assigned.sequence_no(), uint32_t(7));
+  EXPECT_EQ(moved.Size(), 0);  // NOLINT(bugprone-use-after-move)
+
+  smpp::PDU copied;
+  copied = assigned;
+  EXPECT_FALSE(copied.null());
+  std::string id;
+  copied >> id;  // reads from the start of the body
+  EXPECT_EQ(id, "id");
+  EXPECT_EQ(copied.GetOctets(), assigned.GetOctets());
+}
+
+TEST(PduTest, octets) {
+  smpp::PDU pdu(smpp::CommandId::ENQUIRE_LINK, smpp::ESME::ROK, 0x01020304);
+  pdu << uint16_t(0xbeef);
+  std::string_view octets = pdu.Octets();
+  const uint8_t expected[] = {
+    0x00, 0x00, 0x00, 0x12, 0x00, 0x00, 0x00, 0x15,
+    0x00, 0x00, 0x00, 0x00, 0x01, 0x02, 0x03, 0x04,
+    0xbe, 0xef };
+  ASSERT_EQ(octets.size(), sizeof(expected));
+  EXPECT_TRUE(std::equal(octets.begin(), octets.end(), reinterpret_cast<const char*>(expected)));
+  EXPECT_EQ(pdu.GetOctets(), std::string(octets));
+}
+
+TEST(PduTest, framed) {
+  smpp::PDU out(smpp::CommandId::SUBMIT_SM_RESP, smpp::ESME::RTHROTTLED, 42);
+  out << std::string("msgid");
+  std::string_view octets = out.Octets();
+  smpp::PDU in(octets.data(), octets.size());
+  EXPECT_EQ(in.command_id(), smpp::CommandId::SUBMIT_SM_RESP);
+  EXPECT_EQ(in.command_status(), smpp::ESME::RTHROTTLED);
+  EXPECT_EQ(in.sequence_no(), uint32_t(42));
+  std::string s;
+  in >> s;
+  EXPECT_EQ(s, "msgid");
+  EXPECT_THROW(smpp::PDU(octets.data(), 8), smpp::SmppException);
+}
+
+TEST(PduTest, readPastEnd) {
+  smpp::PDU pdu(smpp::CommandId::ENQUIRE_LINK, smpp::ESME::ROK, 1);
+  pdu << uint8_t(1);
+  pdu.ResetMarker();
+  uint16_t o16;
+  EXPECT_THROW(pdu >> o16, smpp::SmppException);
+  EXPECT_THROW(pdu.Skip(2), smpp::SmppException);
+  uint8_t o8;
+  pdu >> o8;
+  EXPECT_EQ(o8, 1);
+  EXPECT_FALSE(pdu.HasMoreData());
+}
+
 TEST(PduTest, binary) {
   uint8_t testheader[] = { 0x00, 0x00, 0x00, 0x1c };
   uint8_t testdata[] = {
@@ -77,3 +152,17 @@ TEST(PduTest, enumTest) {
   ASSERT_EQ(npi, smpp::NPI::E164);
 }
 
+TEST(PduTest, memoryResource) {
+  CountingResource resource;
+  smpp::PDU pdu(smpp::CommandId::SUBMIT_SM, smpp::ESME::ROK, 1, &resource);
+  pdu << std::string(300, 'x');
+  pdu << smpp::TLV(smpp::Tag::MESSAGE_PAYLOAD, std::string(100, 'y'), &resource);
+  EXPECT_GT(resource.allocations, 1);  // the TLV and the PDU, which has grown
+
+  int allocations = resource.allocations;
+  smpp::PDU copy(pdu);
+  EXPECT_EQ(resource.allocations, allocations + 1);
+  smpp::PDU moved(std::move(copy));
+  EXPECT_EQ(resource.allocations, allocations + 1);
+  EXPECT_EQ(moved.GetOctets(), pdu.GetOctets());
+}
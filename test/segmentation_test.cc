@@ -0,0 +1,87 @@
+//
+// Copyright (C) 2014 OnlineCity
+// Licensed under the MIT license, which can be read at: http://www.opensource.org/licenses/mit-license.php
+//
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "smpp/exceptions.h"
+#include "smpp/segmentation.h"
+#include "smpp/smppclient.h"
+
+using smpp::DataCoding;
+using smpp::Segment;
+using smpp::SplitSegments;
+
+namespace {
+std::vector<size_t> Lengths(const std::vector<Segment> &segments) {
+  std::vector<size_t> lengths;
+  size_t offset = 0;
+  for (const Segment &segment : segments) {
+    EXPECT_EQ(offset, segment.offset);
+    offset += segment.length;
+    lengths.push_back(segment.length);
+  }
+  return lengths;
+}
+}  // namespace
+
+TEST(SegmentationTest, SegmentSize) {
+  EXPECT_EQ(160u, smpp::SegmentSize(DataCoding::DEFAULT, 0));
+  EXPECT_EQ(153u, smpp::SegmentSize(DataCoding::DEFAULT, smpp::UDH_8BIT_REF_OCTETS));
+  EXPECT_EQ(152u, smpp::SegmentSize(DataCoding::DEFAULT, smpp::UDH_16BIT_REF_OCTETS));
+  EXPECT_EQ(140u, smpp::SegmentSize(DataCoding::UCS2, 0));
+  EXPECT_EQ(134u, smpp::SegmentSize(DataCoding::UCS2, smpp::UDH_8BIT_REF_OCTETS));
+  EXPECT_EQ(132u, smpp::SegmentSize(DataCoding::UCS2, smpp::UDH_16BIT_REF_OCTETS));
+  EXPECT_EQ(133u, smpp::SegmentSize(DataCoding::BINARY, smpp::UDH_16BIT_REF_OCTETS));
+}
+
+TEST(SegmentationTest, Gsm0338) {
+  std::string message(400, 'a');
+  EXPECT_EQ(std::vector<size_t>({ 153, 153, 94 }), Lengths(SplitSegments(message, DataCoding::DEFAULT, 153)));
+
+  // An escape sequence across the boundary moves to the next segment.
+  message[152] = '\x1B';
+  EXPECT_EQ(std::vector<size_t>({ 152, 153, 95 }), Lengths(SplitSegments(message, DataCoding::DEFAULT, 153)));
+
+  // A whole escape sequence at the end of the segment stays.
+  message[151] = '\x1B';
+  EXPECT_EQ(std::vector<size_t>({ 153, 153, 94 }), Lengths(SplitSegments(message, DataCoding::DEFAULT, 153)));
+
+  // Binary messages are split anywhere.
+  message[151] = 'a';
+  EXPECT_EQ(std::vector<size_t>({ 153, 153, 94 }), Lengths(SplitSegments(message, DataCoding::BINARY, 153)));
+
+  EXPECT_TRUE(SplitSegments("", DataCoding::DEFAULT, 153).empty());
+}
+
+TEST(SegmentationTest, Ucs2) {
+  std::string message;
+  for (int i = 0; i < 140; ++i) {
+    message += std::string("\x04\x1B", 2);
+  }
+  EXPECT_EQ(std::vector<size_t>({ 132, 132, 16 }), Lengths(SplitSegments(message, DataCoding::UCS2, 132)));
+  // An odd segment size doesn't split a character.
+  EXPECT_EQ(std::vector<size_t>({ 132, 132, 16 }), Lengths(SplitSegments(message, DataCoding::UCS2, 133)));
+
+  // A surrogate pair across the boundary moves to the next segment.
+  message.replace(130, 4, "\xD8\x3D\xDE\x00", 4);
+  std::vector<Segment> segments = SplitSegments(message, DataCoding::UCS2, 132);
+  EXPECT_EQ(std::vector<size_t>({ 130, 132, 18 }), Lengths(segments));
+  EXPECT_EQ(std::string("\xD8\x3D\xDE\x00", 4), segments[1].of(message).substr(0, 4));
+}
+
+// A segment must hold at least one whole character, or splitting would never end.
+TEST(SegmentationTest, TooSmall) {
+  EXPECT_THROW(SplitSegments("message", DataCoding::DEFAULT, 0), smpp::SmppException);
+  EXPECT_THROW(SplitSegments("message", DataCoding::DEFAULT, 1), smpp::SmppException);
+  EXPECT_EQ(std::vector<size_t>({ 2, 2, 2, 1 }), Lengths(SplitSegments("message", DataCoding::DEFAULT, 2)));
+  EXPECT_THROW(SplitSegments(std::string("\x00m", 2), DataCoding::UCS2, 1), smpp::SmppException);
+  EXPECT_THROW(SplitSegments(std::string("\x00m", 2), DataCoding::UCS2, 3), smpp::SmppException);
+  EXPECT_EQ(1u, SplitSegments(std::string("\x00m", 2), DataCoding::UCS2, 4).size());
+  EXPECT_THROW(SplitSegments("message", DataCoding::BINARY, 0), smpp::SmppException);
+  EXPECT_EQ(7u, SplitSegments("message", DataCoding::BINARY, 1).size());
+  EXPECT_THROW(smpp::SmppClient::Split("message", 0), smpp::SmppException);
+}
@@ -0,0 +1,81 @@
+//
+// Copyright (C) 2014 OnlineCity
+// Licensed under the MIT license, which can be read at: http://www.opensource.org/licenses/mit-license.php
+//
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/asio.hpp>
+namespace asio = boost::asio;
+
+#include "gtest/gtest.h"
+#include "smpp/gsmencoding.h"
+#include "smpp/session_pool.h"
+#include "./test_flags.h"
+
+using smpp::encoding::GsmEncoder;
+using smpp::SessionPool;
+using smpp::SmppAddress;
+using std::string;
+
+class SessionPoolTest : public testing::Test {
+ public:
+  asio::io_context ios_;
+  SessionPool pool_;
+  SmppAddress sender_;
+  SmppAddress receiver_;
+
+  SessionPoolTest() :
+    ios_(),
+    pool_(ios_, asio::ip::tcp::endpoint(asio::ip::address_v4::from_string(FLAGS_host), FLAGS_port), 3),
+    sender_(FLAGS_sender, smpp::TON::ALPHANUMERIC, smpp::NPI::UNKNOWN),
+    receiver_(FLAGS_receiver, smpp::TON::INTERNATIONAL, smpp::NPI::E164) {
+  }
+};
+
+TEST_F(SessionPoolTest, Bind) {
+  EXPECT_EQ(pool_.Bind(FLAGS_username, FLAGS_password), 3u);
+  EXPECT_EQ(pool_.available(), 3u);
+  for (size_t i = 0; i < pool_.size(); ++i) {
+    EXPECT_TRUE(pool_.session(i).IsBound());
+  }
+  auto r = pool_.SendSms(sender_, receiver_, GsmEncoder::EncodeGsm0338("message to send"));
+  EXPECT_FALSE(r.first.empty());
+  pool_.Unbind();
+  EXPECT_EQ(pool_.available(), 0u);
+}
+
+// Sends are spread evenly across the sessions
+TEST_F(SessionPoolTest, LeastLoaded) {
+  pool_.Bind(FLAGS_username, FLAGS_password);
+  std::vector<boost::system::error_code> errors;
+  string message = GsmEncoder::EncodeGsm0338("message to send");
+
+  for (int i = 0; i < 30; ++i) {
+    pool_.SendSmsAsync(sender_, receiver_, message,
+                       [&errors](boost::system::error_code ec, std::pair<string, int>) {
+      errors.push_back(ec);
+    });
+  }
+
+  for (size_t i = 0; i < pool_.size(); ++i) {
+    EXPECT_EQ(pool_.session(i).pending(), 10u);
+  }
+
+  while (errors.size() < 30) {
+    ios_.run_one();
+  }
+  for (auto &ec : errors) {
+    EXPECT_FALSE(ec);
+  }
+  pool_.Unbind();
+}
+
+TEST_F(SessionPoolTest, NotBound) {
+  EXPECT_THROW(pool_.SendSms(sender_, receiver_, "message to send"), smpp::TransportException);
+}
@@ -66,3 +66,20 @@ TEST_F(SmppClientTest, ReceiveSms) {
   smpp::SMS sms = client_->ReadSms();
 }
 
+
+// Test sending and receiving over a single transceiver bind
+TEST_F(SmppClientTest, Transceiver) {
+  socket_->connect(endpoint_);
+  client_->BindTransceiver(FLAGS_username, FLAGS_password);
+  ASSERT_TRUE(client_->CanTransmit());
+  ASSERT_TRUE(client_->CanReceive());
+  SmppAddress from("CPPSMPP", smpp::TON::ALPHANUMERIC, smpp::NPI::UNKNOWN);
+  SmppAddress to("4513371337", smpp::TON::INTERNATIONAL, smpp::NPI::E164);
+  auto result = client_->SendSms(from, to, GsmEncoder::EncodeGsm0338("message to send"));
+  EXPECT_FALSE(result.first.empty());
+  LOG(INFO) << "Waiting for smpp connection to send message";
+  smpp::SMS sms = client_->ReadSms();
+  EXPECT_FALSE(sms.is_null);
+  client_->Unbind();
+  socket_->close();
+}
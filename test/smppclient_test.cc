@@ -6,10 +6,14 @@
 #include <gflags/gflags.h>
 #include <glog/logging.h>
 
+#include <chrono>
 #include <ctime>
-#include <list>
+#include <future>
+#include <memory_resource>
 #include <string>
 #include <tuple>
+#include <utility>
+#include <vector>
 
 #include "./smppclient_test.h"
 
@@ -25,7 +29,6 @@ using smpp::encoding::GsmEncoder;
 using smpp::SmppAddress;
 using smpp::SmppClient;
 using smpp::TLV;
-using std::list;
 using std::string;
 
 //  Test login
@@ -57,6 +60,32 @@ TEST_F(SmppClientTest, submit) {
   socket_->close();
 }
 
+// Submits beyond the burst are held back to the throttle rate
+TEST_F(SmppClientTest, throttle) {
+  socket_->connect(endpoint_);
+  client_->BindTransmitter(FLAGS_username, FLAGS_password);
+  client_->set_throttle(50, 5);
+  EXPECT_EQ(50, client_->throttle_tps());
+  SmppAddress from("CPPSMPP", smpp::TON::ALPHANUMERIC, smpp::NPI::UNKNOWN);
+  SmppAddress to("4513371337", smpp::TON::INTERNATIONAL, smpp::NPI::E164);
+  int accepted = 0;
+
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < 25; ++i) {
+    client_->SendSmsWindowed(from, to, GsmEncoder::EncodeGsm0338("message to send"), smpp::SmppParams(),
+                             smpp::TlvList(), [&accepted](const smpp::SubmitSmResult &result) {
+      accepted += result.command_status == smpp::ESME::ROK;
+    });
+  }
+  client_->FlushWindow();
+
+  // 5 go out right away, the other 20 at 50 per second.
+  EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(380));
+  EXPECT_EQ(25, accepted);
+  client_->Unbind();
+  socket_->close();
+}
+
 // Test QUERY_SM feature to pull for a message status
 TEST_F(SmppClientTest, querySm) {
   socket_->connect(endpoint_);
@@ -80,7 +109,7 @@ TEST_F(SmppClientTest, tlv) {
   SmppAddress to("4513371337", smpp::TON::INTERNATIONAL, smpp::NPI::E164);
   string message = "message to send";
   struct smpp::SmppParams params;
-  list<TLV> taglist;
+  smpp::TlvList taglist;
   taglist.push_back(TLV(smpp::Tag::DEST_ADDR_SUBUNIT,
                         static_cast<uint8_t>(0x01)));  // "flash sms" use-case
   taglist.push_back(TLV(smpp::Tag::USER_MESSAGE_REFERENCE, static_cast<uint16_t>(0x1337)));
@@ -103,7 +132,7 @@ TEST_F(SmppClientTest, tlvExtended) {
   }
 
   struct smpp::SmppParams params;
-  list<TLV> taglist;
+  smpp::TlvList taglist;
   taglist.push_back(TLV(smpp::Tag::DEST_ADDR_SUBUNIT, static_cast<uint8_t>(0x01)));
   taglist.push_back(TLV(smpp::Tag::USER_MESSAGE_REFERENCE, static_cast<uint16_t>(0x1337)));
   int csms_method = client_->csms_method();
@@ -132,7 +161,7 @@ TEST_F(SmppClientTest, submitExtended) {
   params.validity_period = smpp::timeformat::ToSmppTimeString(std::chrono::hours(1));  // valid for one hour
   params.data_coding = smpp::DataCoding::ISO8859_1;
 
-  list<TLV> tags;
+  smpp::TlvList tags;
   tags.push_back(TLV(smpp::Tag::DEST_ADDR_SUBUNIT,
                         static_cast<uint8_t>(0x01)));  // "flash sms" use-case
   tags.push_back(TLV(smpp::Tag::USER_MESSAGE_REFERENCE, static_cast<uint16_t>(0x1337)));
@@ -150,6 +179,65 @@ TEST_F(SmppClientTest, logging) {
   socket_->close();
 }
 
+// Test the asynchronous API with callbacks, driven by running the io_context
+TEST_F(SmppClientTest, async) {
+  socket_->connect(endpoint_);
+  SmppAddress from("CPPSMPP", smpp::TON::ALPHANUMERIC, smpp::NPI::UNKNOWN);
+  SmppAddress to("4513371337", smpp::TON::INTERNATIONAL, smpp::NPI::E164);
+  string message = GsmEncoder::EncodeGsm0338("message to send");
+  boost::system::error_code bind_error, send_error, unbind_error;
+  std::pair<string, int> result;
+
+  client_->BindTransmitterAsync(FLAGS_username, FLAGS_password, [&](boost::system::error_code ec) {
+    bind_error = ec;
+    client_->SendSmsAsync(from, to, message, [&](boost::system::error_code ec, std::pair<string, int> r) {
+      send_error = ec;
+      result = r;
+      client_->UnbindAsync([&](boost::system::error_code ec) {
+        unbind_error = ec;
+      });
+    });
+  });
+  ios_.run();
+
+  EXPECT_FALSE(bind_error);
+  EXPECT_FALSE(send_error);
+  EXPECT_FALSE(result.first.empty());
+  EXPECT_EQ(result.second, 1);
+  EXPECT_FALSE(unbind_error);
+  EXPECT_FALSE(client_->IsBound());
+  socket_->close();
+}
+
+// Test a client allocating from a memory resource of its own
+TEST_F(SmppClientTest, memoryResource) {
+  std::pmr::unsynchronized_pool_resource pool;
+  socket_->connect(endpoint_);
+  {
+    SmppClient client(socket_, ios_, &pool);
+    client.BindTransmitter(FLAGS_username, FLAGS_password);
+    SmppAddress from("CPPSMPP", smpp::TON::ALPHANUMERIC, smpp::NPI::UNKNOWN);
+    SmppAddress to("4513371337", smpp::TON::INTERNATIONAL, smpp::NPI::E164);
+    auto result = client.SendSms(from, to, GsmEncoder::EncodeGsm0338("message to send"));
+    EXPECT_FALSE(result.first.empty());
+    client.Unbind();
+  }
+  socket_->close();
+}
+
+// Test the asynchronous API with futures
+TEST_F(SmppClientTest, asyncFuture) {
+  socket_->connect(endpoint_);
+  client_->BindTransmitter(FLAGS_username, FLAGS_password);
+  std::future<void> f = client_->EnquireLinkAsync(asio::use_future);
+  while (f.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+    ios_.run_one_for(std::chrono::milliseconds(100));
+  }
+  EXPECT_NO_THROW(f.get());
+  client_->Unbind();
+  socket_->close();
+}
+
 TEST_F(SmppClientCsmsTest, CsmsPayload) {
   client_.set_csms_method(SmppClient::CSMS_PAYLOAD);
   {
@@ -233,3 +321,27 @@ TEST_F(SmppClientCsmsTest, Csms8BitUdh) {
     EXPECT_EQ(4, r.second);
   }
 }
+
+TEST_F(SmppClientCsmsTest, Windowed) {
+  client_.set_window_size(4);
+  client_.set_csms_method(SmppClient::CSMS_16BIT_TAGS);
+  std::vector<smpp::SubmitSmResult> results;
+  auto callback = [&results](const smpp::SubmitSmResult &result) { results.push_back(result); };
+  int sent = 0;
+
+  for (int i = 0; i < 10; ++i) {
+    sent += client_.SendSmsWindowed(sender_, receiver_, GsmEncoder::EncodeGsm0338(message_170_),
+                                    smpp::SmppParams(), smpp::TlvList(), callback);
+    EXPECT_LE(client_.in_flight(), client_.window_size());
+  }
+
+  client_.FlushWindow();
+  EXPECT_EQ(20, sent);
+  EXPECT_EQ(0u, client_.in_flight());
+  ASSERT_EQ(static_cast<size_t>(sent), results.size());
+
+  for (auto &result : results) {
+    EXPECT_EQ(smpp::ESME::ROK, result.command_status);
+    EXPECT_FALSE(result.message_id.empty());
+  }
+}
@@ -6,7 +6,6 @@
 #include <glog/logging.h>
 
 #include <algorithm>
-#include <list>
 #include <string>
 
 #include "gtest/gtest.h"
@@ -15,7 +14,6 @@
 #include "smpp/timeformat.h"
 #include "smpp/tlv.h"
 
-using std::list;
 using std::string;
 
 /**
@@ -42,8 +40,8 @@ TEST(SmsTest, copy) {
   ASSERT_TRUE(!sms2.is_null);
   // Compare TLVs
   ASSERT_EQ(sms.tlvs.size(), sms2.tlvs.size());
-  list<smpp::TLV>::iterator it;
-  list<smpp::TLV>::iterator it2;
+  smpp::TlvList::const_iterator it;
+  smpp::TlvList::const_iterator it2;
   it = sms.tlvs.begin();
   it2 = sms2.tlvs.begin();
 
@@ -93,7 +91,7 @@ TEST(SmsTest, dlr) {
   EXPECT_EQ(sms.data_coding, smpp::DataCoding::ISO8859_1);
   // Assertions for TLV fields
   EXPECT_EQ(static_cast<int>(sms.tlvs.size()), 2);
-  list<smpp::TLV>::iterator it;
+  smpp::TlvList::const_iterator it;
   it = sms.tlvs.begin();
   EXPECT_EQ(it->tag(), smpp::Tag::MESSAGE_STATE);
   EXPECT_EQ(it->octets()[0], static_cast<typename std::underlying_type<smpp::State>::type>(smpp::State::DELIVERED));
@@ -108,4 +106,55 @@ TEST(SmsTest, dlr) {
   EXPECT_EQ(dlr.done_date_, smpp::timeformat::ParseDlrTimestamp("1110261647"));
   EXPECT_EQ(dlr.stat, string("DELIVRD"));
   EXPECT_EQ(dlr.err, string("000"));
+  EXPECT_EQ(dlr.state, smpp::State::DELIVERED);
+}
+
+namespace {
+smpp::SMS MakeReceipt(const string &text) {
+  smpp::SMS sms;
+  sms.is_null = false;
+  sms.esm_class = smpp::ESM::DELIVER_SMSC_RECEIPT;
+  sms.short_message = text;
+  return sms;
+}
+}  // namespace
+
+TEST(SmsTest, dlrVariants) {
+  // Lower case keys, 12 digit dates, a hex id and no text.
+  smpp::DeliveryReport dlr(MakeReceipt(
+      "id:0A1B2C3D sub:1 dlvrd:1 submit date:140203133700 done date:140203133759 stat:undeliv err:012"));
+  EXPECT_EQ("0A1B2C3D", dlr.id);
+  EXPECT_EQ(1u, dlr.sub);
+  EXPECT_EQ(smpp::timeformat::ParseDlrTimestamp("1402031337"), dlr.submit_date_);
+  EXPECT_EQ(smpp::timeformat::ParseDlrTimestamp("1402031337") + std::chrono::seconds(59), dlr.done_date_);
+  EXPECT_EQ("UNDELIV", dlr.stat);
+  EXPECT_EQ(smpp::State::UNDELIVERABLE, dlr.state);
+  EXPECT_EQ("012", dlr.err);
+  EXPECT_EQ("", dlr.text);
+
+  smpp::DeliveryReport upper(MakeReceipt(
+      "ID:42 SUB:001 DLVRD:000 SUBMIT DATE:1402031337 DONE DATE:1402031338 STAT:EXPIRED ERR:000 TEXT:a b: c"));
+  EXPECT_EQ("42", upper.id);
+  EXPECT_EQ(0u, upper.dlvrd);
+  EXPECT_EQ("EXPIRED", upper.stat);
+  EXPECT_EQ(smpp::State::EXPIRED, upper.state);
+  EXPECT_EQ("a b: c", upper.text);
+
+  // Not a receipt.
+  smpp::DeliveryReport other(MakeReceipt("Hello id:1"));
+  EXPECT_EQ("", other.id);
+  EXPECT_EQ("", other.stat);
+  EXPECT_EQ(smpp::State::UNKNOWN, other.state);
+}
+
+TEST(SmsTest, dlrTlvs) {
+  // The TLVs take precedence over the text.
+  smpp::SMS sms = MakeReceipt("id:1 sub:001 dlvrd:001 submit date:1402031337 done date:1402031338 stat:ENROUTE");
+  sms.tlvs.push_back(smpp::TLV(smpp::Tag::RECEIPTED_MESSAGE_ID, string("ff00\0", 5)));
+  sms.tlvs.push_back(smpp::TLV(smpp::Tag::MESSAGE_STATE, static_cast<uint8_t>(smpp::State::REJECTED)));
+  smpp::DeliveryReport dlr(sms);
+  EXPECT_EQ("ff00", dlr.id);
+  EXPECT_EQ("REJECTD", dlr.stat);
+  EXPECT_EQ(smpp::State::REJECTED, dlr.state);
+  EXPECT_EQ(1u, dlr.dlvrd);
 }
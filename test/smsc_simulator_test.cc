@@ -0,0 +1,467 @@
+//
+// Copyright (C) 2014 OnlineCity
+// Licensed under the MIT license, which can be read at: http://www.opensource.org/licenses/mit-license.php
+//
+// Runs the client against the in-process SMSC simulator, so no SMSC is needed.
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <boost/asio.hpp>
+namespace asio = boost::asio;
+
+#include "gtest/gtest.h"
+#include "smpp/gsmencoding.h"
+#include "smpp/session_pool.h"
+#include "smpp/smpp_params.h"
+#include "smpp/smppclient.h"
+#include "smpp/sms.h"
+#include "smpp/smsc_simulator.h"
+#include "smpp/tlv.h"
+
+using smpp::encoding::GsmEncoder;
+using smpp::SmppAddress;
+using smpp::SmppClient;
+using smpp::SmscSimulator;
+using smpp::Tag;
+using smpp::TLV;
+using smpp::TlvList;
+using std::string;
+
+class SmscSimulatorTest : public testing::Test {
+ public:
+  asio::io_context ios_;
+  SmscSimulator smsc_;
+  std::shared_ptr<asio::ip::tcp::socket> socket_;
+  std::unique_ptr<SmppClient> client_;
+  SmppAddress sender_;
+  SmppAddress receiver_;
+
+  SmscSimulatorTest() :
+    ios_(),
+    smsc_(ios_, asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0)),
+    socket_(std::make_shared<asio::ip::tcp::socket>(ios_)),
+    client_(new SmppClient(socket_, ios_)),
+    sender_("CPPSMPP", smpp::TON::ALPHANUMERIC, smpp::NPI::UNKNOWN),
+    receiver_("4513371337", smpp::TON::INTERNATIONAL, smpp::NPI::E164) {
+  }
+
+  virtual void SetUp() {
+    smsc_.set_credentials("username", "password");
+    smsc_.Start();
+    socket_->connect(smsc_.endpoint());
+  }
+
+  virtual void TearDown() {
+    client_.reset();
+    smsc_.Stop();
+  }
+};
+
+TEST_F(SmscSimulatorTest, Bind) {
+  EXPECT_THROW(client_->BindTransmitter("WRONG_USERNAME", "password"), smpp::InvalidSystemIdException);
+  EXPECT_THROW(client_->BindTransmitter("username", "I_FORGET_PASWD"), smpp::InvalidPasswordException);
+  client_->BindTransmitter("username", "password");
+  EXPECT_TRUE(client_->IsBound());
+  EXPECT_EQ(1u, smsc_.stats().binds);
+  client_->Unbind();
+}
+
+TEST_F(SmscSimulatorTest, Submit) {
+  client_->BindTransmitter("username", "password");
+  auto result = client_->SendSms(sender_, receiver_, GsmEncoder::EncodeGsm0338("message to send"));
+  EXPECT_EQ(16u, result.first.size());
+  EXPECT_EQ(1, result.second);
+
+  auto query = client_->QuerySm(result.first, sender_);
+  EXPECT_EQ(result.first, std::get<0>(query));
+  EXPECT_EQ(1u, smsc_.stats().submits);
+}
+
+TEST_F(SmscSimulatorTest, Latency) {
+  smsc_.set_latency(std::chrono::milliseconds(50));
+  client_->BindTransmitter("username", "password");
+  auto start = std::chrono::steady_clock::now();
+  client_->SendSms(sender_, receiver_, GsmEncoder::EncodeGsm0338("message to send"));
+  EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(50));
+}
+
+TEST_F(SmscSimulatorTest, CancelBlocking) {
+  client_->BindTransmitter("username", "password");
+  smsc_.set_latency(std::chrono::milliseconds(500));
+  client_->CancelBlocking();
+  EXPECT_THROW(client_->QuerySm("0000000000000001", sender_), smpp::TransportException);
+}
+
+// Async operations report what the blocking calls throw through their handler.
+TEST_F(SmscSimulatorTest, AsyncErrors) {
+  client_->BindTransmitter("username", "password");
+  boost::system::error_code error;
+  int answered = 0;
+  auto handler = [&error, &answered](boost::system::error_code ec, std::pair<string, int>) {
+    error = ec;
+    ++answered;
+  };
+
+  SmppAddress too_long(string(21, '1'));
+  EXPECT_NO_THROW(client_->SendSmsAsync(too_long, receiver_, "message", handler));
+  ios_.restart();
+  ios_.poll();
+  EXPECT_EQ(1, answered);
+  EXPECT_EQ(smpp::ESME::RINVPARLEN, error);
+
+  socket_->close();
+  EXPECT_NO_THROW(client_->SendSmsAsync(sender_, receiver_, "message", handler));
+  ios_.restart();
+  ios_.poll();
+  EXPECT_EQ(2, answered);
+  EXPECT_EQ(asio::error::not_connected, error);
+}
+
+// Requests still in flight when the client goes away are completed with operation_aborted.
+TEST_F(SmscSimulatorTest, DestroyWithRequestInFlight) {
+  smsc_.set_latency(std::chrono::milliseconds(200));
+  boost::system::error_code error;
+  int answered = 0;
+  client_->QuerySmAsync("0000000000000001", sender_, [&error, &answered](boost::system::error_code ec,
+                                                                         smpp::QuerySmResult) {
+    error = ec;
+    ++answered;
+  });
+  client_.reset();
+  ios_.restart();
+  ios_.poll();
+  EXPECT_EQ(1, answered);
+  EXPECT_EQ(asio::error::operation_aborted, error);
+}
+
+// Throttled submits are sent again by the client
+TEST_F(SmscSimulatorTest, Throttle) {
+  smsc_.set_throttle_every(3);
+  client_->BindTransmitter("username", "password");
+  for (int i = 0; i < 4; ++i) {
+    client_->SendSms(sender_, receiver_, GsmEncoder::EncodeGsm0338("message to send"));
+  }
+  EXPECT_EQ(5u, smsc_.stats().submits);
+  EXPECT_EQ(1u, smsc_.stats().throttled);
+}
+
+TEST_F(SmscSimulatorTest, Metrics) {
+  smsc_.set_throttle_every(2);
+  client_->BindTransmitter("username", "password");
+  for (int i = 0; i < 2; ++i) {
+    client_->SendSms(sender_, receiver_, GsmEncoder::EncodeGsm0338("message to send"));
+  }
+
+  smpp::MetricsSnapshot metrics = client_->metrics();
+  EXPECT_EQ(1u, metrics.binds);
+  EXPECT_EQ(0u, metrics.reconnects);
+  EXPECT_EQ(4u, metrics.pdus_out);
+  EXPECT_EQ(4u, metrics.pdus_in);
+  EXPECT_GT(metrics.bytes_out, metrics.bytes_in);
+  EXPECT_EQ(3u, metrics.status(smpp::ESME::ROK));
+  EXPECT_EQ(1u, metrics.status(smpp::ESME::RTHROTTLED));
+  EXPECT_EQ(1u, metrics.latency_of(smpp::MetricCommand::BIND).count);
+  EXPECT_EQ(3u, metrics.latency_of(smpp::MetricCommand::SUBMIT_SM).count);
+  EXPECT_EQ(0u, metrics.in_flight);
+  EXPECT_EQ(0u, metrics.window_queue);
+  EXPECT_EQ(0u, metrics.write_queue);
+}
+
+TEST_F(SmscSimulatorTest, Batch) {
+  client_->BindTransmitter("username", "password");
+  client_->set_window_size(8);
+  std::vector<smpp::BatchSms> batch;
+  for (int i = 0; i < 100; ++i) {
+    batch.emplace_back(receiver_, GsmEncoder::EncodeGsm0338("message " + std::to_string(i)));
+  }
+  batch[42].short_message = GsmEncoder::EncodeGsm0338(string(200, 'x'));  // Sent in two parts.
+  batch[50].receiver = SmppAddress(string(21, '1'));  // Longer than SMPP allows.
+
+  std::vector<smpp::BatchSmsResult> results(batch.size());
+  int answered = 0;
+  EXPECT_EQ(batch.size(), client_->SendSmsBatch(sender_, batch.begin(), batch.end(),
+                                                [&](const smpp::BatchSmsResult &result) {
+    results[result.index] = result;
+    ++answered;
+  }));
+  EXPECT_EQ(100, answered);
+  EXPECT_EQ(0u, client_->pending());
+  for (size_t i = 0; i < results.size(); ++i) {
+    if (i == 50) {
+      EXPECT_EQ(smpp::ESME::RINVPARLEN, results[i].error);
+      EXPECT_EQ(0, results[i].num_messages);
+    } else {
+      EXPECT_FALSE(results[i].error) << i;
+      EXPECT_EQ(16u, results[i].message_id.size());
+      EXPECT_EQ(i == 42 ? 2 : 1, results[i].num_messages);
+    }
+  }
+  EXPECT_EQ(100u, smsc_.stats().submits);
+}
+
+TEST_F(SmscSimulatorTest, BatchCancelled) {
+  client_->BindTransmitter("username", "password");
+  client_->set_window_size(4);
+  smsc_.set_latency(std::chrono::milliseconds(200));
+  std::vector<smpp::BatchSms> batch;
+  for (int i = 0; i < 10; ++i) {
+    batch.emplace_back(receiver_, GsmEncoder::EncodeGsm0338("message " + std::to_string(i)));
+  }
+
+  // Cancelled while the window is full, every SMS is reported before the call throws.
+  std::vector<int> answered(batch.size());
+  client_->CancelBlocking();
+  EXPECT_THROW(client_->SendSmsBatch(sender_, batch.begin(), batch.end(), [&](const smpp::BatchSmsResult &result) {
+    EXPECT_EQ(asio::error::operation_aborted, result.error);
+    ++answered[result.index];
+  }), smpp::TransportException);
+  EXPECT_EQ(std::vector<int>(batch.size(), 1), answered);
+
+  // The responses to the submits in flight don't reach the callback, and the queued one is never sent.
+  client_->FlushWindow();
+  EXPECT_EQ(0u, client_->pending());
+  EXPECT_EQ(std::vector<int>(batch.size(), 1), answered);
+  EXPECT_EQ(4u, smsc_.stats().submits);
+
+  // Cancelled while waiting for the last responses.
+  answered.assign(batch.size(), 0);
+  client_->CancelBlocking();
+  EXPECT_THROW(client_->SendSmsBatch(sender_, batch.begin(), batch.begin() + 3,
+                                     [&](const smpp::BatchSmsResult &result) {
+    EXPECT_EQ(asio::error::operation_aborted, result.error);
+    ++answered[result.index];
+  }), smpp::TransportException);
+  EXPECT_EQ(std::vector<int>({1, 1, 1, 0, 0, 0, 0, 0, 0, 0}), answered);
+  client_->FlushWindow();
+  EXPECT_EQ(7u, smsc_.stats().submits);
+}
+
+// A batch on a closed connection throws, having reported each SMS once.
+TEST_F(SmscSimulatorTest, BatchNotConnected) {
+  client_->BindTransmitter("username", "password");
+  socket_->close();
+  std::vector<smpp::BatchSms> batch;
+  for (int i = 0; i < 3; ++i) {
+    batch.emplace_back(receiver_, GsmEncoder::EncodeGsm0338("message " + std::to_string(i)));
+  }
+  std::vector<int> answered(batch.size());
+  EXPECT_THROW(client_->SendSmsBatch(sender_, batch.begin(), batch.end(), [&](const smpp::BatchSmsResult &result) {
+    EXPECT_EQ(asio::error::operation_aborted, result.error);
+    ++answered[result.index];
+  }), smpp::TransportException);
+  EXPECT_EQ(std::vector<int>(batch.size(), 1), answered);
+}
+
+TEST_F(SmscSimulatorTest, SubmitMulti) {
+  client_->BindTransmitter("username", "password");
+  std::vector<smpp::DestAddress> dests;
+  for (int i = 0; i < 300; ++i) {
+    dests.emplace_back(SmppAddress("4513" + std::to_string(370000 + i), smpp::TON::INTERNATIONAL, smpp::NPI::E164));
+  }
+  dests.emplace_back(string("friends"));  // The simulator has no distribution lists.
+  dests.emplace_back(SmppAddress("CPPSMPP", smpp::TON::ALPHANUMERIC, smpp::NPI::UNKNOWN));
+
+  // Two parts to two groups of destinations.
+  smpp::SubmitMultiResult result = client_->SubmitMulti(sender_, dests, GsmEncoder::EncodeGsm0338(string(200, 'x')));
+  EXPECT_EQ(16u, result.message_id.size());
+  EXPECT_EQ(2, result.num_messages);
+  EXPECT_EQ(4u, smsc_.stats().submit_multis);
+  ASSERT_EQ(2u, result.unsuccess_smes.size());
+  EXPECT_EQ("friends", result.unsuccess_smes[0].address.value);
+  EXPECT_EQ(smpp::ESME::RINVDLNAME, result.unsuccess_smes[0].error_status_code);
+  EXPECT_EQ("CPPSMPP", result.unsuccess_smes[1].address.value);
+  EXPECT_EQ(smpp::ESME::RINVDSTADR, result.unsuccess_smes[1].error_status_code);
+
+  EXPECT_THROW(client_->SubmitMulti(sender_, std::vector<smpp::DestAddress>(), "message"), smpp::SmppException);
+}
+
+// submit_multis are counted apart from submit_sms when throttling every n-th.
+TEST_F(SmscSimulatorTest, SubmitMultiThrottle) {
+  smsc_.set_throttle_every(2);
+  client_->BindTransmitter("username", "password");
+  std::vector<smpp::DestAddress> dests = { smpp::DestAddress(receiver_) };
+  client_->SubmitMulti(sender_, dests, "message");
+  EXPECT_EQ(0u, smsc_.stats().throttled);
+  client_->SubmitMulti(sender_, dests, "message");
+  EXPECT_EQ(1u, smsc_.stats().throttled);
+  EXPECT_EQ(3u, smsc_.stats().submit_multis);
+  EXPECT_EQ(0u, smsc_.stats().submits);
+}
+
+TEST_F(SmscSimulatorTest, DataSm) {
+  client_->BindTransmitter("username", "password");
+  TlvList tags = { TLV(Tag::USER_MESSAGE_REFERENCE, static_cast<uint16_t>(7)) };
+  smpp::DataSmResult result = client_->SendDataSm(sender_, receiver_, string(1000, 'x'), smpp::SmppParams(), tags);
+  EXPECT_EQ(smpp::ESME::ROK, result.command_status);
+  EXPECT_EQ(16u, result.message_id.size());
+  EXPECT_TRUE(result.tlvs.empty());
+  EXPECT_EQ(1u, smsc_.stats().data_sms);
+  EXPECT_EQ(0u, smsc_.stats().submits);
+
+  // A refused data_sm returns why, rather than throwing.
+  result = client_->SendDataSm(sender_, SmppAddress("CPPSMPP", smpp::TON::ALPHANUMERIC, smpp::NPI::UNKNOWN),
+                               "message");
+  EXPECT_EQ(smpp::ESME::RDELIVERYFAILURE, result.command_status);
+  EXPECT_EQ("", result.message_id);
+  EXPECT_EQ(1, result.tlvs.get<uint8_t>(Tag::DELIVERY_FAILURE_REASON));
+  ASSERT_TRUE(result.tlvs.contains(Tag::NETWORK_ERROR_CODE));
+  EXPECT_EQ(string("\x03\x00\x01", 3), result.tlvs.find(Tag::NETWORK_ERROR_CODE)->octets());
+
+  bool done = false;
+  boost::system::error_code error;
+  client_->SendDataSmAsync(sender_, receiver_, "message", smpp::SmppParams(), TlvList(),
+                           [&done, &error, &result](boost::system::error_code ec, smpp::DataSmResult r) {
+    done = true;
+    error = ec;
+    result = std::move(r);
+  });
+  while (!done) {
+    ios_.run_one();
+  }
+  EXPECT_FALSE(error);
+  EXPECT_EQ(16u, result.message_id.size());
+  EXPECT_EQ(3u, smsc_.stats().data_sms);
+}
+
+TEST_F(SmscSimulatorTest, LargeDataSm) {
+  client_->BindTransmitter("username", "password");
+  // More than the 64 KB the simulator reads at a time.
+  smpp::DataSmResult result = client_->SendDataSm(sender_, receiver_, string(65535, 'x'));
+  EXPECT_EQ(smpp::ESME::ROK, result.command_status);
+  EXPECT_EQ(1u, smsc_.stats().data_sms);
+}
+
+TEST_F(SmscSimulatorTest, GenericNack) {
+  smsc_.set_nack_every(1);
+  client_->BindTransmitter("username", "password");
+  EXPECT_THROW(client_->SendSms(sender_, receiver_, GsmEncoder::EncodeGsm0338("message to send")),
+               smpp::SmppException);
+  EXPECT_EQ(1u, smsc_.stats().nacked);
+}
+
+TEST_F(SmscSimulatorTest, DeliveryReceipt) {
+  client_->BindTransceiver("username", "password");
+  smpp::SmppParams params;
+  params.registered_delivery = smpp::RegisteredDelivery::DELIVERY_SMSC_BOTH;
+  auto submitted = std::chrono::system_clock::now();
+  auto result = client_->SendSms(sender_, receiver_, GsmEncoder::EncodeGsm0338("message to send"), params);
+
+  smpp::SMS sms = client_->ReadSms();
+  ASSERT_FALSE(sms.is_null);
+  EXPECT_EQ(smpp::ESM::DELIVER_SMSC_RECEIPT, sms.esm_class);
+  EXPECT_EQ(receiver_.value, sms.source_addr);
+  smpp::DeliveryReport dlr(sms);
+  EXPECT_EQ(result.first, dlr.id);
+  EXPECT_EQ("DELIVRD", dlr.stat);
+  EXPECT_EQ("message to send", dlr.text);
+  // The receipt dates are UTC to the minute.
+  EXPECT_GT(dlr.submit_date_, submitted - std::chrono::minutes(1));
+  EXPECT_LE(dlr.submit_date_, std::chrono::system_clock::now());
+}
+
+TEST_F(SmscSimulatorTest, Deliver) {
+  smsc_.set_deliver_rate(100);
+  client_->BindReceiver("username", "password");
+  for (int i = 1; i <= 3; ++i) {
+    smpp::SMS sms = client_->ReadSms();
+    ASSERT_FALSE(sms.is_null);
+    EXPECT_EQ("Message " + std::to_string(i) + " from the simulator", sms.short_message);
+  }
+}
+
+TEST_F(SmscSimulatorTest, DeliverView) {
+  smsc_.set_deliver_rate(100);
+  client_->BindReceiver("username", "password");
+  for (int i = 1; i <= 3; ++i) {
+    std::string message;
+    ASSERT_TRUE(client_->ReadSmsView([&message](const smpp::DeliverSmView &sms) {
+      EXPECT_EQ(smpp::CommandId::DELIVER_SM, sms.command_id());
+      message = std::string(sms.short_message());
+    }));
+    EXPECT_EQ("Message " + std::to_string(i) + " from the simulator", message);
+  }
+}
+
+TEST_F(SmscSimulatorTest, DeliverDataSm) {
+  smsc_.set_deliver_rate(100);
+  smsc_.set_deliver_data_sm(true);
+  client_->BindReceiver("username", "password");
+  smpp::SMS sms = client_->ReadSms();
+  ASSERT_FALSE(sms.is_null);
+  EXPECT_EQ(smpp::CommandId::DATA_SM, sms.command_id);
+  EXPECT_EQ("Message 1 from the simulator", sms.short_message);
+  EXPECT_EQ("4512345678", sms.source_addr);
+
+  std::string message;
+  ASSERT_TRUE(client_->ReadSmsView([&message](const smpp::DeliverSmView &view) {
+    EXPECT_EQ(smpp::CommandId::DATA_SM, view.command_id());
+    message = std::string(view.short_message());
+  }));
+  EXPECT_EQ("Message 2 from the simulator", message);
+}
+
+// PDUs larger than the read buffer of the client, pushed by a bare socket standing in for the SMSC.
+// Sessions reconnected with a new client keep the settings of the session setup.
+TEST_F(SmscSimulatorTest, SessionPoolSetup) {
+  smpp::SessionPool pool(ios_, smsc_.endpoint(), 2);
+  pool.set_session_setup([](SmppClient &client) {
+    client.set_window_size(7);
+  });
+  EXPECT_EQ(7u, pool.session(0).window_size());
+  pool.session(0).set_throttle(100, 10);  // Lost with the client.
+
+  // A refused bind leaves the sessions connected, so the next Bind starts them over.
+  EXPECT_THROW(pool.Bind("username", "WRONG_PASSWORD"), smpp::TransportException);
+  EXPECT_EQ(2u, pool.Bind("username", "password"));
+  for (size_t i = 0; i < pool.size(); ++i) {
+    EXPECT_TRUE(pool.session(i).IsBound());
+    EXPECT_EQ(7u, pool.session(i).window_size());
+  }
+  EXPECT_EQ(0, pool.session(0).throttle_tps());
+}
+
+TEST(SmppClientReadTest, LargePdu) {
+  asio::io_context ios;
+  asio::ip::tcp::acceptor acceptor(ios, asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+  auto socket = std::make_shared<asio::ip::tcp::socket>(ios);
+  socket->connect(acceptor.local_endpoint());
+  asio::ip::tcp::socket smsc = acceptor.accept();
+  SmppClient client(socket, ios);
+
+  // The response to the bind, which has the first sequence number, and two data_sm.
+  std::vector<smpp::PDU> pdus;
+  pdus.emplace_back(smpp::CommandId::BIND_RECEIVER_RESP, smpp::ESME::ROK, 1);
+  pdus.back() << string("SMSC");
+  for (size_t size : { 65535, 10 }) {
+    pdus.emplace_back(smpp::CommandId::DATA_SM, smpp::ESME::ROK, static_cast<uint32_t>(pdus.size()));
+    pdus.back() << string("") << SmppAddress("4512345678") << SmppAddress("CPPSMPP");
+    pdus.back() << 0 << 0 << 0;  // esm_class, registered_delivery, data_coding
+    pdus.back() << TLV(Tag::MESSAGE_PAYLOAD, string(size, 'x'));
+  }
+  std::vector<asio::const_buffer> buffers;
+  for (auto &pdu : pdus) {
+    buffers.push_back(asio::buffer(pdu.Octets().data(), pdu.Octets().size()));
+  }
+  asio::async_write(smsc, buffers, [](const boost::system::error_code &error, size_t) {
+    EXPECT_FALSE(error);
+  });
+
+  client.BindReceiver("username", "password");
+  smpp::SMS sms = client.ReadSms();
+  ASSERT_FALSE(sms.is_null);
+  EXPECT_EQ(string(65535, 'x'), sms.short_message);
+  sms = client.ReadSms();
+  ASSERT_FALSE(sms.is_null);
+  EXPECT_EQ(string(10, 'x'), sms.short_message);
+
+  // Closed so the unbind of the client fails at once, rather than waiting out the read timeout.
+  smsc.close();
+}
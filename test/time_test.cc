@@ -22,17 +22,9 @@ void print(const std::string &tp_id, const sc::time_point<sc::system_clock> &tp)
   << std::endl;
 }
 
-sc::time_point<sc::system_clock> MakeTimePoint(int yy, int mon, int mday, int hour, int min, int sec, int64_t gmtoff) {
-  struct tm tm;
-  tm.tm_year = yy - 1900;
-  tm.tm_mon = mon - 1;
-  tm.tm_mday = mday;
-  tm.tm_hour = hour;
-  tm.tm_min = min;
-  tm.tm_sec = sec;
-  tm.tm_isdst = -1;
-  // tm.tm_gmtoff = gmtoff * 60;
-  return sc::system_clock::from_time_t(std::mktime(&tm));
+// Returns the time_point of seconds since the epoch, in UTC.
+sc::time_point<sc::system_clock> UtcTimePoint(std::time_t seconds) {
+  return sc::system_clock::from_time_t(seconds);
 }
 
 struct tm MakeTm(int yy, int mon, int mday, int hour, int min, int sec, int64_t gmtoff) {
@@ -49,17 +41,27 @@ struct tm MakeTm(int yy, int mon, int mday, int hour, int min, int sec, int64_t
 }
 
 TEST(TimeTest, ParseAbsolute) {
+  // 2011-10-19 08:00:00 at +00:30 is 07:30:00 UTC.
   ChronoDatePair pair1 = ParseSmppTimestamp("111019080000002+");
-  auto time1 = MakeTimePoint(2011, 10, 19, 8, 0, 0, 2 * 15);
-  ASSERT_EQ(pair1.first, time1);
+  ASSERT_EQ(pair1.first, UtcTimePoint(1319009400));
 
+  // At +04:15 it is 03:45:00 UTC.
   ChronoDatePair pair2 = ParseSmppTimestamp("111019080000017+");
-  auto time2 = MakeTimePoint(2011, 10, 19, 8, 0, 0, 17 * 15);
-  ASSERT_EQ(pair2.first, time2);
+  ASSERT_EQ(pair2.first, UtcTimePoint(1318995900));
 
+  // At -01:00 it is 09:00:00 UTC.
   ChronoDatePair pair3 = ParseSmppTimestamp("111019080000004-");
-  auto time3 = MakeTimePoint(2011, 10, 19, 8, 0, 0, -4 * 15);
-  ASSERT_EQ(pair3.first, time3);
+  ASSERT_EQ(pair3.first, UtcTimePoint(1319014800));
+
+  // Tenths of a second are kept.
+  auto time4 = smpp::timeformat::ParseAbsoluteTimestamp("111019103011100+");
+  EXPECT_EQ(time4, UtcTimePoint(1319020211) + sc::milliseconds(100));
+}
+
+TEST(TimeTest, Calendar) {
+  EXPECT_EQ(smpp::timeformat::ParseAbsoluteTimestamp("000229120000000+"), UtcTimePoint(951825600));
+  EXPECT_EQ(smpp::timeformat::ParseAbsoluteTimestamp("991231235959000+"), UtcTimePoint(4102444799));
+  EXPECT_EQ(smpp::timeformat::ParseAbsoluteTimestamp("991231235959048-"), UtcTimePoint(4102444799 + 12 * 3600));
 }
 
 TEST(TimeTest, ParseRelative) {
@@ -76,39 +78,42 @@ TEST(TimeTest, formats) {
   EXPECT_THROW(ParseSmppTimestamp("000002000000000r"), smpp::SmppException);
   EXPECT_THROW(ParseSmppTimestamp("0000020000AA000R"), smpp::SmppException);
   EXPECT_THROW(ParseSmppTimestamp(""), smpp::SmppException);
+  EXPECT_THROW(ParseSmppTimestamp("111019103011100+0"), smpp::SmppException);
+  EXPECT_THROW(smpp::timeformat::ParseRelativeTimestamp("111019103011100+"), smpp::SmppException);
+  EXPECT_THROW(smpp::timeformat::ParseAbsoluteTimestamp("000002000000000R"), smpp::SmppException);
 }
 
 TEST(TimeTest, ParseDlrTimestamp) {
-  namespace sc = std::chrono;
-  struct tm tm;
-  tm.tm_year = 2014 - 1900;
-  tm.tm_mon = 1;
-  tm.tm_mday = 3;
-  tm.tm_hour = 13;
-  tm.tm_min = 37;
-  tm.tm_sec = 0;
-  tm.tm_isdst = -1;
-
-  auto exp_time1 = sc::system_clock::from_time_t(std::mktime(&tm));
-  auto time1 = smpp::timeformat::ParseDlrTimestamp("1402031337");
-  EXPECT_EQ(exp_time1, time1);
-
-  tm.tm_year = 2009 - 1900;
-  tm.tm_mon = 5;
-  tm.tm_mday = 5;
-  tm.tm_hour = 13;
-  tm.tm_min = 37;
-  tm.tm_sec = 0;
-  tm.tm_isdst = -1;
-
-  auto exp_time2 = sc::system_clock::from_time_t(std::mktime(&tm));
-  auto time2 = smpp::timeformat::ParseDlrTimestamp("0906051337");
-  EXPECT_EQ(exp_time2, time2);
+  // Receipts carry no offset, they are read as UTC.
+  EXPECT_EQ(smpp::timeformat::ParseDlrTimestamp("1402031337"), UtcTimePoint(1391434620));
+  EXPECT_EQ(smpp::timeformat::ParseDlrTimestamp("140203133759"), UtcTimePoint(1391434620 + 59));
+  EXPECT_EQ(smpp::timeformat::ParseDlrTimestamp("0906051337"), UtcTimePoint(1244209020));
+  EXPECT_THROW(smpp::timeformat::ParseDlrTimestamp(""), smpp::SmppException);
+  EXPECT_THROW(smpp::timeformat::ParseDlrTimestamp("14020313"), smpp::SmppException);
+  EXPECT_THROW(smpp::timeformat::ParseDlrTimestamp("14020313375"), smpp::SmppException);
+  EXPECT_THROW(smpp::timeformat::ParseDlrTimestamp("14020313375900"), smpp::SmppException);
+  EXPECT_THROW(smpp::timeformat::ParseDlrTimestamp("14020313:3"), smpp::SmppException);
 }
 
 TEST(TimeTest, FormatAbsolute) {
   string s = smpp::timeformat::ToSmppTimeString(MakeTm(2011, 10, 19, 9, 30, 0, 60));
   EXPECT_EQ(s, string("1110190930000"));
+
+  char buffer[smpp::timeformat::SMPP_TIMESTAMP_LENGTH + 1];
+  EXPECT_EQ(smpp::timeformat::ToSmppTimeString(MakeTm(2011, 10, 19, 9, 30, 0, 60), buffer), 13u);
+  EXPECT_EQ(string(buffer), "1110190930000");
+}
+
+TEST(TimeTest, FormatTimePoint) {
+  using smpp::timeformat::ToSmppTimeString;
+  EXPECT_EQ(ToSmppTimeString(UtcTimePoint(1319020211) + sc::milliseconds(150)), "111019103011100+");
+  EXPECT_EQ(ToSmppTimeString(UtcTimePoint(951825600)), "000229120000000+");
+  EXPECT_EQ(ToSmppTimeString(UtcTimePoint(4102444799)), "991231235959000+");
+
+  auto tp = UtcTimePoint(1391434620) + sc::milliseconds(700);
+  char buffer[smpp::timeformat::SMPP_TIMESTAMP_LENGTH + 1];
+  EXPECT_EQ(ToSmppTimeString(tp, buffer), smpp::timeformat::SMPP_TIMESTAMP_LENGTH);
+  EXPECT_EQ(ParseSmppTimestamp(buffer).first, tp);
 }
 
 TEST(TimeTest, FormatRelative) {
@@ -118,4 +123,10 @@ TEST(TimeTest, FormatRelative) {
   EXPECT_EQ(ToSmppTimeString(sc::hours(875043) + sc::minutes(34) + sc::seconds(29)), string("991025033429000R"));
   EXPECT_THROW(ToSmppTimeString(sc::hours(876143) + sc::minutes(34) + sc::seconds(29)),
                smpp::SmppException);  // 876143 would overflow 99 years
+  EXPECT_THROW(ToSmppTimeString(sc::seconds(-1)), smpp::SmppException);
+
+  char buffer[smpp::timeformat::SMPP_TIMESTAMP_LENGTH + 1];
+  EXPECT_EQ(ToSmppTimeString(sc::hours(48) + sc::minutes(65), buffer), smpp::timeformat::SMPP_TIMESTAMP_LENGTH);
+  EXPECT_EQ(string(buffer), "000002010500000R");
+  EXPECT_EQ(ParseSmppTimestamp(buffer).second, sc::hours(48) + sc::minutes(65));
 }
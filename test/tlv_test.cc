@@ -0,0 +1,120 @@
+//
+// Copyright (C) 2014 OnlineCity
+// Licensed under the MIT license, which can be read at: http://www.opensource.org/licenses/mit-license.php
+//
+
+#include <memory_resource>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "counting_resource.h"
+#include "smpp/exceptions.h"
+#include "smpp/tlv.h"
+
+using smpp::Tag;
+using smpp::TLV;
+using smpp::TlvList;
+using std::string;
+
+TEST(TlvTest, Integers) {
+  CountingResource resource;
+  TLV ref(Tag::SAR_MSG_REF_NUM, static_cast<uint16_t>(0x1337), &resource);
+  EXPECT_EQ(2, ref.len());
+  EXPECT_EQ(string("\x13\x37"), ref.octets());  // Network byte order.
+  EXPECT_EQ(0x1337, ref.get<uint16_t>());
+  EXPECT_EQ(0x1337u, ref.get<uint32_t>());
+  EXPECT_THROW(ref.get<uint8_t>(), smpp::SmppException);
+
+  TLV ttl(Tag::QOS_TIME_TO_LIVE, static_cast<uint32_t>(0xdeadbeef), &resource);
+  EXPECT_EQ(string("\xde\xad\xbe\xef"), ttl.octets());
+  EXPECT_EQ(0xdeadbeefu, ttl.get<uint32_t>());
+  EXPECT_EQ(0, resource.allocations);
+}
+
+TEST(TlvTest, Octets) {
+  CountingResource resource;
+  {
+    TLV small(Tag::RECEIPTED_MESSAGE_ID, string("12345678"), &resource);
+    EXPECT_EQ(0, resource.allocations);
+
+    TLV payload(Tag::MESSAGE_PAYLOAD, string(200, 'x'), &resource);
+    EXPECT_EQ(1, resource.allocations);
+    EXPECT_EQ(200, payload.len());
+    EXPECT_EQ(string(200, 'x'), payload.octets());
+
+    TLV copy(payload);
+    EXPECT_EQ(2, resource.allocations);
+    TLV moved(std::move(copy));
+    EXPECT_EQ(2, resource.allocations);
+    EXPECT_EQ(0, copy.len());  // NOLINT(bugprone-use-after-move)
+    EXPECT_EQ(payload.octets(), moved.octets());
+
+    moved = small;
+    EXPECT_EQ(1, resource.outstanding);
+    EXPECT_EQ("12345678", moved.octets());
+    small = std::move(payload);
+    EXPECT_EQ(string(200, 'x'), small.octets());
+    EXPECT_EQ(1, resource.outstanding);
+  }
+  EXPECT_EQ(0, resource.outstanding);
+
+  EXPECT_THROW(TLV(Tag::MESSAGE_PAYLOAD, string(0x10000, 'x')), smpp::SmppException);
+}
+
+TEST(TlvTest, Find) {
+  TlvList tlvs = {
+    TLV(Tag::USER_MESSAGE_REFERENCE, static_cast<uint16_t>(7)),
+    TLV(Tag::SAR_TOTAL_SEGMENTS, static_cast<uint8_t>(3)),
+    TLV(Tag::MORE_MESSAGES_TO_SEND)
+  };
+  EXPECT_EQ(3u, tlvs.size());
+  EXPECT_EQ(7, tlvs.get<uint16_t>(Tag::USER_MESSAGE_REFERENCE));
+  EXPECT_EQ(3, tlvs.get<uint16_t>(Tag::SAR_TOTAL_SEGMENTS));  // Widened.
+  ASSERT_TRUE(tlvs.contains(Tag::MORE_MESSAGES_TO_SEND));
+  EXPECT_EQ(0, tlvs.find(Tag::MORE_MESSAGES_TO_SEND)->len());
+  EXPECT_EQ(nullptr, tlvs.find(Tag::SAR_MSG_REF_NUM));
+  EXPECT_THROW(tlvs.get<uint16_t>(Tag::SAR_MSG_REF_NUM), smpp::SmppException);
+
+  // The first of a repeated tag is found.
+  tlvs.push_back(TLV(Tag::USER_MESSAGE_REFERENCE, static_cast<uint16_t>(8)));
+  EXPECT_EQ(7, tlvs.get<uint16_t>(Tag::USER_MESSAGE_REFERENCE));
+
+  tlvs.pop_back();
+  tlvs.pop_back();
+  EXPECT_FALSE(tlvs.contains(Tag::MORE_MESSAGES_TO_SEND));
+  EXPECT_EQ(3, tlvs.get<uint8_t>(Tag::SAR_TOTAL_SEGMENTS));
+
+  tlvs.clear();
+  EXPECT_TRUE(tlvs.empty());
+  EXPECT_FALSE(tlvs.contains(Tag::USER_MESSAGE_REFERENCE));
+}
+
+TEST(TlvTest, ManyTags) {
+  // More tags than are indexed, including some which share a slot.
+  std::vector<uint16_t> tags;
+  for (uint16_t tag = 0x1400; tag < 0x1400 + 3 * TlvList::INDEXED; ++tag) {
+    tags.push_back(tag);
+  }
+  TlvList tlvs;
+  for (uint16_t tag : tags) {
+    tlvs.emplace_back(static_cast<Tag>(tag), tag);
+  }
+  for (uint16_t tag : tags) {
+    EXPECT_EQ(tag, tlvs.get<uint16_t>(static_cast<Tag>(tag)));
+  }
+  EXPECT_FALSE(tlvs.contains(Tag::MESSAGE_PAYLOAD));
+
+  // Order is kept.
+  size_t i = 0;
+  for (const TLV &tlv : tlvs) {
+    EXPECT_EQ(static_cast<Tag>(tags[i++]), tlv.tag());
+  }
+
+  while (tlvs.size() > 1) {
+    tlvs.pop_back();
+    EXPECT_EQ(tags[tlvs.size() - 1], tlvs.get<uint16_t>(static_cast<Tag>(tags[tlvs.size() - 1])));
+    EXPECT_FALSE(tlvs.contains(static_cast<Tag>(tags[tlvs.size()])));
+  }
+}
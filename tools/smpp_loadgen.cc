@@ -0,0 +1,384 @@
+//
+// Copyright (C) 2014 OnlineCity
+// Licensed under the MIT license, which can be read at: http://www.opensource.org/licenses/mit-license.php
+//
+// Load generator, sending SMSes through N binds at a target rate or as fast as the SMSC answers.
+// Reports the sustained submit rate, submit to response latency percentiles and the rate at which
+// delivery receipts arrive.
+//
+// smpp-loadgen --binds=4 --rate=500 --duration=30 --mix=gsm7:70,ucs2:10,long:10,binary:10
+// smpp-loadgen --simulate --csms_method=8bit_udh
+//
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/asio.hpp>
+namespace asio = boost::asio;
+
+#include "smpp/gsmencoding.h"
+#include "smpp/smpp_params.h"
+#include "smpp/smppclient.h"
+#include "smpp/sms.h"
+#include "smpp/smsc_simulator.h"
+
+DEFINE_string(host, "127.0.0.1", "SMSC host");
+DEFINE_int32(port, 2775, "SMSC port");
+DEFINE_string(username, "username", "SMPP system id");
+DEFINE_string(password, "password", "SMPP password");
+DEFINE_string(sender, "CPPSMPP", "Sender address");
+DEFINE_string(receiver, "4513371337", "Receiver address");
+DEFINE_int32(binds, 4, "Number of binds");
+DEFINE_double(rate, 0, "Target SMSes per second over all binds, 0 sends as fast as the SMSC answers");
+DEFINE_int32(duration, 10, "Seconds to send for");
+DEFINE_int32(window, 10, "Requests awaiting a response per bind");
+DEFINE_string(mix, "gsm7:70,ucs2:10,long:10,binary:10",
+              "Message mix as kind:weight pairs, kinds are gsm7, ucs2, long and binary");
+DEFINE_string(csms_method, "16bit_tags", "How long messages are sent: payload, 16bit_tags or 8bit_udh");
+DEFINE_bool(receipts, true, "Bind as transceivers and request delivery receipts");
+DEFINE_int32(receipt_wait, 5, "Seconds to wait for outstanding delivery receipts after sending");
+DEFINE_bool(simulate, false, "Send to an in-process SMSC simulator instead of host:port");
+DEFINE_int32(sim_latency_ms, 0, "Response latency of the simulator");
+
+namespace {
+using boost::system::error_code;
+using std::chrono::steady_clock;
+using std::string;
+
+// An SMS as it is handed to SendSmsAsync.
+struct Message {
+  string kind;
+  string short_message;
+  smpp::SmppParams params;
+};
+
+// Returns a message of the given kind.
+// @throw std::invalid_argument for an unknown kind.
+Message MakeMessage(const string &kind) {
+  Message message { kind, string(), smpp::SmppParams() };
+  if (FLAGS_receipts) {
+    message.params.registered_delivery = smpp::RegisteredDelivery::DELIVERY_SMSC_BOTH;
+  } else {
+    message.params.registered_delivery = smpp::RegisteredDelivery::DELIVERY_NO;
+  }
+
+  if (kind == "gsm7") {
+    message.short_message = smpp::encoding::GsmEncoder::EncodeSms(
+        "Your verification code is 123456. It expires in 10 minutes, don't share it.", &message.params);
+  } else if (kind == "ucs2") {
+    message.short_message = smpp::encoding::GsmEncoder::EncodeSms(
+        "Ваш код подтверждения 123456. Никому его не сообщайте.", &message.params);
+  } else if (kind == "long") {
+    string text;
+    while (text.size() < 400) {
+      text += "Lorem ipsum dolor sit amet, consectetur adipiscing elit. ";
+    }
+    message.short_message = smpp::encoding::GsmEncoder::EncodeGsm0338(text.substr(0, 400));
+  } else if (kind == "binary") {
+    // WAP push to port 2948, with a 16 bit application port addressing UDH.
+    const char udh[] = { 0x06, 0x05, 0x04, 0x0b, static_cast<char>(0x84), 0x23, static_cast<char>(0xf0) };
+    message.short_message.assign(udh, sizeof(udh));
+    for (int i = 0; i < 100; ++i) {
+      message.short_message.push_back(static_cast<char>(i));
+    }
+    message.params.esm_class = smpp::ESM::UHDI;
+    message.params.data_coding = smpp::DataCoding::BINARY;
+  } else {
+    throw std::invalid_argument("Unknown message kind: " + kind);
+  }
+  return message;
+}
+
+// Parses the csms_method flag.
+int CsmsMethod(const string &name) {
+  if (name == "payload") {
+    return smpp::SmppClient::CSMS_PAYLOAD;
+  } else if (name == "16bit_tags") {
+    return smpp::SmppClient::CSMS_16BIT_TAGS;
+  } else if (name == "8bit_udh") {
+    return smpp::SmppClient::CSMS_8BIT_UDH;
+  }
+  throw std::invalid_argument("Unknown csms method: " + name);
+}
+
+// Returns the p-th percentile of sorted values.
+int64_t Percentile(const std::vector<int64_t> &sorted, const double p) {
+  if (sorted.empty()) {
+    return 0;
+  }
+  size_t rank = static_cast<size_t>(p * sorted.size());
+  return sorted[std::min(rank, sorted.size() - 1)];
+}
+
+class LoadGen {
+ public:
+  LoadGen(asio::io_context &ctx, const asio::ip::tcp::endpoint &endpoint) :
+    ctx_(ctx),
+    endpoint_(endpoint),
+    csms_method_(CsmsMethod(FLAGS_csms_method)),
+    sessions_(),
+    messages_(),
+    weights_(),
+    random_(std::random_device()()),
+    sender_(FLAGS_sender, smpp::TON::ALPHANUMERIC, smpp::NPI::UNKNOWN),
+    receiver_(FLAGS_receiver, smpp::TON::INTERNATIONAL, smpp::NPI::E164),
+    tick_timer_(ctx),
+    start_(),
+    end_(),
+    sent_(0),
+    outstanding_(0),
+    accepted_(0),
+    submits_(0),
+    errors_(0),
+    throttled_(0),
+    receipts_(0),
+    last_receipt_(),
+    latencies_(),
+    stopping_(false) {
+    std::stringstream mix(FLAGS_mix);
+    string item;
+    while (std::getline(mix, item, ',')) {
+      auto colon = item.find(':');
+      messages_.push_back(MakeMessage(item.substr(0, colon)));
+      weights_.push_back(colon == string::npos ? 1 : std::stod(item.substr(colon + 1)));
+    }
+  }
+
+  // Connects and binds every session.
+  void Bind() {
+    for (int i = 0; i < FLAGS_binds; ++i) {
+      std::unique_ptr<Session> session(new Session());
+      session->socket = std::make_shared<asio::ip::tcp::socket>(ctx_);
+      session->socket->connect(endpoint_);
+      session->client.reset(new smpp::SmppClient(session->socket, ctx_));
+      session->client->set_csms_method(csms_method_);
+      session->client->set_window_size(FLAGS_window);
+      if (FLAGS_receipts) {
+        session->client->BindTransceiver(FLAGS_username, FLAGS_password);
+      } else {
+        session->client->BindTransmitter(FLAGS_username, FLAGS_password);
+      }
+      sessions_.push_back(std::move(session));
+    }
+  }
+
+  // Sends for the given time, then waits for the responses and receipts still outstanding.
+  void Run(const std::chrono::seconds &duration) {
+    start_ = steady_clock::now();
+    end_ = start_ + duration;
+    if (FLAGS_receipts) {
+      for (auto &session : sessions_) {
+        ReadReceipt(session.get());
+      }
+    }
+    Tick();
+
+    uint64_t reported = 0;
+    auto report = start_ + std::chrono::seconds(1);
+    while (steady_clock::now() < end_ || outstanding_ > 0) {
+      ctx_.run_one_for(std::chrono::milliseconds(100));
+      if (steady_clock::now() >= report && steady_clock::now() < end_) {
+        std::cout << "sent:" << sent_ << " sms/s:" << accepted_ - reported << " outstanding:" << outstanding_
+                  << " receipts:" << receipts_ << std::endl;
+        reported = accepted_;
+        report += std::chrono::seconds(1);
+      }
+    }
+
+    auto receipt_deadline = steady_clock::now() + std::chrono::seconds(FLAGS_receipt_wait);
+    while (FLAGS_receipts && receipts_ < submits_ && steady_clock::now() < receipt_deadline) {
+      ctx_.run_one_for(std::chrono::milliseconds(100));
+    }
+  }
+
+  void Unbind() {
+    stopping_ = true;
+    tick_timer_.cancel();
+    for (auto &session : sessions_) {
+      try {
+        session->client->Unbind();
+      } catch (std::exception &e) {
+        LOG(WARNING) << "Unbind failed: " << e.what();
+      }
+    }
+  }
+
+  void Report(std::ostream &out) {
+    std::sort(latencies_.begin(), latencies_.end());
+    std::chrono::duration<double> elapsed = end_ - start_;
+    std::chrono::duration<double> receipt_elapsed = last_receipt_ - start_;
+
+    out << std::fixed << std::setprecision(1);
+    out << "binds:" << FLAGS_binds << " window:" << FLAGS_window << " csms method:" << FLAGS_csms_method
+        << " mix:" << FLAGS_mix << std::endl;
+    out << "sms accepted:" << accepted_ << " submit_sm:" << submits_ << " errors:" << errors_
+        << " throttled:" << throttled_ << std::endl;
+    out << "throughput: " << accepted_ / elapsed.count() << " sms/s, " << submits_ / elapsed.count()
+        << " submit_sm/s" << std::endl;
+    out << std::setprecision(3);
+    out << "latency ms: p50 " << Percentile(latencies_, 0.5) / 1000.0 << " p99 " << Percentile(latencies_, 0.99) / 1000.0
+        << " p99.9 " << Percentile(latencies_, 0.999) / 1000.0 << " max "
+        << (latencies_.empty() ? 0 : latencies_.back()) / 1000.0 << std::endl;
+    if (FLAGS_receipts) {
+      out << std::setprecision(1);
+      out << "receipts:" << receipts_ << " "
+          << (receipts_ > 0 ? receipts_ / receipt_elapsed.count() : 0) << " receipts/s" << std::endl;
+    }
+  }
+
+ private:
+  struct Session {
+    std::shared_ptr<asio::ip::tcp::socket> socket;
+    std::unique_ptr<smpp::SmppClient> client;
+  };
+
+  // Sends what is due and checks again in a millisecond.
+  void Tick() {
+    Fill();
+    if (steady_clock::now() >= end_ || stopping_) {
+      return;
+    }
+    tick_timer_.expires_after(std::chrono::milliseconds(1));
+    tick_timer_.async_wait([this](const error_code &error) {
+      if (!error) {
+        Tick();
+      }
+    });
+  }
+
+  // Sends SMSes until the target rate is reached or every window is full.
+  void Fill() {
+    auto now = steady_clock::now();
+    if (now >= end_ || stopping_) {
+      return;
+    }
+
+    double due = std::numeric_limits<double>::max();
+    if (FLAGS_rate > 0) {
+      due = FLAGS_rate * std::chrono::duration<double>(now - start_).count();
+    }
+    while (sent_ < due) {
+      Session *session = LeastLoaded();
+      if (!session) {
+        return;
+      }
+      Send(session);
+    }
+  }
+
+  Session *LeastLoaded() {
+    Session *least = nullptr;
+    for (auto &session : sessions_) {
+      if (session->client->pending() < static_cast<size_t>(FLAGS_window)
+          && (!least || session->client->pending() < least->client->pending())) {
+        least = session.get();
+      }
+    }
+    return least;
+  }
+
+  void Send(Session *session) {
+    std::discrete_distribution<size_t> pick(weights_.begin(), weights_.end());
+    const Message &message = messages_[pick(random_)];
+    auto sent = steady_clock::now();
+    ++sent_;
+    ++outstanding_;
+    session->client->SendSmsAsync(sender_, receiver_, message.short_message, message.params,
+                                  smpp::TlvList(),
+                                  [this, sent](error_code ec, std::pair<string, int> result) {
+      --outstanding_;
+      if (ec) {
+        ++errors_;
+        if (ec == smpp::ESME::RTHROTTLED || ec == smpp::ESME::RMSGQFUL) {
+          ++throttled_;
+        }
+      } else {
+        ++accepted_;
+        // result.second counts the parts of a long message, which go in one submit_sm as payload.
+        submits_ += csms_method_ == smpp::SmppClient::CSMS_PAYLOAD ? 1 : result.second;
+        latencies_.push_back(
+            std::chrono::duration_cast<std::chrono::microseconds>(steady_clock::now() - sent).count());
+      }
+      Fill();
+    });
+  }
+
+  void ReadReceipt(Session *session) {
+    session->client->ReadSmsAsync([this, session](error_code ec, smpp::SMS sms) {
+      if (ec || stopping_) {
+        return;
+      }
+      if (sms.esm_class & smpp::ESM::DELIVER_SMSC_RECEIPT) {
+        ++receipts_;
+        last_receipt_ = steady_clock::now();
+      }
+      ReadReceipt(session);
+    });
+  }
+
+  asio::io_context &ctx_;
+  asio::ip::tcp::endpoint endpoint_;
+  const int csms_method_;
+  std::vector<std::unique_ptr<Session>> sessions_;
+  std::vector<Message> messages_;
+  std::vector<double> weights_;
+  std::mt19937 random_;
+  smpp::SmppAddress sender_;
+  smpp::SmppAddress receiver_;
+  asio::steady_timer tick_timer_;
+  steady_clock::time_point start_;
+  steady_clock::time_point end_;
+  uint64_t sent_;
+  uint64_t outstanding_;
+  uint64_t accepted_;  // SMSes accepted by the SMSC.
+  uint64_t submits_;  // submit_sm PDUs accepted, more than SMSes for concatenated messages.
+  uint64_t errors_;
+  uint64_t throttled_;
+  uint64_t receipts_;  // One for every submit_sm, when requested.
+  steady_clock::time_point last_receipt_;
+  std::vector<int64_t> latencies_;  // Submit to response latency of every accepted SMS, in microseconds.
+  bool stopping_;
+};
+}  // namespace
+
+int main(int argc, char **argv) {
+  google::SetUsageMessage("SMPP load generator");
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  google::InitGoogleLogging(argv[0]);
+
+  asio::io_context ctx;
+  asio::ip::tcp::endpoint endpoint(asio::ip::address::from_string(FLAGS_host), FLAGS_port);
+  std::unique_ptr<smpp::SmscSimulator> smsc;
+  if (FLAGS_simulate) {
+    smsc.reset(new smpp::SmscSimulator(ctx, asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0)));
+    smsc->set_latency(std::chrono::milliseconds(FLAGS_sim_latency_ms));
+    smsc->Start();
+    endpoint = smsc->endpoint();
+  }
+
+  try {
+    LoadGen loadgen(ctx, endpoint);
+    loadgen.Bind();
+    loadgen.Run(std::chrono::seconds(FLAGS_duration));
+    loadgen.Unbind();
+    loadgen.Report(std::cout);
+  } catch (std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,89 @@
+//
+// Copyright (C) 2014 OnlineCity
+// Licensed under the MIT license, which can be read at: http://www.opensource.org/licenses/mit-license.php
+//
+// SMSC simulator, serving until interrupted.
+//
+// smsc_sim --port=2775 --latency_ms=5 --throttle_every=100 --deliver_rate=10
+//
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include <chrono>
+#include <csignal>
+#include <functional>
+#include <iostream>
+
+#include <boost/asio.hpp>
+namespace asio = boost::asio;
+
+#include "smpp/smsc_simulator.h"
+
+DEFINE_string(address, "127.0.0.1", "Address to listen on");
+DEFINE_int32(port, 2775, "Port to listen on");
+DEFINE_string(system_id, "", "Accept only binds with this system id, any if empty");
+DEFINE_string(password, "", "Password to go with system_id");
+DEFINE_int32(latency_ms, 0, "Delay of every response in milliseconds");
+DEFINE_int32(jitter_ms, 0, "Random extra delay of every response, up to this many milliseconds");
+DEFINE_int32(throttle_every, 0, "Answer every n-th submit_sm, and submit_multi, with ESME_RTHROTTLED");
+DEFINE_int32(max_tps, 0, "Answer submit_sm beyond this many per second with ESME_RTHROTTLED");
+DEFINE_int32(nack_every, 0, "Answer every n-th submit_sm, and submit_multi, with generic_nack");
+DEFINE_bool(receipts, true, "Send delivery receipts when requested");
+DEFINE_int32(receipt_delay_ms, 0, "Delay of delivery receipts in milliseconds");
+DEFINE_double(deliver_rate, 0, "Mobile originated deliver_sm pushed to receivers per second");
+DEFINE_bool(deliver_data_sm, false, "Push the mobile originated messages as data_sm rather than deliver_sm");
+DEFINE_int32(stats_interval, 10, "Seconds between statistics, 0 for none");
+
+namespace {
+void PrintStats(const smpp::SmscStats &stats) {
+  std::cout << "binds:" << stats.binds << " submits:" << stats.submits << " submit_multis:" << stats.submit_multis
+            << " data_sms:" << stats.data_sms << " throttled:" << stats.throttled << " nacked:" << stats.nacked
+            << " receipts:" << stats.receipts << " delivers:" << stats.delivers << std::endl;
+}
+}  // namespace
+
+int main(int argc, char **argv) {
+  google::SetUsageMessage("SMSC simulator");
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  google::InitGoogleLogging(argv[0]);
+
+  asio::io_context ctx;
+  smpp::SmscSimulator smsc(ctx, asio::ip::tcp::endpoint(asio::ip::address::from_string(FLAGS_address),
+                                                         FLAGS_port));
+  smsc.set_credentials(FLAGS_system_id, FLAGS_password);
+  smsc.set_latency(std::chrono::milliseconds(FLAGS_latency_ms), std::chrono::milliseconds(FLAGS_jitter_ms));
+  smsc.set_throttle_every(FLAGS_throttle_every);
+  smsc.set_max_tps(FLAGS_max_tps);
+  smsc.set_nack_every(FLAGS_nack_every);
+  smsc.set_receipts(FLAGS_receipts, std::chrono::milliseconds(FLAGS_receipt_delay_ms));
+  smsc.set_deliver_rate(FLAGS_deliver_rate);
+  smsc.set_deliver_data_sm(FLAGS_deliver_data_sm);
+  smsc.Start();
+  std::cout << "Listening on " << smsc.endpoint() << std::endl;
+
+  asio::steady_timer stats_timer(ctx);
+  std::function<void()> arm_stats = [&] {
+    if (FLAGS_stats_interval <= 0) {
+      return;
+    }
+    stats_timer.expires_after(std::chrono::seconds(FLAGS_stats_interval));
+    stats_timer.async_wait([&](const boost::system::error_code &error) {
+      if (!error) {
+        PrintStats(smsc.stats());
+        arm_stats();
+      }
+    });
+  };
+  arm_stats();
+
+  asio::signal_set signals(ctx, SIGINT, SIGTERM);
+  signals.async_wait([&](const boost::system::error_code &, int) {
+    stats_timer.cancel();
+    smsc.Stop();
+  });
+
+  ctx.run();
+  PrintStats(smsc.stats());
+  return 0;
+}